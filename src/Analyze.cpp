@@ -0,0 +1,251 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+** tivtc-analyze: first pass analysis without a VapourSynth core.
+**
+** Reads YUV4MPEG2 from a file or stdin and runs TFM (match file) and
+** TDecimate mode 4 (metrics file) on it through AnalyzeHost. Frames are
+** requested from a pool of threads. TFM is kept linear so its matches do
+** not depend on the number of threads, TDecimate's metrics are computed
+** in parallel.
+**
+** A pipe cannot be indexed, so its length has to be given with --frames
+** or an XLENGTH=N parameter in the stream header. Reading stops there.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <VapourSynth.h>
+#include <VSHelper.h>
+
+#include "AnalyzeHost.h"
+#include "Y4MReader.h"
+#include "internal.h"
+
+VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin);
+
+static void usage()
+{
+  fprintf(stderr,
+    "tivtc-analyze " VERSION "\n"
+    "usage: tivtc-analyze [options] <input.y4m | ->\n"
+    "  --tfm-output FILE       write TFM's match file (TFM output)\n"
+    "  --metrics FILE          write TDecimate's metrics file (mode 4 output)\n"
+    "  --tfm NAME=VALUE        pass an argument to TFM, may be repeated\n"
+    "  --tdecimate NAME=VALUE  pass an argument to TDecimate, may be repeated\n"
+    "  --frames N              number of frames, required when reading stdin\n"
+    "                          unless the header has an XLENGTH=N parameter\n"
+    "  --threads N             worker threads (default: all cores)\n"
+    "  --cache N               frames cached per filter (default: 4 per thread + 16)\n");
+}
+
+struct Args {
+  std::string input, tfmOutput, metrics;
+  std::vector<std::string> tfmArgs, tdecimateArgs;
+  int frames = -1, threads = 0, cache = 0;
+};
+
+static bool parseArgs(int argc, char **argv, Args &args)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string a = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (a == "--tfm-output" && hasValue) args.tfmOutput = argv[++i];
+    else if (a == "--metrics" && hasValue) args.metrics = argv[++i];
+    else if (a == "--tfm" && hasValue) args.tfmArgs.push_back(argv[++i]);
+    else if (a == "--tdecimate" && hasValue) args.tdecimateArgs.push_back(argv[++i]);
+    else if (a == "--frames" && hasValue) args.frames = atoi(argv[++i]);
+    else if (a == "--threads" && hasValue) args.threads = atoi(argv[++i]);
+    else if (a == "--cache" && hasValue) args.cache = atoi(argv[++i]);
+    else if (args.input.empty() && (a == "-" || a.compare(0, 2, "--") != 0)) args.input = a;
+    else return false;
+  }
+  return !args.input.empty();
+}
+
+// NAME=VALUE arguments, typed after the function's signature
+static void setFilterArgs(const AnalyzeHost &host, const char *filter, const std::vector<std::string> &list, VSMap *map)
+{
+  const VSAPI *vsapi = host.api();
+  for (const std::string &arg : list)
+  {
+    const size_t eq = arg.find('=');
+    const std::string name = arg.substr(0, eq);
+    if (eq == std::string::npos || name == "clip" || name == "clip2")
+      throw TIVTCError(("tivtc-analyze:  invalid " + std::string(filter) + " argument '" + arg + "'!").c_str());
+    const char *value = arg.c_str() + eq + 1;
+    switch (host.argType(filter, name.c_str()))
+    {
+    case ptInt: vsapi->propSetInt(map, name.c_str(), strtoll(value, nullptr, 0), paReplace); break;
+    case ptFloat: vsapi->propSetFloat(map, name.c_str(), strtod(value, nullptr), paReplace); break;
+    case ptData: vsapi->propSetData(map, name.c_str(), value, -1, paReplace); break;
+    default:
+      throw TIVTCError(("tivtc-analyze:  " + std::string(filter) + " has no argument '" + name + "'!").c_str());
+    }
+  }
+}
+
+static VSNodeRef *createFilter(const AnalyzeHost &host, const char *filter, VSMap *args)
+{
+  const VSAPI *vsapi = host.api();
+  VSMap *out = host.invoke(filter, args);
+  vsapi->freeMap(args);
+  if (vsapi->getError(out))
+  {
+    const std::string error = vsapi->getError(out);
+    vsapi->freeMap(out);
+    throw TIVTCError(error.c_str());
+  }
+  VSNodeRef *node = vsapi->propGetNode(out, "clip", 0, nullptr);
+  vsapi->freeMap(out);
+  return node;
+}
+
+static int run(const Args &args)
+{
+  Y4MReader reader(args.input.c_str());
+  if (!reader.seekable())
+  {
+    // the filters need the length up front, a pipe cannot be indexed
+    if (args.frames > 0)
+      reader.numFrames = args.frames;
+    else if (reader.numFrames <= 0)
+      throw TIVTCError("tivtc-analyze:  --frames or an XLENGTH header parameter is required when reading stdin!");
+  }
+  else if (args.frames > 0)
+    reader.numFrames = std::min(reader.numFrames, args.frames);
+
+  const int threads = args.threads > 0 ? args.threads : std::max(1, (int)std::thread::hardware_concurrency());
+  AnalyzeHost host(args.cache > 0 ? args.cache : threads * 4 + 16);
+  const VSAPI *vsapi = host.api();
+  host.loadPlugin(VapourSynthPluginInit);
+  host.setLinear("TFM");
+
+  VSVideoInfo vi;
+  memset(&vi, 0, sizeof(vi));
+  vi.format = vsapi->registerFormat(reader.colorFamily, stInteger, reader.bitsPerSample,
+    reader.subSamplingW, reader.subSamplingH, host.core());
+  vi.fpsNum = reader.fpsNum;
+  vi.fpsDen = reader.fpsDen;
+  vi.width = reader.width;
+  vi.height = reader.height;
+  vi.numFrames = reader.numFrames;
+  VSNodeRef *source = host.createSource(vi, [&reader](int n, VSFrameRef *dst, const VSAPI *api) {
+    reader.read(n, dst, api);
+  }, !reader.seekable());
+
+  VSMap *tfmArgs = vsapi->createMap();
+  vsapi->propSetNode(tfmArgs, "clip", source, paReplace);
+  vsapi->freeNode(source);
+  if (!args.tfmOutput.empty())
+    vsapi->propSetData(tfmArgs, "output", args.tfmOutput.c_str(), -1, paReplace);
+  setFilterArgs(host, "TFM", args.tfmArgs, tfmArgs);
+  VSNodeRef *node = createFilter(host, "TFM", tfmArgs);
+
+  if (!args.metrics.empty())
+  {
+    VSMap *tdecArgs = vsapi->createMap();
+    vsapi->propSetNode(tdecArgs, "clip", node, paReplace);
+    vsapi->freeNode(node);
+    vsapi->propSetInt(tdecArgs, "mode", 4, paReplace);
+    vsapi->propSetData(tdecArgs, "output", args.metrics.c_str(), -1, paReplace);
+    setFilterArgs(host, "TDecimate", args.tdecimateArgs, tdecArgs);
+    node = createFilter(host, "TDecimate", tdecArgs);
+  }
+
+  const int numFrames = vsapi->getVideoInfo(node)->numFrames;
+  std::atomic<int> nextFrame{ 0 };
+  std::mutex errorLock;
+  std::string error;
+  const auto start = std::chrono::steady_clock::now();
+
+  // frames are handed out in order, so the linear TFM rarely waits
+  auto worker = [&]() {
+    char msg[1024];
+    int n;
+    while ((n = nextFrame++) < numFrames)
+    {
+      const VSFrameRef *f = vsapi->getFrame(n, node, msg, sizeof(msg));
+      if (!f)
+      {
+        std::lock_guard<std::mutex> guard(errorLock);
+        if (error.empty()) error = msg;
+        nextFrame = numFrames;
+        break;
+      }
+      vsapi->freeFrame(f);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (auto &t : pool)
+    t.join();
+
+  // the filters write their files when they are freed
+  vsapi->freeNode(node);
+  if (!error.empty())
+    throw TIVTCError(error.c_str());
+
+  if (reader.moreFrames())
+    fprintf(stderr, "tivtc-analyze: the input has more than %d frames, the rest was not analyzed\n", reader.numFrames);
+
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "tivtc-analyze: %d frames in %.2f s (%.2f fps)\n", numFrames, secs, secs > 0 ? numFrames / secs : 0.0);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  Args args;
+  if (!parseArgs(argc, argv, args))
+  {
+    usage();
+    return 2;
+  }
+  if (args.tfmOutput.empty() && args.metrics.empty())
+  {
+    fprintf(stderr, "tivtc-analyze: nothing to do, give --tfm-output and/or --metrics\n");
+    return 2;
+  }
+  try {
+    return run(args);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+}
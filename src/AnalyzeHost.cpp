@@ -0,0 +1,769 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <VSHelper.h>
+
+#include "AnalyzeHost.h"
+#include "internal.h"
+
+struct FrameData;
+struct FuncData;
+
+struct PropValue {
+  char type;
+  std::vector<int64_t> ints;
+  std::vector<double> floats;
+  std::vector<std::string> data;
+  std::vector<std::shared_ptr<VSNode>> nodes;
+  std::vector<std::shared_ptr<FrameData>> frames;
+  std::vector<std::shared_ptr<FuncData>> funcs;
+
+  int size() const
+  {
+    switch (type)
+    {
+    case ptInt: return (int)ints.size();
+    case ptFloat: return (int)floats.size();
+    case ptData: return (int)data.size();
+    case ptNode: return (int)nodes.size();
+    case ptFrame: return (int)frames.size();
+    case ptFunction: return (int)funcs.size();
+    }
+    return 0;
+  }
+};
+
+struct VSMap {
+  std::map<std::string, PropValue> props;
+  std::string error;
+};
+
+struct FrameData {
+  const VSFormat *format;
+  int width[3], height[3], stride[3];
+  uint8_t *planes[3];
+  VSMap props;
+
+  FrameData(const VSFormat *_format, int w, int h) : format(_format)
+  {
+    for (int p = 0; p < 3; ++p)
+    {
+      planes[p] = nullptr;
+      width[p] = height[p] = stride[p] = 0;
+      if (p >= format->numPlanes)
+        continue;
+      width[p] = p ? w >> format->subSamplingW : w;
+      height[p] = p ? h >> format->subSamplingH : h;
+      stride[p] = (width[p] * format->bytesPerSample + 63) & ~63;
+      planes[p] = vs_aligned_malloc<uint8_t>((size_t)stride[p] * height[p], 64);
+      if (!planes[p])
+        throw TIVTCError("tivtc-analyze:  out of memory!");
+    }
+  }
+  ~FrameData()
+  {
+    for (int p = 0; p < 3; ++p)
+      vs_aligned_free(planes[p]);
+  }
+};
+
+struct FuncData {
+  VSPublicFunction func;
+  void *userData;
+  VSFreeFuncData free;
+  ~FuncData() { if (free) free(userData); }
+};
+
+struct VSFrameRef { std::shared_ptr<FrameData> frame; };
+struct VSNodeRef { std::shared_ptr<VSNode> node; };
+struct VSFuncRef { std::shared_ptr<FuncData> func; };
+struct VSPlugin {
+  const char *id;
+  std::function<void(const char *name, const char *args, VSPublicFunction func, void *data)> add;
+};
+
+struct VSCore {
+  std::mutex lock;
+  std::list<VSFormat> formats;
+  size_t cacheFrames;
+  const std::set<std::string> *linearFilters;
+};
+
+struct VSFrameContext {
+  std::vector<std::pair<std::shared_ptr<VSNode>, int>> requests;
+  std::map<std::pair<const VSNode *, int>, std::shared_ptr<FrameData>> frames;
+  std::string error;
+};
+
+typedef std::shared_ptr<FrameData> FramePtr;
+
+static VSPlugin stdPlugin = { "com.vapoursynth.std", nullptr };
+static const VSAPI *hostApi();
+
+struct VSNode {
+  std::string name;
+  VSVideoInfo vi;
+  VSCore *core;
+  VSFilterGetFrame getFrame = nullptr;
+  VSFilterFree free = nullptr;
+  void *instanceData = nullptr;
+  int mode = fmParallel;
+  bool linear = false;
+  AnalyzeHost::SourceFunc source;
+  bool sequential = false;
+  int sourceNext = 0;
+
+  std::mutex callLock;  // filters other than fmParallel, and sources
+  std::mutex cacheLock;
+  std::map<int, std::shared_future<FramePtr>> cache;
+  std::mutex linearLock;
+  int linearNext = 0;
+
+  VSNode(const char *_name, VSCore *_core) : name(_name), core(_core) { memset(&vi, 0, sizeof(vi)); }
+  ~VSNode() { if (free) free(instanceData, core, hostApi()); }
+
+  int clamp(int n) const { return std::max(0, std::min(n, vi.numFrames - 1)); }
+
+  FramePtr get(int n)
+  {
+    n = clamp(n);
+    if (linear)
+    {
+      std::lock_guard<std::mutex> guard(linearLock);
+      while (linearNext <= n)
+        fetch(linearNext++);
+    }
+    return fetch(n);
+  }
+
+private:
+  // cached frame n, or produce it; other threads asking for the same frame
+  // wait for the first one
+  FramePtr fetch(int n)
+  {
+    std::promise<FramePtr> promise;
+    std::shared_future<FramePtr> result;
+    bool owner = false;
+    {
+      std::lock_guard<std::mutex> guard(cacheLock);
+      auto it = cache.find(n);
+      if (it != cache.end())
+        result = it->second;
+      else
+      {
+        result = promise.get_future().share();
+        cache[n] = result;
+        owner = true;
+        evict();
+      }
+    }
+    if (owner)
+    {
+      try {
+        promise.set_value(produce(n));
+      } catch (...) {
+        promise.set_exception(std::current_exception());
+      }
+    }
+    return result.get();
+  }
+
+  // drops the lowest finished frames beyond the cache size
+  void evict()
+  {
+    for (auto it = cache.begin(); it != cache.end() && cache.size() > core->cacheFrames;)
+    {
+      if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        it = cache.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  const VSFrameRef *call(int n, int reason, void **frameData, VSFrameContext *ctx)
+  {
+    if (mode == fmParallel || (mode == fmParallelRequests && reason == arInitial))
+      return getFrame(n, reason, &instanceData, frameData, ctx, core, hostApi());
+    std::lock_guard<std::mutex> guard(callLock);
+    return getFrame(n, reason, &instanceData, frameData, ctx, core, hostApi());
+  }
+
+  FramePtr produce(int n)
+  {
+    if (source)
+    {
+      std::lock_guard<std::mutex> guard(callLock);
+      if (sequential && n < sourceNext)
+        throw TIVTCError(("tivtc-analyze:  frame " + std::to_string(n) +
+          " of the input is needed again but no longer buffered, use a file or a larger --cache!").c_str());
+      VSFrameRef dst = { std::make_shared<FrameData>(vi.format, vi.width, vi.height) };
+      if (sequential)
+      {
+        // skipped frames still have to be read past
+        for (; sourceNext < n; ++sourceNext)
+        {
+          VSFrameRef skip = { std::make_shared<FrameData>(vi.format, vi.width, vi.height) };
+          source(sourceNext, &skip, hostApi());
+        }
+        sourceNext = n + 1;
+      }
+      source(n, &dst, hostApi());
+      return dst.frame;
+    }
+
+    VSFrameContext ctx;
+    void *frameData = nullptr;
+    const VSFrameRef *r = call(n, arInitial, &frameData, &ctx);
+    while (!r && ctx.error.empty())
+    {
+      if (ctx.requests.empty())
+      {
+        ctx.error = name + ":  no frame returned for frame " + std::to_string(n) + "!";
+        break;
+      }
+      auto requests = std::move(ctx.requests);
+      ctx.requests.clear();
+      for (auto &req : requests)
+      {
+        auto &frame = ctx.frames[{ req.first.get(), req.second }];
+        if (!frame)
+          frame = req.first->get(req.second);
+      }
+      r = call(n, arAllFramesReady, &frameData, &ctx);
+    }
+    if (!ctx.error.empty())
+    {
+      delete r;
+      throw TIVTCError(ctx.error.c_str());
+    }
+    FramePtr f = r->frame;
+    delete r;
+    return f;
+  }
+};
+
+// property helpers
+
+static void missingProp(const char *key, int *error, int code)
+{
+  if (error)
+  {
+    *error = code;
+    return;
+  }
+  fprintf(stderr, "tivtc-analyze:  property read of '%s' failed and no error output was given\n", key);
+  abort();
+}
+
+static const PropValue *findProp(const VSMap *map, const char *key, int index, char type, int *error)
+{
+  if (error) *error = 0;
+  auto it = map->props.find(key);
+  if (it == map->props.end()) { missingProp(key, error, peUnset); return nullptr; }
+  if (it->second.type != type) { missingProp(key, error, peType); return nullptr; }
+  if (index < 0 || index >= it->second.size()) { missingProp(key, error, peIndex); return nullptr; }
+  return &it->second;
+}
+
+static PropValue *setProp(VSMap *map, const char *key, char type, int append)
+{
+  auto it = map->props.find(key);
+  if (it != map->props.end() && append == paAppend && it->second.type != type)
+    return nullptr;
+  if (it == map->props.end() || append == paReplace || it->second.type != type)
+  {
+    PropValue &v = map->props[key];
+    v = PropValue();
+    v.type = type;
+    return &v;
+  }
+  return &it->second;
+}
+
+// VSAPI functions
+
+static const VSCoreInfo *VS_CC getCoreInfo(VSCore *core)
+{
+  static VSCoreInfo info = { "tivtc-analyze", 0, VAPOURSYNTH_API_VERSION, 1, 0, 0 };
+  info.numThreads = (int)std::thread::hardware_concurrency();
+  (void)core;
+  return &info;
+}
+
+static const VSFrameRef *VS_CC cloneFrameRef(const VSFrameRef *f) { return new VSFrameRef(*f); }
+static VSNodeRef *VS_CC cloneNodeRef(VSNodeRef *node) { return new VSNodeRef(*node); }
+static VSFuncRef *VS_CC cloneFuncRef(VSFuncRef *f) { return new VSFuncRef(*f); }
+static void VS_CC freeFrame(const VSFrameRef *f) { delete f; }
+static void VS_CC freeNode(VSNodeRef *node) { delete node; }
+static void VS_CC freeFunc(VSFuncRef *f) { delete f; }
+
+static VSFrameRef *VS_CC newVideoFrame(const VSFormat *format, int width, int height, const VSFrameRef *propSrc, VSCore *core)
+{
+  (void)core;
+  VSFrameRef *f = new VSFrameRef{ std::make_shared<FrameData>(format, width, height) };
+  if (propSrc)
+    f->frame->props.props = propSrc->frame->props.props;
+  return f;
+}
+
+static VSFrameRef *VS_CC copyFrame(const VSFrameRef *f, VSCore *core)
+{
+  const FrameData &src = *f->frame;
+  VSFrameRef *dst = newVideoFrame(src.format, src.width[0], src.height[0], f, core);
+  for (int p = 0; p < src.format->numPlanes; ++p)
+    memcpy(dst->frame->planes[p], src.planes[p], (size_t)src.stride[p] * src.height[p]);
+  return dst;
+}
+
+static void VS_CC copyFrameProps(const VSFrameRef *src, VSFrameRef *dst, VSCore *core)
+{
+  (void)core;
+  dst->frame->props.props = src->frame->props.props;
+}
+
+static VSPlugin *VS_CC getPluginById(const char *identifier, VSCore *core)
+{
+  (void)core;
+  return strcmp(identifier, stdPlugin.id) == 0 ? &stdPlugin : nullptr;
+}
+
+static void VS_CC setError(VSMap *map, const char *errorMessage)
+{
+  map->props.clear();
+  map->error = errorMessage ? errorMessage : "unknown error";
+}
+
+static const char *VS_CC getError(const VSMap *map)
+{
+  return map->error.empty() ? nullptr : map->error.c_str();
+}
+
+static void VS_CC setFilterError(const char *errorMessage, VSFrameContext *frameCtx)
+{
+  frameCtx->error = errorMessage ? errorMessage : "unknown error";
+}
+
+static int VS_CC propSetNode(VSMap *map, const char *key, VSNodeRef *node, int append);
+static VSNodeRef *VS_CC propGetNode(const VSMap *map, const char *key, int index, int *error);
+
+// std.Cache is the only function of other plugins TIVTC needs to work,
+// the nodes here cache on their own
+static VSMap *VS_CC invoke(VSPlugin *plugin, const char *name, const VSMap *args)
+{
+  VSMap *ret = new VSMap;
+  if (plugin == &stdPlugin && strcmp(name, "Cache") == 0)
+  {
+    VSNodeRef *node = propGetNode(args, "clip", 0, nullptr);
+    propSetNode(ret, "clip", node, paReplace);
+    freeNode(node);
+  }
+  else
+    setError(ret, (std::string(name) + " is not available in tivtc-analyze").c_str());
+  return ret;
+}
+
+static const VSFormat *VS_CC registerFormat(int colorFamily, int sampleType, int bitsPerSample, int subSamplingW, int subSamplingH, VSCore *core)
+{
+  std::lock_guard<std::mutex> guard(core->lock);
+  for (const VSFormat &f : core->formats)
+  {
+    if (f.colorFamily == colorFamily && f.sampleType == sampleType && f.bitsPerSample == bitsPerSample &&
+      f.subSamplingW == subSamplingW && f.subSamplingH == subSamplingH)
+      return &f;
+  }
+  VSFormat f;
+  memset(&f, 0, sizeof(f));
+  snprintf(f.name, sizeof(f.name), "%s%d_%d%d", colorFamily == cmGray ? "Gray" : colorFamily == cmYUV ? "YUV" : "Other",
+    bitsPerSample, subSamplingW, subSamplingH);
+  f.id = colorFamily + (int)core->formats.size() + 1;
+  f.colorFamily = colorFamily;
+  f.sampleType = sampleType;
+  f.bitsPerSample = bitsPerSample;
+  f.bytesPerSample = bitsPerSample <= 8 ? 1 : bitsPerSample <= 16 ? 2 : 4;
+  f.subSamplingW = subSamplingW;
+  f.subSamplingH = subSamplingH;
+  f.numPlanes = colorFamily == cmGray ? 1 : 3;
+  core->formats.push_back(f);
+  return &core->formats.back();
+}
+
+static const VSFrameRef *VS_CC getFrame(int n, VSNodeRef *node, char *errorMsg, int bufSize)
+{
+  try {
+    return new VSFrameRef{ node->node->get(n) };
+  } catch (const std::exception &e) {
+    if (errorMsg && bufSize > 0)
+      snprintf(errorMsg, bufSize, "%s", e.what());
+    return nullptr;
+  }
+}
+
+static void VS_CC getFrameAsync(int n, VSNodeRef *node, VSFrameDoneCallback callback, void *userData)
+{
+  char error[512] = { 0 };
+  const VSFrameRef *f = getFrame(n, node, error, sizeof(error));
+  callback(userData, f, n, node, f ? nullptr : error);
+}
+
+static const VSFrameRef *VS_CC getFrameFilter(int n, VSNodeRef *node, VSFrameContext *frameCtx)
+{
+  auto it = frameCtx->frames.find({ node->node.get(), node->node->clamp(n) });
+  return it != frameCtx->frames.end() ? new VSFrameRef{ it->second } : nullptr;
+}
+
+static void VS_CC requestFrameFilter(int n, VSNodeRef *node, VSFrameContext *frameCtx)
+{
+  // a filter asking only for frames it already has still expects another
+  // arAllFramesReady call, as TDecimate mode 7 does for its output frame
+  n = node->node->clamp(n);
+  for (const auto &req : frameCtx->requests)
+  {
+    if (req.first == node->node && req.second == n)
+      return;
+  }
+  frameCtx->requests.emplace_back(node->node, n);
+}
+
+static int VS_CC getStride(const VSFrameRef *f, int plane) { return f->frame->stride[plane]; }
+static const uint8_t *VS_CC getReadPtr(const VSFrameRef *f, int plane) { return f->frame->planes[plane]; }
+static uint8_t *VS_CC getWritePtr(VSFrameRef *f, int plane) { return f->frame->planes[plane]; }
+
+static VSFuncRef *VS_CC createFunc(VSPublicFunction func, void *userData, VSFreeFuncData free, VSCore *core, const VSAPI *vsapi)
+{
+  (void)core;
+  (void)vsapi;
+  return new VSFuncRef{ std::shared_ptr<FuncData>(new FuncData{ func, userData, free }) };
+}
+
+static VSMap *VS_CC createMap(void) { return new VSMap; }
+static void VS_CC freeMap(VSMap *map) { delete map; }
+static void VS_CC clearMap(VSMap *map) { map->props.clear(); map->error.clear(); }
+
+static const VSVideoInfo *VS_CC getVideoInfo(VSNodeRef *node) { return &node->node->vi; }
+static void VS_CC setVideoInfo(const VSVideoInfo *vi, int numOutputs, VSNode *node)
+{
+  (void)numOutputs;
+  node->vi = *vi;
+}
+
+static const VSFormat *VS_CC getFrameFormat(const VSFrameRef *f) { return f->frame->format; }
+static int VS_CC getFrameWidth(const VSFrameRef *f, int plane) { return f->frame->width[plane]; }
+static int VS_CC getFrameHeight(const VSFrameRef *f, int plane) { return f->frame->height[plane]; }
+static const VSMap *VS_CC getFramePropsRO(const VSFrameRef *f) { return &f->frame->props; }
+static VSMap *VS_CC getFramePropsRW(VSFrameRef *f) { return &f->frame->props; }
+
+static int VS_CC propNumKeys(const VSMap *map) { return (int)map->props.size(); }
+static const char *VS_CC propGetKey(const VSMap *map, int index)
+{
+  auto it = map->props.begin();
+  std::advance(it, index);
+  return it->first.c_str();
+}
+static int VS_CC propNumElements(const VSMap *map, const char *key)
+{
+  auto it = map->props.find(key);
+  return it == map->props.end() ? -1 : it->second.size();
+}
+static char VS_CC propGetType(const VSMap *map, const char *key)
+{
+  auto it = map->props.find(key);
+  return it == map->props.end() ? (char)ptUnset : it->second.type;
+}
+
+static int64_t VS_CC propGetInt(const VSMap *map, const char *key, int index, int *error)
+{
+  const PropValue *v = findProp(map, key, index, ptInt, error);
+  return v ? v->ints[index] : 0;
+}
+static double VS_CC propGetFloat(const VSMap *map, const char *key, int index, int *error)
+{
+  const PropValue *v = findProp(map, key, index, ptFloat, error);
+  return v ? v->floats[index] : 0.0;
+}
+static const char *VS_CC propGetData(const VSMap *map, const char *key, int index, int *error)
+{
+  const PropValue *v = findProp(map, key, index, ptData, error);
+  return v ? v->data[index].c_str() : nullptr;
+}
+static int VS_CC propGetDataSize(const VSMap *map, const char *key, int index, int *error)
+{
+  const PropValue *v = findProp(map, key, index, ptData, error);
+  return v ? (int)v->data[index].size() : -1;
+}
+static VSNodeRef *VS_CC propGetNode(const VSMap *map, const char *key, int index, int *error)
+{
+  const PropValue *v = findProp(map, key, index, ptNode, error);
+  return v ? new VSNodeRef{ v->nodes[index] } : nullptr;
+}
+static const VSFrameRef *VS_CC propGetFrame(const VSMap *map, const char *key, int index, int *error)
+{
+  const PropValue *v = findProp(map, key, index, ptFrame, error);
+  return v ? new VSFrameRef{ v->frames[index] } : nullptr;
+}
+static VSFuncRef *VS_CC propGetFunc(const VSMap *map, const char *key, int index, int *error)
+{
+  const PropValue *v = findProp(map, key, index, ptFunction, error);
+  return v ? new VSFuncRef{ v->funcs[index] } : nullptr;
+}
+static const int64_t *VS_CC propGetIntArray(const VSMap *map, const char *key, int *error)
+{
+  const PropValue *v = findProp(map, key, 0, ptInt, error);
+  return v ? v->ints.data() : nullptr;
+}
+
+static int VS_CC propDeleteKey(VSMap *map, const char *key) { return (int)map->props.erase(key); }
+
+static int VS_CC propSetInt(VSMap *map, const char *key, int64_t i, int append)
+{
+  PropValue *v = setProp(map, key, ptInt, append);
+  if (!v) return 1;
+  if (append != paTouch) v->ints.push_back(i);
+  return 0;
+}
+static int VS_CC propSetFloat(VSMap *map, const char *key, double d, int append)
+{
+  PropValue *v = setProp(map, key, ptFloat, append);
+  if (!v) return 1;
+  if (append != paTouch) v->floats.push_back(d);
+  return 0;
+}
+static int VS_CC propSetData(VSMap *map, const char *key, const char *data, int size, int append)
+{
+  PropValue *v = setProp(map, key, ptData, append);
+  if (!v) return 1;
+  if (append != paTouch) v->data.emplace_back(data, size < 0 ? strlen(data) : (size_t)size);
+  return 0;
+}
+static int VS_CC propSetNode(VSMap *map, const char *key, VSNodeRef *node, int append)
+{
+  PropValue *v = setProp(map, key, ptNode, append);
+  if (!v) return 1;
+  if (append != paTouch) v->nodes.push_back(node->node);
+  return 0;
+}
+static int VS_CC propSetFrame(VSMap *map, const char *key, const VSFrameRef *f, int append)
+{
+  PropValue *v = setProp(map, key, ptFrame, append);
+  if (!v) return 1;
+  if (append != paTouch) v->frames.push_back(f->frame);
+  return 0;
+}
+static int VS_CC propSetFunc(VSMap *map, const char *key, VSFuncRef *func, int append)
+{
+  PropValue *v = setProp(map, key, ptFunction, append);
+  if (!v) return 1;
+  if (append != paTouch) v->funcs.push_back(func->func);
+  return 0;
+}
+static int VS_CC propSetIntArray(VSMap *map, const char *key, const int64_t *i, int size)
+{
+  PropValue *v = setProp(map, key, ptInt, paReplace);
+  v->ints.assign(i, i + size);
+  return 0;
+}
+
+static void VS_CC createFilter(const VSMap *in, VSMap *out, const char *name, VSFilterInit init, VSFilterGetFrame getFrame,
+  VSFilterFree free, int filterMode, int flags, void *instanceData, VSCore *core)
+{
+  auto node = std::make_shared<VSNode>(name, core);
+  node->getFrame = getFrame;
+  node->free = free;
+  node->instanceData = instanceData;
+  node->mode = filterMode;
+  node->linear = (flags & nfMakeLinear) != 0 || core->linearFilters->count(name);
+  init(const_cast<VSMap *>(in), out, &node->instanceData, node.get(), core, hostApi());
+  if (getError(out))
+    return;
+  VSNodeRef ref = { node };
+  propSetNode(out, "clip", &ref, paAppend);
+}
+
+static void VS_CC logMessage(int msgType, const char *msg)
+{
+  (void)msgType;
+  fprintf(stderr, "%s\n", msg);
+}
+
+static const VSAPI *hostApi()
+{
+  static const VSAPI api = [] {
+    VSAPI a;
+    memset(&a, 0, sizeof(a));
+    a.getCoreInfo = getCoreInfo;
+    a.cloneFrameRef = cloneFrameRef;
+    a.cloneNodeRef = cloneNodeRef;
+    a.cloneFuncRef = cloneFuncRef;
+    a.freeFrame = freeFrame;
+    a.freeNode = freeNode;
+    a.freeFunc = freeFunc;
+    a.newVideoFrame = newVideoFrame;
+    a.copyFrame = copyFrame;
+    a.copyFrameProps = copyFrameProps;
+    a.getPluginById = getPluginById;
+    a.createFilter = createFilter;
+    a.setError = setError;
+    a.getError = getError;
+    a.setFilterError = setFilterError;
+    a.invoke = invoke;
+    a.registerFormat = registerFormat;
+    a.getFrame = getFrame;
+    a.getFrameAsync = getFrameAsync;
+    a.getFrameFilter = getFrameFilter;
+    a.requestFrameFilter = requestFrameFilter;
+    a.getStride = getStride;
+    a.getReadPtr = getReadPtr;
+    a.getWritePtr = getWritePtr;
+    a.createFunc = createFunc;
+    a.createMap = createMap;
+    a.freeMap = freeMap;
+    a.clearMap = clearMap;
+    a.getVideoInfo = getVideoInfo;
+    a.setVideoInfo = setVideoInfo;
+    a.getFrameFormat = getFrameFormat;
+    a.getFrameWidth = getFrameWidth;
+    a.getFrameHeight = getFrameHeight;
+    a.getFramePropsRO = getFramePropsRO;
+    a.getFramePropsRW = getFramePropsRW;
+    a.propNumKeys = propNumKeys;
+    a.propGetKey = propGetKey;
+    a.propNumElements = propNumElements;
+    a.propGetType = propGetType;
+    a.propGetInt = propGetInt;
+    a.propGetFloat = propGetFloat;
+    a.propGetData = propGetData;
+    a.propGetDataSize = propGetDataSize;
+    a.propGetNode = propGetNode;
+    a.propGetFrame = propGetFrame;
+    a.propGetFunc = propGetFunc;
+    a.propDeleteKey = propDeleteKey;
+    a.propSetInt = propSetInt;
+    a.propSetFloat = propSetFloat;
+    a.propSetData = propSetData;
+    a.propSetNode = propSetNode;
+    a.propSetFrame = propSetFrame;
+    a.propSetFunc = propSetFunc;
+    a.propGetIntArray = propGetIntArray;
+    a.propSetIntArray = propSetIntArray;
+    a.logMessage = logMessage;
+    return a;
+  }();
+  return &api;
+}
+
+// AnalyzeHost
+
+AnalyzeHost::AnalyzeHost(int cacheFrames) : vscore(new VSCore)
+{
+  vscore->cacheFrames = (size_t)std::max(cacheFrames, 1);
+  vscore->linearFilters = &linearFilters;
+}
+
+AnalyzeHost::~AnalyzeHost()
+{
+  delete vscore;
+}
+
+const VSAPI *AnalyzeHost::api() const
+{
+  return hostApi();
+}
+
+static void VS_CC configPlugin(const char *identifier, const char *defaultNamespace, const char *name, int apiVersion, int readonly, VSPlugin *plugin)
+{
+  (void)identifier; (void)defaultNamespace; (void)name; (void)apiVersion; (void)readonly; (void)plugin;
+}
+
+static void VS_CC registerFunction(const char *name, const char *args, VSPublicFunction argsFunc, void *functionData, VSPlugin *plugin)
+{
+  plugin->add(name, args, argsFunc, functionData);
+}
+
+void AnalyzeHost::loadPlugin(VSInitPlugin init)
+{
+  VSPlugin plugin = { "", [this](const char *name, const char *args, VSPublicFunction func, void *data) {
+    functions[name] = { args, func, data };
+  } };
+  init(configPlugin, registerFunction, &plugin);
+}
+
+VSMap *AnalyzeHost::invoke(const char *name, const VSMap *args) const
+{
+  VSMap *out = new VSMap;
+  auto it = functions.find(name);
+  if (it == functions.end())
+    setError(out, (std::string("no function named ") + name).c_str());
+  else
+    it->second.func(args, out, it->second.data, vscore, hostApi());
+  return out;
+}
+
+char AnalyzeHost::argType(const char *name, const char *arg) const
+{
+  auto it = functions.find(name);
+  if (it == functions.end())
+    return 0;
+  // "name:type[:opt];..."
+  const std::string &args = it->second.args;
+  const std::string key = std::string(arg) + ":";
+  for (size_t pos = 0; pos < args.size();)
+  {
+    size_t end = args.find(';', pos);
+    if (end == std::string::npos) end = args.size();
+    if (args.compare(pos, key.size(), key) == 0)
+    {
+      const size_t start = pos + key.size();
+      const std::string type = args.substr(start, std::min(args.find(':', start), end) - start);
+      return type == "int" ? ptInt : type == "float" ? ptFloat : type == "data" ? ptData :
+        type == "clip" ? ptNode : 0;
+    }
+    pos = end + 1;
+  }
+  return 0;
+}
+
+VSNodeRef *AnalyzeHost::createSource(const VSVideoInfo &vi, SourceFunc func, bool sequential)
+{
+  auto node = std::make_shared<VSNode>("Source", vscore);
+  node->vi = vi;
+  node->source = std::move(func);
+  node->sequential = sequential;
+  return new VSNodeRef{ node };
+}
+
+void AnalyzeHost::setLinear(const char *filterName)
+{
+  linearFilters.insert(filterName);
+}
@@ -0,0 +1,87 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef ANALYZEHOST_H
+#define ANALYZEHOST_H
+
+/*
+** Minimal in-process implementation of the VapourSynth API for
+** tivtc-analyze.
+**
+** Only the subset used by TFM, TFMPP and TDecimate is provided. Filters
+** are created through the functions the plugin registers, and frames are
+** produced synchronously on the calling thread: a request first runs the
+** filter with arInitial, fetches everything it asked for, then calls it
+** again with arAllFramesReady. Each node keeps a small cache of finished
+** frames so neighbouring requests share them. Filters that are not
+** fmParallel are called under a per node lock, as the real core does.
+*/
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <VapourSynth.h>
+
+class AnalyzeHost
+{
+public:
+  // fills dst, a new frame of the source's format, with frame n
+  typedef std::function<void(int n, VSFrameRef *dst, const VSAPI *vsapi)> SourceFunc;
+
+  explicit AnalyzeHost(int cacheFrames);
+  ~AnalyzeHost();
+
+  const VSAPI *api() const;
+  VSCore *core() const { return vscore; }
+
+  // registers the functions of a plugin, VapourSynthPluginInit for TIVTC
+  void loadPlugin(VSInitPlugin init);
+  // calls a registered function, the caller frees the returned map
+  VSMap *invoke(const char *name, const VSMap *args) const;
+  // argument type of a registered function: 'i', 'f', 's', 'c' or 0 if unknown
+  char argType(const char *name, const char *arg) const;
+
+  // node of a source read by func; sequential sources are only read in order,
+  // apart from frames still in the node cache
+  VSNodeRef *createSource(const VSVideoInfo &vi, SourceFunc func, bool sequential);
+  // filters created with this name produce all frames before n before
+  // frame n, like nfMakeLinear
+  void setLinear(const char *filterName);
+
+private:
+  struct Function {
+    std::string args;
+    VSPublicFunction func;
+    void *data;
+  };
+  std::map<std::string, Function> functions;
+  VSCore *vscore;
+  std::set<std::string> linearFilters;
+};
+
+#endif // ANALYZEHOST_H
@@ -0,0 +1,763 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+** tivtc-bench: microbenchmarks of the SIMD kernels.
+**
+** Each kernel runs on synthetic planes for every selected frame size,
+** bit depth and instruction set the CPU supports. Kernels that pick their
+** own code path get a copy of the CPU flags capped at the measured level.
+** The first variant of a kernel that runs is the reference, the output of
+** every other variant is compared against it ("ok~" is within the
+** kernel's rounding tolerance).
+**
+** Bandwidth counts each source plane read once and each destination plane
+** written once. Cycles are time stamp counter ticks, which may differ from
+** core clock cycles when the CPU boosts or throttles.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef VS_TARGET_CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#include <VapourSynth.h>
+#include <VSHelper.h>
+
+#include "AnalyzeHost.h"
+#include "TCommonASM.h"
+#include "TDecimateASM.h"
+#include "TFMasm.h"
+#include "TFMPP.h"
+#include "cpufeatures.h"
+#include "internal.h"
+
+enum Isa { isaC, isaSSE2, isaSSE41, isaAVX2, isaAVX512, isaCount };
+static const char *const isaNames[isaCount] = { "c", "sse2", "sse4.1", "avx2", "avx512" };
+
+// rows above and below each plane, cubicDeintMask reads two field lines up
+static const int kBorder = 4;
+
+struct Plane {
+  std::vector<uint8_t> mem;
+  uint8_t *ptr; // row 0
+  int stride;
+
+  void alloc(int width, int height, int pixelsize)
+  {
+    // room on the right for kernels that work in whole vectors
+    stride = (width * pixelsize + 64 + 63) & ~63;
+    mem.assign((size_t)stride * (height + 2 * kBorder) + 64, 0);
+    uint8_t *base = mem.data() + ((64 - (reinterpret_cast<uintptr_t>(mem.data()) & 63)) & 63);
+    ptr = base + kBorder * stride;
+  }
+  uint8_t *row(int y) const { return ptr + (ptrdiff_t)y * stride; }
+};
+
+struct Buffers {
+  int width, height, bits, pixelsize;
+  VSVideoInfo vi;
+  CPUFeatures cpu[isaCount]; // capped copies of the CPU flags
+  Plane src[3], mask, tbuffer; // inputs
+  Plane dst, dstMask; // outputs
+  std::vector<uint64_t> hbsum;
+  const VSAPI *vsapi;
+  VSFrameRef *frameIn, *frameOut;
+
+  // hbsum row pitch of TDecimate's block grid, the caller zeroes hbsum
+  int hbpitch(int blockShift, int blockHalf) const
+  {
+    return (((width + blockHalf) >> blockShift) + 1) << 1;
+  }
+};
+
+struct Kernel {
+  const char *name;
+  Isa isa;
+  bool lowbd, hbd; // runs at 8 bits, at 10-16 bits
+  int srcPlanes, dstPlanes; // pixel planes read and written
+  int maskBytes; // 8 bit mask bytes read or written per pixel
+  std::function<uint64_t(Buffers &b)> run; // returns the kernel's scalar result, if any
+  int tolerance = 0; // largest difference of an output byte from the reference
+};
+
+struct Output {
+  std::vector<uint8_t> data;
+  uint64_t result;
+};
+
+static bool isaSupported(Isa isa)
+{
+  const CPUFeatures *cpu = getCPUFeatures();
+  switch (isa)
+  {
+  case isaC: return true;
+  case isaSSE2: return cpu->sse2;
+  case isaSSE41: return cpu->sse4_1;
+#ifdef VS_TARGET_CPU_X86
+  case isaAVX2: return cpu->avx2;
+  case isaAVX512: return cpu->avx512_f && cpu->avx512_bw;
+#endif
+  default: return false;
+  }
+}
+
+static CPUFeatures cappedFeatures(Isa isa)
+{
+  CPUFeatures f = *getCPUFeatures();
+  if (isa == isaC)
+    memset(&f, 0, sizeof(f));
+  if (isa < isaSSE41)
+    f.ssse3 = f.sse4_1 = f.sse4_2 = 0;
+#ifdef VS_TARGET_CPU_X86
+  if (isa < isaAVX2)
+    f.avx = f.avx2 = f.fma3 = f.f16c = 0;
+  if (isa < isaAVX512)
+    f.avx512_f = f.avx512_cd = f.avx512_bw = f.avx512_dq = f.avx512_vl = 0;
+#endif
+  return f;
+}
+
+static uint64_t readCycles()
+{
+#ifdef VS_TARGET_CPU_X86
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// interlaced looking texture: gradient, noise, a combed stripe on odd lines
+// and horizontal motion between the source planes
+static void fillSources(Buffers &b)
+{
+  const int maxval = (1 << b.bits) - 1;
+  const int scale = b.bits - 8;
+  uint32_t seed = 12345;
+  std::vector<int> noise((size_t)b.src[0].stride * (b.height + 2 * kBorder));
+  for (int &v : noise)
+  {
+    seed = seed * 1103515245 + 12345;
+    v = (int)((seed >> 16) & 15) << scale;
+  }
+  for (int p = 0; p < 3; ++p)
+  {
+    const int shift = p * 3;
+    for (int y = -kBorder; y < b.height + kBorder; ++y)
+    {
+      uint8_t *row = b.src[p].row(y);
+      const int *n = noise.data() + (size_t)(y + kBorder) * b.src[0].stride;
+      const int samples = b.src[p].stride / b.pixelsize;
+      for (int x = 0; x < samples; ++x)
+      {
+        int v = ((x + shift) * 3 + y * 2) & 255;
+        if ((y & 1) && x >= b.width / 4 && x < b.width / 2)
+          v = 255 - v;
+        v = std::min((v << scale) + n[(x + shift) % samples], maxval);
+        if (b.pixelsize == 1)
+          row[x] = (uint8_t)v;
+        else
+          reinterpret_cast<uint16_t *>(row)[x] = (uint16_t)v;
+      }
+    }
+  }
+  for (int y = -kBorder; y < b.height + kBorder; ++y)
+  {
+    uint8_t *row = b.mask.row(y);
+    for (int x = 0; x < b.mask.stride; ++x)
+      row[x] = ((x >> 4) + (y >> 3)) % 3 == 0 ? 0xFF : 0;
+  }
+}
+
+static void setupBuffers(Buffers &b, const AnalyzeHost &host, int width, int height, int bits)
+{
+  b.width = width;
+  b.height = height;
+  b.bits = bits;
+  b.pixelsize = bits > 8 ? 2 : 1;
+  b.vsapi = host.api();
+  memset(&b.vi, 0, sizeof(b.vi));
+  b.vi.format = b.vsapi->registerFormat(cmGray, stInteger, bits, 0, 0, host.core());
+  b.vi.width = width;
+  b.vi.height = height;
+  for (int i = 0; i < isaCount; ++i)
+    b.cpu[i] = cappedFeatures((Isa)i);
+  for (Plane &p : b.src)
+    p.alloc(width, height, b.pixelsize);
+  b.tbuffer.alloc(width, height, b.pixelsize);
+  b.dst.alloc(width, height, b.pixelsize);
+  b.mask.alloc(width, height, 1);
+  b.dstMask.alloc(width, height, 1);
+  // enough for the smallest block size used below
+  b.hbsum.assign((size_t)b.hbpitch(3, 4) * (((height + 4) >> 3) + 1) * 2, 0);
+  fillSources(b);
+
+  // field differences, the input of AnalyzeDiffMask
+  if (b.pixelsize == 1)
+    do_buildABSDiffMask<uint8_t>(b.src[0].ptr, b.src[1].ptr, b.tbuffer.ptr, b.src[0].stride, b.src[1].stride, b.tbuffer.stride, width, height, &b.cpu[isaC]);
+  else
+    do_buildABSDiffMask<uint16_t>(b.src[0].ptr, b.src[1].ptr, b.tbuffer.ptr, b.src[0].stride, b.src[1].stride, b.tbuffer.stride, width, height, &b.cpu[isaC]);
+
+  b.frameIn = b.vsapi->newVideoFrame(b.vi.format, width, height, nullptr, host.core());
+  b.frameOut = b.vsapi->newVideoFrame(b.vi.format, width, height, nullptr, host.core());
+  vs_bitblt(b.vsapi->getWritePtr(b.frameIn, 0), b.vsapi->getStride(b.frameIn, 0), b.src[0].ptr, b.src[0].stride,
+    width * b.pixelsize, height);
+}
+
+static void freeBuffers(Buffers &b)
+{
+  b.vsapi->freeFrame(b.frameIn);
+  b.vsapi->freeFrame(b.frameOut);
+}
+
+static void clearOutputs(Buffers &b)
+{
+  std::fill(b.dst.mem.begin(), b.dst.mem.end(), 0);
+  std::fill(b.dstMask.mem.begin(), b.dstMask.mem.end(), 0);
+  std::fill(b.hbsum.begin(), b.hbsum.end(), 0);
+  uint8_t *p = b.vsapi->getWritePtr(b.frameOut, 0);
+  memset(p, 0, (size_t)b.vsapi->getStride(b.frameOut, 0) * b.height);
+}
+
+static Output collectOutputs(const Buffers &b, uint64_t result)
+{
+  Output out;
+  out.result = result;
+  auto append = [&out](const uint8_t *p, int stride, int rowsize, int rows) {
+    for (int y = 0; y < rows; ++y, p += stride)
+      out.data.insert(out.data.end(), p, p + rowsize);
+  };
+  append(b.dst.ptr, b.dst.stride, b.width * b.pixelsize, b.height);
+  append(b.dstMask.ptr, b.dstMask.stride, b.width, b.height);
+  append(reinterpret_cast<const uint8_t *>(b.hbsum.data()), 0, (int)(b.hbsum.size() * sizeof(uint64_t)), 1);
+  append(b.vsapi->getReadPtr(b.frameOut, 0), b.vsapi->getStride(b.frameOut, 0), b.width * b.pixelsize, b.height);
+  return out;
+}
+
+static void analyzeDiffMask(Buffers &b)
+{
+  switch (b.bits)
+  {
+  case 8: AnalyzeDiffMask_Planar<uint8_t, 8>(b.dstMask.ptr, b.dstMask.stride, b.tbuffer.ptr, b.tbuffer.stride, b.width, b.height); break;
+  case 10: AnalyzeDiffMask_Planar<uint16_t, 10>(b.dstMask.ptr, b.dstMask.stride, b.tbuffer.ptr, b.tbuffer.stride, b.width, b.height); break;
+  case 12: AnalyzeDiffMask_Planar<uint16_t, 12>(b.dstMask.ptr, b.dstMask.stride, b.tbuffer.ptr, b.tbuffer.stride, b.width, b.height); break;
+  case 14: AnalyzeDiffMask_Planar<uint16_t, 14>(b.dstMask.ptr, b.dstMask.stride, b.tbuffer.ptr, b.tbuffer.stride, b.width, b.height); break;
+  case 16: AnalyzeDiffMask_Planar<uint16_t, 16>(b.dstMask.ptr, b.dstMask.stride, b.tbuffer.ptr, b.tbuffer.stride, b.width, b.height); break;
+  }
+}
+
+// the middle lines of TFMPP's cubic deinterlacer, field pitch is twice the plane's
+template<typename pixel_t, int bits_per_pixel>
+static void cubicDeintMaskC(Buffers &b)
+{
+  cubicDeintMask_C<pixel_t, bits_per_pixel, true>(
+    reinterpret_cast<const pixel_t *>(b.src[0].row(2)), reinterpret_cast<pixel_t *>(b.dst.row(1)), b.mask.row(1),
+    b.src[0].stride * 2 / (int)sizeof(pixel_t), b.dst.stride * 2 / (int)sizeof(pixel_t), b.mask.stride * 2,
+    b.width, b.height / 2 - 3);
+}
+
+static void cubicDeintMask(Buffers &b, Isa isa)
+{
+  if (isa == isaSSE2)
+    cubicDeintMask_SSE2<true>(b.src[0].row(2), b.dst.row(1), b.mask.row(1), b.src[0].stride * 2, b.dst.stride * 2,
+      b.mask.stride * 2, b.width, b.height / 2 - 3);
+  else switch (b.bits)
+  {
+  case 8: cubicDeintMaskC<uint8_t, 8>(b); break;
+  case 10: cubicDeintMaskC<uint16_t, 10>(b); break;
+  case 12: cubicDeintMaskC<uint16_t, 12>(b); break;
+  case 14: cubicDeintMaskC<uint16_t, 14>(b); break;
+  case 16: cubicDeintMaskC<uint16_t, 16>(b); break;
+  }
+}
+
+typedef decltype(calcDiff_SADorSSD_Colsum_SSE2<uint8_t, true>) CalcDiffFn;
+
+// TDecimate's block difference with blocks of 1 << shift, as CalcMetricsExtracted calls it
+static uint64_t calcDiff(Buffers &b, CalcDiffFn *fn, int shift, int nt)
+{
+  const int half = 1 << (shift - 1);
+  return fn(b.src[0].ptr, b.src[1].ptr, b.src[0].stride / b.pixelsize, b.src[1].stride / b.pixelsize, b.width, b.height, 0,
+    b.hbpitch(shift, half), b.hbsum.data(), false, shift, shift, half, half, nt, &b.vi);
+}
+
+template<bool SAD>
+static uint64_t calcDiffC(const uint8_t *prvp, const uint8_t *curp, int prv_pitch, int cur_pitch, int width, int height,
+  int plane, int hbpitch, uint64_t *hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi)
+{
+  if (vi->format->bytesPerSample == 1)
+    return calcDiff_SADorSSD_Generic_c<uint8_t, SAD, 1>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum,
+      chroma, xshiftS, yshiftS, xhalfS, yhalfS, nt, vi);
+  return calcDiff_SADorSSD_Generic_c<uint16_t, SAD, 1>(reinterpret_cast<const uint16_t *>(prvp), reinterpret_cast<const uint16_t *>(curp),
+    prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum, chroma, xshiftS, yshiftS, xhalfS, yhalfS, nt, vi);
+}
+
+// the fixed block size kernels, without the nt argument
+template<uint64_t (*fn)(const uint8_t *, const uint8_t *, int, int, int, int, int, int, uint64_t *, bool, const VSVideoInfo *)>
+static uint64_t calcDiff32(const uint8_t *prvp, const uint8_t *curp, int prv_pitch, int cur_pitch, int width, int height,
+  int plane, int hbpitch, uint64_t *hbsum, bool chroma, int, int, int, int, int, const VSVideoInfo *vi)
+{
+  return fn(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum, chroma, vi);
+}
+
+template<uint64_t (*fn)(const uint8_t *, const uint8_t *, int, int, int, int, int, int, uint64_t *, bool, int, int, int, int, const VSVideoInfo *)>
+static uint64_t calcDiffGeneric(const uint8_t *prvp, const uint8_t *curp, int prv_pitch, int cur_pitch, int width, int height,
+  int plane, int hbpitch, uint64_t *hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int, const VSVideoInfo *vi)
+{
+  return fn(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum, chroma, xshiftS, yshiftS, xhalfS, yhalfS, vi);
+}
+
+static std::vector<Kernel> kernelList()
+{
+  std::vector<Kernel> k;
+
+  // TCommonASM
+  k.push_back({ "check_combing", isaC, true, true, 1, 0, 1, [](Buffers &b) {
+    if (b.pixelsize == 1)
+      check_combing_c<uint8_t>(b.src[0].ptr, b.dstMask.ptr, b.width, b.height, b.src[0].stride, b.dstMask.stride, 9);
+    else
+      check_combing_c<uint16_t>(reinterpret_cast<const uint16_t *>(b.src[0].ptr), b.dstMask.ptr, b.width, b.height,
+        b.src[0].stride / 2, b.dstMask.stride, 9 << (b.bits - 8));
+    return (uint64_t)0; } });
+  k.push_back({ "check_combing", isaSSE2, true, false, 1, 0, 1, [](Buffers &b) {
+    check_combing_SSE2(b.src[0].ptr, b.dstMask.ptr, b.width, b.height, b.src[0].stride, b.dstMask.stride, 9);
+    return (uint64_t)0; } });
+  k.push_back({ "check_combing", isaSSE41, false, true, 1, 0, 1, [](Buffers &b) {
+    check_combing_uint16_SSE4(reinterpret_cast<const uint16_t *>(b.src[0].ptr), b.dstMask.ptr, b.width, b.height,
+      b.src[0].stride / 2, b.dstMask.stride, 9 << (b.bits - 8));
+    return (uint64_t)0; } });
+
+  k.push_back({ "check_combing_metric1", isaC, true, true, 1, 0, 1, [](Buffers &b) {
+    const int cthresh = 9 << (b.bits - 8);
+    if (b.pixelsize == 1)
+      check_combing_c_Metric1<uint8_t, int>(b.src[0].ptr, b.dstMask.ptr, b.width, b.height, b.src[0].stride, b.dstMask.stride,
+        cthresh * cthresh);
+    else
+      check_combing_c_Metric1<uint16_t, int64_t>(reinterpret_cast<const uint16_t *>(b.src[0].ptr), b.dstMask.ptr, b.width, b.height,
+        b.src[0].stride / 2, b.dstMask.stride, (int64_t)cthresh * cthresh);
+    return (uint64_t)0; } });
+  k.push_back({ "check_combing_metric1", isaSSE2, true, false, 1, 0, 1, [](Buffers &b) {
+    check_combing_SSE2_Metric1(b.src[0].ptr, b.dstMask.ptr, b.width, b.height, b.src[0].stride, b.dstMask.stride, 81);
+    return (uint64_t)0; } });
+
+  k.push_back({ "absDiff", isaC, true, true, 2, 0, 1, [](Buffers &b) {
+    if (b.pixelsize == 1)
+      absDiff_c(b.src[0].ptr, b.src[1].ptr, b.dstMask.ptr, b.src[0].stride, b.src[1].stride, b.dstMask.stride, b.width, b.height, 5, 5);
+    else
+      absDiff_uint16_c(b.src[0].ptr, b.src[1].ptr, b.dstMask.ptr, b.src[0].stride, b.src[1].stride, b.dstMask.stride, b.width, b.height,
+        5 << (b.bits - 8));
+    return (uint64_t)0; } });
+  k.push_back({ "absDiff", isaSSE2, true, false, 2, 0, 1, [](Buffers &b) {
+    absDiff_SSE2(b.src[0].ptr, b.src[1].ptr, b.dstMask.ptr, b.src[0].stride, b.src[1].stride, b.dstMask.stride, b.width, b.height, 5, 5);
+    return (uint64_t)0; } });
+
+  for (Isa isa : { isaC, isaSSE2 })
+  {
+    k.push_back({ "buildABSDiffMask", isa, true, true, 2, 1, 0, [isa](Buffers &b) {
+      if (b.pixelsize == 1)
+        do_buildABSDiffMask<uint8_t>(b.src[0].ptr, b.src[1].ptr, b.dst.ptr, b.src[0].stride, b.src[1].stride, b.dst.stride,
+          b.width, b.height, &b.cpu[isa]);
+      else
+        do_buildABSDiffMask<uint16_t>(b.src[0].ptr, b.src[1].ptr, b.dst.ptr, b.src[0].stride, b.src[1].stride, b.dst.stride,
+          b.width, b.height, &b.cpu[isa]);
+      return (uint64_t)0; } });
+  }
+  for (Isa isa : { isaC, isaSSE2 })
+  {
+    k.push_back({ "buildABSDiffMask2", isa, true, true, 2, 0, 1, [isa](Buffers &b) {
+      if (b.pixelsize == 1)
+        do_buildABSDiffMask2<uint8_t>(b.src[0].ptr, b.src[1].ptr, b.dstMask.ptr, b.src[0].stride, b.src[1].stride, b.dstMask.stride,
+          b.width, b.height, &b.cpu[isa], b.bits);
+      else
+        do_buildABSDiffMask2<uint16_t>(b.src[0].ptr, b.src[1].ptr, b.dstMask.ptr, b.src[0].stride, b.src[1].stride, b.dstMask.stride,
+          b.width, b.height, &b.cpu[isa], b.bits);
+      return (uint64_t)0; } });
+  }
+  // reads half height field differences, marks every other line
+  k.push_back({ "AnalyzeDiffMask_Planar", isaC, true, true, 1, 0, 1, [](Buffers &b) {
+    analyzeDiffMask(b);
+    return (uint64_t)0; } });
+
+  k.push_back({ "blend_5050", isaC, true, true, 2, 1, 0, [](Buffers &b) {
+    if (b.pixelsize == 1)
+      blend_5050_c<uint8_t>(b.dst.ptr, b.src[0].ptr, b.src[1].ptr, b.width, b.height, b.dst.stride, b.src[0].stride, b.src[1].stride);
+    else
+      blend_5050_c<uint16_t>(b.dst.ptr, b.src[0].ptr, b.src[1].ptr, b.width, b.height, b.dst.stride, b.src[0].stride, b.src[1].stride);
+    return (uint64_t)0; } });
+  k.push_back({ "blend_5050", isaSSE2, true, true, 2, 1, 0, [](Buffers &b) {
+    if (b.pixelsize == 1)
+      blend_5050_SSE2<uint8_t>(b.dst.ptr, b.src[0].ptr, b.src[1].ptr, b.width, b.height, b.dst.stride, b.src[0].stride, b.src[1].stride);
+    else
+      blend_5050_SSE2<uint16_t>(b.dst.ptr, b.src[0].ptr, b.src[1].ptr, b.width, b.height, b.dst.stride, b.src[0].stride, b.src[1].stride);
+    return (uint64_t)0; } });
+
+  // TDecimateASM
+  // 30% blend, TDecimate's hybrid output
+  // the 8 bit SSE2 blend does not round like the C version
+  for (Isa isa : { isaC, isaSSE2, isaSSE41 })
+  {
+    k.push_back({ "dispatch_blend", isa, isa != isaSSE41, isa != isaSSE2, 2, 1, 0, [isa](Buffers &b) {
+      dispatch_blend(b.dst.ptr, b.src[0].ptr, b.src[1].ptr, b.width, b.height, b.dst.stride, b.src[0].stride, b.src[1].stride,
+        32768 * 3 / 10, b.bits, &b.cpu[isa]);
+      return (uint64_t)0; }, isa == isaSSE2 ? 1 : 0 });
+  }
+
+  struct CalcDiffVariant { const char *name; Isa isa; bool lowbd, hbd; CalcDiffFn *fn; int shift, nt; };
+  const CalcDiffVariant calcDiffs[] = {
+    { "calcDiffSAD_32x32", isaC, true, false, calcDiffC<true>, 5, 0 },
+    { "calcDiffSAD_32x32", isaSSE2, true, false, calcDiff32<calcDiffSAD_32x32_SSE2>, 5, 0 },
+    { "calcDiffSSD_32x32", isaC, true, false, calcDiffC<false>, 5, 0 },
+    { "calcDiffSSD_32x32", isaSSE2, true, false, calcDiff32<calcDiffSSD_32x32_SSE2>, 5, 0 },
+    { "calcDiffSAD_16x16", isaC, true, false, calcDiffC<true>, 4, 0 },
+    { "calcDiffSAD_16x16", isaSSE2, true, false, calcDiffGeneric<calcDiffSAD_Generic_SSE2>, 4, 0 },
+    { "calcDiffSSD_16x16", isaC, true, false, calcDiffC<false>, 4, 0 },
+    { "calcDiffSSD_16x16", isaSSE2, true, false, calcDiffGeneric<calcDiffSSD_Generic_SSE2>, 4, 0 },
+    // any block size and nt, blocks of 8 with nt=2 here
+    { "calcDiffSAD_colsum", isaC, true, true, calcDiffC<true>, 3, 2 },
+    { "calcDiffSAD_colsum", isaSSE2, true, false, calcDiff_SADorSSD_Colsum_SSE2<uint8_t, true>, 3, 2 },
+    { "calcDiffSAD_colsum", isaSSE2, false, true, calcDiff_SADorSSD_Colsum_SSE2<uint16_t, true>, 3, 2 },
+    { "calcDiffSSD_colsum", isaC, true, true, calcDiffC<false>, 3, 2 },
+    { "calcDiffSSD_colsum", isaSSE2, true, false, calcDiff_SADorSSD_Colsum_SSE2<uint8_t, false>, 3, 2 },
+    { "calcDiffSSD_colsum", isaSSE2, false, true, calcDiff_SADorSSD_Colsum_SSE2<uint16_t, false>, 3, 2 },
+#ifdef VS_TARGET_CPU_X86
+    { "calcDiffSAD_32x32", isaAVX2, true, false, calcDiff32<calcDiffSAD_32x32_AVX2>, 5, 0 },
+    { "calcDiffSSD_32x32", isaAVX2, true, false, calcDiff32<calcDiffSSD_32x32_AVX2>, 5, 0 },
+    { "calcDiffSAD_16x16", isaAVX2, true, false, calcDiffGeneric<calcDiffSAD_Generic_AVX2>, 4, 0 },
+    { "calcDiffSSD_16x16", isaAVX2, true, false, calcDiffGeneric<calcDiffSSD_Generic_AVX2>, 4, 0 },
+    { "calcDiffSAD_colsum", isaAVX2, true, false, calcDiff_SADorSSD_Colsum_AVX2<uint8_t, true>, 3, 2 },
+    { "calcDiffSAD_colsum", isaAVX2, false, true, calcDiff_SADorSSD_Colsum_AVX2<uint16_t, true>, 3, 2 },
+    { "calcDiffSSD_colsum", isaAVX2, true, false, calcDiff_SADorSSD_Colsum_AVX2<uint8_t, false>, 3, 2 },
+    { "calcDiffSSD_colsum", isaAVX2, false, true, calcDiff_SADorSSD_Colsum_AVX2<uint16_t, false>, 3, 2 },
+    { "calcDiffSAD_colsum", isaAVX512, true, false, calcDiff_SADorSSD_Colsum_AVX512<uint8_t, true>, 3, 2 },
+    { "calcDiffSAD_colsum", isaAVX512, false, true, calcDiff_SADorSSD_Colsum_AVX512<uint16_t, true>, 3, 2 },
+    { "calcDiffSSD_colsum", isaAVX512, true, false, calcDiff_SADorSSD_Colsum_AVX512<uint8_t, false>, 3, 2 },
+    { "calcDiffSSD_colsum", isaAVX512, false, true, calcDiff_SADorSSD_Colsum_AVX512<uint16_t, false>, 3, 2 },
+#endif
+  };
+  for (const CalcDiffVariant &v : calcDiffs)
+  {
+    k.push_back({ v.name, v.isa, v.lowbd, v.hbd, 2, 0, 0, [v](Buffers &b) {
+      return calcDiff(b, v.fn, v.shift, v.nt); } });
+  }
+
+  // TDecimateBlur, one pass of the 3x3 blur TDecimate's denoise runs twice
+  for (Isa isa : { isaC, isaSSE2, isaAVX2 })
+  {
+    k.push_back({ "blurFrame", isa, true, true, 1, 1, 0, [isa](Buffers &b) {
+      blurFrame(b.frameIn, b.frameOut, 1, false, &b.cpu[isa], nullptr, b.vsapi);
+      return (uint64_t)0; } });
+  }
+
+  // TFMASM
+  k.push_back({ "checkSceneChangePlanar_1", isaSSE2, true, false, 2, 0, 0, [](Buffers &b) {
+    uint64_t diffp = 0;
+    checkSceneChangePlanar_1_SSE2(b.src[0].ptr, b.src[1].ptr, b.height, b.width, b.src[0].stride, b.src[1].stride, diffp);
+    return diffp; } });
+  k.push_back({ "checkSceneChangePlanar_2", isaSSE2, true, false, 3, 0, 0, [](Buffers &b) {
+    uint64_t diffp = 0, diffn = 0;
+    checkSceneChangePlanar_2_SSE2(b.src[0].ptr, b.src[1].ptr, b.src[2].ptr, b.height, b.width, b.src[0].stride, b.src[1].stride,
+      b.src[2].stride, diffp, diffn);
+    return diffp * 31 + diffn; } });
+
+  // TFMPP
+  k.push_back({ "maskClip2", isaC, true, true, 2, 1, 1, [](Buffers &b) {
+    (b.pixelsize == 1 ? maskClip2_C<uint8_t> : maskClip2_C<uint16_t>)(b.src[0].ptr, b.src[1].ptr, b.mask.ptr, b.dst.ptr,
+      b.src[0].stride, b.src[1].stride, b.mask.stride, b.dst.stride, b.width, b.height);
+    return (uint64_t)0; } });
+  k.push_back({ "maskClip2", isaSSE2, true, false, 2, 1, 1, [](Buffers &b) {
+    maskClip2_SSE2(b.src[0].ptr, b.src[1].ptr, b.mask.ptr, b.dst.ptr, b.src[0].stride, b.src[1].stride, b.mask.stride, b.dst.stride,
+      b.width, b.height);
+    return (uint64_t)0; } });
+  k.push_back({ "maskClip2", isaSSE41, true, true, 2, 1, 1, [](Buffers &b) {
+    (b.pixelsize == 1 ? maskClip2_SSE4<uint8_t> : maskClip2_SSE4<uint16_t>)(b.src[0].ptr, b.src[1].ptr, b.mask.ptr, b.dst.ptr,
+      b.src[0].stride, b.src[1].stride, b.mask.stride, b.dst.stride, b.width, b.height);
+    return (uint64_t)0; } });
+
+  k.push_back({ "blendDeintMask", isaC, true, true, 1, 1, 1, [](Buffers &b) {
+    if (b.pixelsize == 1)
+      blendDeintMask_C<uint8_t, true>(b.src[0].row(1), b.dst.row(1), b.mask.row(1), b.src[0].stride, b.dst.stride, b.mask.stride,
+        b.width, b.height - 2);
+    else
+      blendDeintMask_C<uint16_t, true>(reinterpret_cast<const uint16_t *>(b.src[0].row(1)), reinterpret_cast<uint16_t *>(b.dst.row(1)),
+        b.mask.row(1), b.src[0].stride / 2, b.dst.stride / 2, b.mask.stride, b.width, b.height - 2);
+    return (uint64_t)0; } });
+  k.push_back({ "blendDeintMask", isaSSE2, true, false, 1, 1, 1, [](Buffers &b) {
+    blendDeintMask_SSE2<true>(b.src[0].row(1), b.dst.row(1), b.mask.row(1), b.src[0].stride, b.dst.stride, b.mask.stride,
+      b.width, b.height - 2);
+    return (uint64_t)0; } });
+
+  // field lines only, half the plane
+  k.push_back({ "cubicDeintMask", isaC, true, true, 1, 1, 1, [](Buffers &b) {
+    cubicDeintMask(b, isaC);
+    return (uint64_t)0; } });
+  k.push_back({ "cubicDeintMask", isaSSE2, true, false, 1, 1, 1, [](Buffers &b) {
+    cubicDeintMask(b, isaSSE2);
+    return (uint64_t)0; } });
+
+  // variants of a kernel next to each other, in the order the names first appear
+  std::map<std::string, size_t> order;
+  for (const Kernel &kernel : k)
+    order.emplace(kernel.name, order.size());
+  std::stable_sort(k.begin(), k.end(), [&order](const Kernel &a, const Kernel &b) {
+    return order[a.name] < order[b.name];
+  });
+  return k;
+}
+
+// "ok", "ok~" within the tolerance, or "MISMATCH"
+static const char *compareOutputs(const Output &ref, const Output &out, int tolerance)
+{
+  if (ref.result != out.result || ref.data.size() != out.data.size())
+    return "MISMATCH";
+  int maxDiff = 0;
+  for (size_t i = 0; i < ref.data.size(); ++i)
+    maxDiff = std::max(maxDiff, std::abs(ref.data[i] - out.data[i]));
+  if (maxDiff == 0)
+    return "ok";
+  return maxDiff <= tolerance ? "ok~" : "MISMATCH";
+}
+
+struct Timing {
+  double seconds; // per call
+  double cycles;
+};
+
+// fastest of a few batches, each about a fifth of the time budget
+static Timing measure(const Kernel &kernel, Buffers &b, double budget)
+{
+  const int batches = 5;
+  volatile uint64_t sink = 0;
+  auto now = [] { return std::chrono::steady_clock::now(); };
+
+  int calls = 1;
+  for (;;)
+  {
+    const auto t0 = now();
+    for (int i = 0; i < calls; ++i)
+      sink = sink + kernel.run(b);
+    const double secs = std::chrono::duration<double>(now() - t0).count();
+    if (secs >= budget / batches / 4 || calls >= (1 << 24))
+    {
+      calls = std::max(1, (int)(calls * (budget / batches) / std::max(secs, 1e-9)));
+      break;
+    }
+    calls *= 2;
+  }
+
+  Timing best = { 1e30, 0 };
+  for (int i = 0; i < batches; ++i)
+  {
+    const auto t0 = now();
+    const uint64_t c0 = readCycles();
+    for (int j = 0; j < calls; ++j)
+      sink = sink + kernel.run(b);
+    const uint64_t c1 = readCycles();
+    const double secs = std::chrono::duration<double>(now() - t0).count() / calls;
+    if (secs < best.seconds)
+      best = { secs, (double)(c1 - c0) / calls };
+  }
+  (void)sink;
+  return best;
+}
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: tivtc-bench [options]\n"
+    "  --kernel NAME   run kernels whose name contains NAME, may be repeated\n"
+    "  --isa LIST      comma separated: c,sse2,sse4.1,avx2,avx512 (default: all the CPU has)\n"
+    "  --size WxH      frame size, may be repeated (default: 720x480, 1920x1080, 3840x2160)\n"
+    "  --bits N        8, 10, 12, 14 or 16, may be repeated (default: 8, 10, 16)\n"
+    "  --time MS       time spent on each measurement (default: 100)\n"
+    "  --list          list the kernels and exit\n");
+}
+
+struct Args {
+  std::vector<std::string> kernels;
+  bool isa[isaCount] = {};
+  bool isaGiven = false;
+  std::vector<std::pair<int, int>> sizes;
+  std::vector<int> bits;
+  double seconds = 0.1;
+  bool list = false;
+};
+
+static bool parseIsaList(const std::string &list, Args &args)
+{
+  size_t pos = 0;
+  while (pos <= list.size())
+  {
+    const size_t end = std::min(list.find(',', pos), list.size());
+    const std::string name = list.substr(pos, end - pos);
+    int i = 0;
+    while (i < isaCount && name != isaNames[i])
+      ++i;
+    if (i == isaCount)
+      return false;
+    args.isa[i] = true;
+    pos = end + 1;
+  }
+  args.isaGiven = true;
+  return true;
+}
+
+static bool parseArgs(int argc, char **argv, Args &args)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string a = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (a == "--kernel" && hasValue) args.kernels.push_back(argv[++i]);
+    else if (a == "--isa" && hasValue) { if (!parseIsaList(argv[++i], args)) return false; }
+    else if (a == "--size" && hasValue)
+    {
+      int w = 0, h = 0;
+      if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w < 32 || h < 16 || (w & 1))
+        return false;
+      args.sizes.emplace_back(w, h);
+    }
+    else if (a == "--bits" && hasValue)
+    {
+      const int bits = atoi(argv[++i]);
+      if (bits < 8 || bits > 16 || (bits & 1))
+        return false;
+      args.bits.push_back(bits);
+    }
+    else if (a == "--time" && hasValue) args.seconds = atof(argv[++i]) / 1000.0;
+    else if (a == "--list") args.list = true;
+    else return false;
+  }
+  if (args.sizes.empty())
+    args.sizes = { { 720, 480 }, { 1920, 1080 }, { 3840, 2160 } };
+  if (args.bits.empty())
+    args.bits = { 8, 10, 16 };
+  return args.seconds > 0;
+}
+
+static bool selected(const Args &args, const Kernel &kernel)
+{
+  if (args.isaGiven && !args.isa[kernel.isa])
+    return false;
+  if (args.kernels.empty())
+    return true;
+  for (const std::string &name : args.kernels)
+    if (strstr(kernel.name, name.c_str()))
+      return true;
+  return false;
+}
+
+static int run(const Args &args)
+{
+  const std::vector<Kernel> kernels = kernelList();
+  if (args.list)
+  {
+    for (const Kernel &kernel : kernels)
+      printf("%-26s %-7s %s%s\n", kernel.name, isaNames[kernel.isa], kernel.lowbd ? " 8" : "", kernel.hbd ? " 10-16" : "");
+    return 0;
+  }
+
+  AnalyzeHost host(0);
+#ifdef VS_TARGET_CPU_X86
+  const bool haveCycles = true;
+#else
+  const bool haveCycles = false;
+#endif
+  int mismatches = 0;
+
+  printf("%-26s %-7s %10s %4s %9s %8s  %s\n", "kernel", "isa", "size", "bits", "GB/s", "cyc/px", "check");
+  for (const auto &size : args.sizes)
+  {
+    for (int bits : args.bits)
+    {
+      Buffers b;
+      setupBuffers(b, host, size.first, size.second, bits);
+      const double pixels = (double)b.width * b.height;
+      char sizeName[32];
+      snprintf(sizeName, sizeof(sizeName), "%dx%d", b.width, b.height);
+      std::map<std::string, Output> reference;
+
+      for (const Kernel &kernel : kernels)
+      {
+        if (!(bits == 8 ? kernel.lowbd : kernel.hbd) || !selected(args, kernel) || !isaSupported(kernel.isa))
+          continue;
+
+        clearOutputs(b);
+        Output out = collectOutputs(b, kernel.run(b));
+        const char *check = "ref";
+        auto ref = reference.find(kernel.name);
+        if (ref == reference.end())
+          reference.emplace(kernel.name, std::move(out));
+        else
+        {
+          check = compareOutputs(ref->second, out, kernel.tolerance);
+          if (check[0] == 'M')
+            ++mismatches;
+        }
+
+        const Timing t = measure(kernel, b, args.seconds);
+        const double bytes = pixels * ((kernel.srcPlanes + kernel.dstPlanes) * b.pixelsize + kernel.maskBytes);
+        char cycles[32] = "-";
+        if (haveCycles)
+          snprintf(cycles, sizeof(cycles), "%8.3f", t.cycles / pixels);
+        printf("%-26s %-7s %10s %4d %9.2f %8s  %s\n", kernel.name, isaNames[kernel.isa], sizeName, bits,
+          bytes / t.seconds / 1e9, cycles, check);
+        fflush(stdout);
+      }
+      freeBuffers(b);
+    }
+  }
+  if (mismatches)
+    fprintf(stderr, "tivtc-bench: %d kernel(s) differ from their reference\n", mismatches);
+  return mismatches ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  Args args;
+  if (!parseArgs(argc, argv, args))
+  {
+    usage();
+    return 2;
+  }
+  try {
+    return run(args);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+}
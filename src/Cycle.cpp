@@ -445,6 +445,7 @@ Cycle::Cycle(int _size, int _sdlim)
   dect = dect2 = nullptr;
   diffMetricsU = diffMetricsUF = tArray = nullptr;
   diffMetricsN = nullptr;
+  arena = nullptr;
   cycleSize = std::max(0, _size);
   sdlim = _sdlim;
   allocSpace();
@@ -458,50 +459,32 @@ Cycle::Cycle(int _size, int _sdlim)
 
 Cycle::~Cycle()
 {
-  if (dupArray != nullptr) { free(dupArray); dupArray = nullptr; }
-  if (lowest != nullptr) { free(lowest); lowest = nullptr; }
-  if (match != nullptr) { free(match); match = nullptr; }
-  if (filmd2v != nullptr) { free(filmd2v); filmd2v = nullptr; }
-  if (decimate != nullptr) { free(decimate); decimate = nullptr; }
-  if (decimate2 != nullptr) { free(decimate2); decimate2 = nullptr; }
-  if (dect != nullptr) { free(dect); dect = nullptr; }
-  if (dect2 != nullptr) { free(dect2); dect2 = nullptr; }
-  if (diffMetricsU != nullptr) { free(diffMetricsU); diffMetricsU = nullptr; }
-  if (diffMetricsUF != nullptr) { free(diffMetricsUF); diffMetricsUF = nullptr; }
-  if (tArray != nullptr) { free(tArray); tArray = nullptr; }
-  if (diffMetricsN != nullptr) { free(diffMetricsN); diffMetricsN = nullptr; }
+  free(arena);
 }
 
+// All the per position arrays share one allocation, 8 byte types first.
 bool Cycle::allocSpace()
 {
-  if (dupArray != nullptr) { free(dupArray); dupArray = nullptr; }
-  if (lowest != nullptr) { free(lowest); lowest = nullptr; }
-  if (match != nullptr) { free(match); match = nullptr; }
-  if (filmd2v != nullptr) { free(filmd2v); filmd2v = nullptr; }
-  if (decimate != nullptr) { free(decimate); decimate = nullptr; }
-  if (decimate2 != nullptr) { free(decimate2); decimate2 = nullptr; }
-  if (dect != nullptr) { free(dect); dect = nullptr; }
-  if (dect2 != nullptr) { free(dect2); dect2 = nullptr; }
-  if (diffMetricsU != nullptr) { free(diffMetricsU); diffMetricsU = nullptr; }
-  if (diffMetricsUF != nullptr) { free(diffMetricsUF); diffMetricsUF = nullptr; }
-  if (tArray != nullptr) { free(tArray); tArray = nullptr; }
-  if (diffMetricsN != nullptr) { free(diffMetricsN); diffMetricsN = nullptr; }
-  dupArray = (int *)malloc(cycleSize * sizeof(int));
-  lowest = (int *)malloc(cycleSize * sizeof(int));
-  match = (int *)malloc(cycleSize * sizeof(int));
-  filmd2v = (int *)malloc(cycleSize * sizeof(int));
-  decimate = (int *)malloc(cycleSize * sizeof(int));
-  decimate2 = (int *)malloc(cycleSize * sizeof(int));
-  dect = (int *)malloc(cycleSize * sizeof(int));
-  dect2 = (int *)malloc(cycleSize * sizeof(int));
-  diffMetricsU = (uint64_t *)malloc(cycleSize * sizeof(uint64_t));
-  diffMetricsUF = (uint64_t *)malloc(cycleSize * sizeof(uint64_t));
-  tArray = (uint64_t *)malloc(cycleSize * sizeof(uint64_t));
-  diffMetricsN = (double *)malloc(cycleSize * sizeof(double));
-  if (dupArray == nullptr || lowest == nullptr || match == nullptr || filmd2v == nullptr ||
-    decimate == nullptr || decimate2 == nullptr || diffMetricsU == nullptr ||
-    diffMetricsUF == nullptr || diffMetricsN == nullptr || tArray == nullptr ||
-    dect == nullptr || dect2 == nullptr) return false;
+  free(arena);
+  arena = nullptr;
+  dupArray = lowest = match = filmd2v = decimate = decimate2 = dect = dect2 = nullptr;
+  diffMetricsU = diffMetricsUF = tArray = nullptr;
+  diffMetricsN = nullptr;
+  const size_t n = std::max(cycleSize, 1);
+  arena = malloc(n * (3 * sizeof(uint64_t) + sizeof(double) + 8 * sizeof(int)));
+  if (arena == nullptr) return false;
+  diffMetricsU = (uint64_t *)arena;
+  diffMetricsUF = diffMetricsU + n;
+  tArray = diffMetricsUF + n;
+  diffMetricsN = (double *)(tArray + n);
+  dupArray = (int *)(diffMetricsN + n);
+  lowest = dupArray + n;
+  match = lowest + n;
+  filmd2v = match + n;
+  decimate = filmd2v + n;
+  decimate2 = decimate + n;
+  dect = decimate2 + n;
+  dect2 = dect + n;
   return true;
 }
 
@@ -549,3 +532,39 @@ Cycle& Cycle::operator=(Cycle& ob2)
   memcpy(diffMetricsN, ob2.diffMetricsN, cycleSize * sizeof(double));
   return *this;
 }
+
+void Cycle::swap(Cycle &ob2)
+{
+  std::swap(cycleSize, ob2.cycleSize);
+  std::swap(arena, ob2.arena);
+  std::swap(sdlim, ob2.sdlim);
+  std::swap(length, ob2.length);
+  std::swap(maxFrame, ob2.maxFrame);
+  std::swap(frame, ob2.frame);
+  std::swap(frameE, ob2.frameE);
+  std::swap(offE, ob2.offE);
+  std::swap(cycleS, ob2.cycleS);
+  std::swap(cycleE, ob2.cycleE);
+  std::swap(frameSO, ob2.frameSO);
+  std::swap(frameEO, ob2.frameEO);
+  std::swap(type, ob2.type);
+  std::swap(diffMetricsN, ob2.diffMetricsN);
+  std::swap(diffMetricsU, ob2.diffMetricsU);
+  std::swap(diffMetricsUF, ob2.diffMetricsUF);
+  std::swap(tArray, ob2.tArray);
+  std::swap(dupArray, ob2.dupArray);
+  std::swap(lowest, ob2.lowest);
+  std::swap(decimate, ob2.decimate);
+  std::swap(decimate2, ob2.decimate2);
+  std::swap(match, ob2.match);
+  std::swap(filmd2v, ob2.filmd2v);
+  std::swap(dupsSet, ob2.dupsSet);
+  std::swap(mSet, ob2.mSet);
+  std::swap(lowSet, ob2.lowSet);
+  std::swap(decSet, ob2.decSet);
+  std::swap(isfilmd2v, ob2.isfilmd2v);
+  std::swap(dupCount, ob2.dupCount);
+  std::swap(blend, ob2.blend);
+  std::swap(dect, ob2.dect);
+  std::swap(dect2, ob2.dect2);
+}
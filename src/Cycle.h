@@ -61,6 +61,7 @@ class Cycle
 {
 private:
   int cycleSize;
+  void *arena; // backs all the arrays below
   bool allocSpace();
   bool checkMatchDup(int mp, int mc);
 
@@ -113,6 +114,8 @@ public:
   void setSize(int _size);
   ~Cycle();
   Cycle& operator=(Cycle& ob2);
+  // exchanges contents without copying, used to rotate prev/curr/next
+  void swap(Cycle &ob2);
 };
 
 #endif // CYCLE_H
@@ -0,0 +1,88 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include "FrameTables.h"
+#include "internal.h"
+
+void FrameRemap::clear()
+{
+  runs.clear();
+  count = runLength = 0;
+}
+
+void FrameRemap::append(int in)
+{
+  if (runLength == 1 && in > runs.back().in)
+  {
+    runs.back().step = in - runs.back().in;
+    ++runLength;
+  }
+  else if (runLength > 1 && in == runs.back().in + runLength * runs.back().step)
+    ++runLength;
+  else
+  {
+    runs.push_back({ count, in, 1 });
+    runLength = 1;
+  }
+  ++count;
+}
+
+int FrameRemap::operator[](int n) const
+{
+  if (n < 0 || n >= count)
+    return 0;
+  auto it = std::upper_bound(runs.begin(), runs.end(), n,
+    [](int v, const Run &r) { return v < r.out; }) - 1;
+  return it->in + (n - it->out) * it->step;
+}
+
+void DurationTable::clear()
+{
+  runs.clear();
+  end = 0;
+}
+
+void DurationTable::set(int frame, int num, int den)
+{
+  if (frame < end)
+    throw TIVTCError("TDecimate:  internal error (durations set out of order)!");
+  if (frame > end)
+    runs.push_back({ end, 0, 0 });
+  if (frame > end || runs.empty() || runs.back().num != num || runs.back().den != den)
+    runs.push_back({ frame, num, den });
+  end = frame + 1;
+}
+
+void DurationTable::get(int frame, int &num, int &den) const
+{
+  num = den = 0;
+  if (frame < 0 || frame >= end)
+    return;
+  auto it = std::upper_bound(runs.begin(), runs.end(), frame,
+    [](int v, const Run &r) { return v < r.start; }) - 1;
+  num = it->num;
+  den = it->den;
+}
@@ -0,0 +1,150 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef FRAMETABLES_H
+#define FRAMETABLES_H
+
+/*
+** Per-frame tables of TDecimate.
+**
+** FrameRemap and DurationTable are run-length encoded tables for the vfr
+** modes. Both are filled in frame order while the filter is created and
+** only read afterwards, so lookups need no locking.
+**
+** OnceSlots is a fixed size array of values that are computed on demand
+** from parallel requests. Every slot is written at most once, so readers
+** never need a lock either. A slot can be claimed first, so that only one
+** request computes it and the others wait for its result.
+*/
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Output frame -> input frame. Runs of output frames whose input frames
+// are evenly spaced (every frame, or every nth for 120fps sources) are
+// stored as a single entry.
+class FrameRemap
+{
+private:
+  struct Run {
+    int out, in, step;
+  };
+  std::vector<Run> runs;
+  int count;
+  int runLength; // length of the last run
+
+public:
+  FrameRemap() : count(0), runLength(0) {}
+
+  void clear();
+  void append(int in);
+  int size() const { return count; }
+  // 0 for frames past the end, like the zero filled table it replaces
+  int operator[](int n) const;
+};
+
+// Frame -> duration num/den. Frames that were never set read as 0/0.
+class DurationTable
+{
+private:
+  struct Run {
+    int start, num, den;
+  };
+  std::vector<Run> runs;
+  int end; // one past the last frame set
+
+public:
+  DurationTable() : end(0) {}
+
+  void clear();
+  // frames have to be set in increasing order
+  void set(int frame, int num, int den);
+  void get(int frame, int &num, int &den) const;
+};
+
+// Slots start out as the empty value. Concurrent set() calls for one slot
+// are expected to store the same value, the first one is kept. With a busy
+// value, claim() marks a slot as being computed; it reads as not set until
+// the claiming thread sets it.
+template <typename T>
+class OnceSlots
+{
+private:
+  std::unique_ptr<std::atomic<T>[]> slots;
+  int count;
+  T empty, busy;
+
+public:
+  OnceSlots() : count(0), empty(), busy() {}
+
+  void reset(int n, T emptyValue) { reset(n, emptyValue, emptyValue); }
+  void reset(int n, T emptyValue, T busyValue)
+  {
+    slots.reset(new std::atomic<T>[n]);
+    count = n;
+    empty = emptyValue;
+    busy = busyValue;
+    for (int i = 0; i < n; ++i)
+      slots[i].store(empty, std::memory_order_relaxed);
+  }
+  int size() const { return count; }
+  bool isSet(int i) const
+  {
+    const T v = get(i);
+    return v != empty && v != busy;
+  }
+  T get(int i) const { return slots[i].load(std::memory_order_acquire); }
+  // returns the value the slot holds afterwards
+  T set(int i, T v)
+  {
+    T expected = empty;
+    if (slots[i].compare_exchange_strong(expected, v, std::memory_order_acq_rel, std::memory_order_acquire))
+      return v;
+    if (expected == busy && slots[i].compare_exchange_strong(expected, v, std::memory_order_acq_rel, std::memory_order_acquire))
+      return v;
+    return expected;
+  }
+  // true if the caller now has to compute and set() the slot, false if it
+  // is set or claimed already
+  bool claim(int i)
+  {
+    T expected = empty;
+    return busy != empty &&
+      slots[i].compare_exchange_strong(expected, busy, std::memory_order_acq_rel, std::memory_order_acquire);
+  }
+  // the value of a set or claimed slot. The claiming thread is computing
+  // it right now, so this only spins until that finishes.
+  T wait(int i) const
+  {
+    T v;
+    while ((v = get(i)) == busy)
+      std::this_thread::yield();
+    return v;
+  }
+};
+
+#endif // FRAMETABLES_H
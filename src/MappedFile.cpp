@@ -0,0 +1,151 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char *name) : ptr(""), len(0), opened(false),
+  hfile(INVALID_HANDLE_VALUE), hmap(nullptr)
+{
+  int wlen = MultiByteToWideChar(CP_UTF8, 0, name, -1, nullptr, 0);
+  if (wlen <= 0) return;
+  std::wstring wname(wlen, 0);
+  if (MultiByteToWideChar(CP_UTF8, 0, name, -1, wname.data(), wlen) != wlen) return;
+
+  hfile = CreateFileW(wname.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (hfile == INVALID_HANDLE_VALUE) return;
+  LARGE_INTEGER fsize;
+  if (!GetFileSizeEx(hfile, &fsize)) return;
+  opened = true;
+  if (fsize.QuadPart == 0) return;
+  hmap = CreateFileMappingW(hfile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  const void *view = hmap ? MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!view) { opened = false; return; }
+  ptr = static_cast<const char *>(view);
+  len = (size_t)fsize.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+  if (len) UnmapViewOfFile(ptr);
+  if (hmap) CloseHandle(hmap);
+  if (hfile != INVALID_HANDLE_VALUE) CloseHandle(hfile);
+}
+
+#else
+
+MappedFile::MappedFile(const char *name) : ptr(""), len(0), opened(false)
+{
+  const int fd = open(name, O_RDONLY);
+  if (fd < 0) return;
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+  {
+    opened = true;
+    if (st.st_size > 0)
+    {
+      void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (view != MAP_FAILED)
+      {
+        ptr = static_cast<const char *>(view);
+        len = (size_t)st.st_size;
+#ifdef POSIX_MADV_SEQUENTIAL
+        posix_madvise(view, len, POSIX_MADV_SEQUENTIAL);
+#endif
+      }
+      else opened = false;
+    }
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (len) munmap(const_cast<char *>(ptr), len);
+}
+
+#endif
+
+bool LineReader::next(const char *&lb, const char *&le)
+{
+  if (p >= stop) return false;
+  lb = p;
+  const char *nl = static_cast<const char *>(memchr(p, '\n', stop - p));
+  le = nl ? nl : stop;
+  p = nl ? nl + 1 : stop;
+  if (le > lb && le[-1] == '\r') --le;
+  return true;
+}
+
+static inline bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool scanInt(const char *&p, const char *e, int &v)
+{
+  const char *t = p;
+  while (t < e && isBlank(*t)) ++t;
+  bool neg = false;
+  if (t < e && (*t == '-' || *t == '+')) neg = *t++ == '-';
+  if (t >= e || *t < '0' || *t > '9') return false;
+  int64_t r = 0;
+  for (; t < e && *t >= '0' && *t <= '9'; ++t)
+    if (r < INT64_C(1) << 40) r = r * 10 + (*t - '0');
+  if (neg) r = -r;
+  v = r > INT_MAX ? INT_MAX : r < INT_MIN ? INT_MIN : (int)r;
+  p = t;
+  return true;
+}
+
+bool scanHex(const char *&p, const char *e, unsigned int &v)
+{
+  const char *t = p;
+  while (t < e && isBlank(*t)) ++t;
+  if (e - t > 2 && t[0] == '0' && (t[1] == 'x' || t[1] == 'X') && isxdigit((unsigned char)t[2])) t += 2;
+  if (t >= e || !isxdigit((unsigned char)*t)) return false;
+  unsigned int r = 0;
+  for (; t < e && isxdigit((unsigned char)*t); ++t)
+    r = (r << 4) | (unsigned int)(*t <= '9' ? *t - '0' : (*t | 0x20) - 'a' + 10);
+  v = r;
+  p = t;
+  return true;
+}
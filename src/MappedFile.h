@@ -0,0 +1,80 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+/*
+** Read-only view of a whole file, memory mapped where possible.
+** Used for the text/binary side files (ovr, input, d2v, ...) so they
+** can be tokenized in place instead of going through fgets/sscanf.
+*/
+
+#include <cstddef>
+
+class MappedFile
+{
+private:
+  const char *ptr;
+  size_t len;
+  bool opened;
+#ifdef _WIN32
+  void *hfile, *hmap;
+#endif
+
+public:
+  explicit MappedFile(const char *name);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool isOpen() const { return opened; }
+  const char *data() const { return ptr; }
+  size_t size() const { return len; }
+  const char *begin() const { return ptr; }
+  const char *end() const { return ptr + len; }
+};
+
+// Walks a text buffer line by line. The returned line never contains
+// the terminating "\n" or "\r\n".
+class LineReader
+{
+private:
+  const char *p, *stop;
+
+public:
+  LineReader(const char *b, const char *e) : p(b), stop(e) {}
+  explicit LineReader(const MappedFile &mf) : p(mf.begin()), stop(mf.end()) {}
+
+  bool next(const char *&lb, const char *&le);
+  const char *pos() const { return p; }
+};
+
+// sscanf("%d")/("%x") replacements working on [p, e). They skip leading
+// blanks, advance p past the number and leave v alone if there is none.
+bool scanInt(const char *&p, const char *e, int &v);
+bool scanHex(const char *&p, const char *e, unsigned int &v);
+
+#endif // MAPPEDFILE_H
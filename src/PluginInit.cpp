@@ -272,10 +272,26 @@ static void VS_CC tfmCreate(const VSMap *in, VSMap *out, void *userData, VSCore
     if (err)
         mmsco = true;
 
+    bool binary = !!vsapi->propGetInt(in, "binary", 0, &err);
+    if (err)
+        binary = false;
+
+    int d2vtrust = int64ToIntS(vsapi->propGetInt(in, "d2vtrust", 0, &err));
+    if (err)
+        d2vtrust = 0;
+
     int opt = int64ToIntS(vsapi->propGetInt(in, "opt", 0, &err));
     if (err)
         opt = 4;
 
+    int segStart = int64ToIntS(vsapi->propGetInt(in, "segStart", 0, &err));
+    if (err)
+        segStart = 0;
+
+    int segFrames = int64ToIntS(vsapi->propGetInt(in, "segFrames", 0, &err));
+    if (err)
+        segFrames = 0;
+
 
     VSNodeRef *clip = vsapi->propGetNode(in, "clip", 0, nullptr);
 
@@ -284,7 +300,7 @@ static void VS_CC tfmCreate(const VSMap *in, VSMap *out, void *userData, VSCore
     try {
         tfm_data = new TFM(clip, order, field, mode, PP, ovr, input, output, outputC, debug, display, slow, mChroma, cNum, cthresh,
                        MI, chroma, blockx, blocky, y0, y1, d2v, ovrDefault, flags, scthresh, micout, micmatching, trimIn, hint,
-                       metric, batch, ubsco, mmsco, opt, vsapi, core);
+                       metric, batch, ubsco, mmsco, binary, d2vtrust, opt, segStart, segFrames, vsapi, core);
     } catch (const TIVTCError& e) {
         vsapi->setError(out, e.what());
 
@@ -335,7 +351,7 @@ static void VS_CC tfmCreate(const VSMap *in, VSMap *out, void *userData, VSCore
         TFMPP *tfmpp_data;
 
         try {
-            tfmpp_data = new TFMPP(node, PP, mthresh, ovr, display, clip2, hint, opt, vsapi, core);
+            tfmpp_data = new TFMPP(node, PP, mthresh, ovr, display, clip2, hint, opt, segStart, segFrames, vsapi, core);
         } catch (const TIVTCError& e) {
             vsapi->setError(out, e.what());
 
@@ -573,11 +589,31 @@ static void VS_CC tdecimateCreate(const VSMap *in, VSMap *out, void *userData, V
     if (err)
         orgOut = "";
 
+    bool binary = !!vsapi->propGetInt(in, "binary", 0, &err);
+    if (err)
+        binary = false;
+
+    int segStart = int64ToIntS(vsapi->propGetInt(in, "segStart", 0, &err));
+    if (err)
+        segStart = 0;
+
+    int segWarmup = int64ToIntS(vsapi->propGetInt(in, "segWarmup", 0, &err));
+    if (err)
+        segWarmup = 0;
+
+    int segLookahead = int64ToIntS(vsapi->propGetInt(in, "segLookahead", 0, &err));
+    if (err)
+        segLookahead = 0;
+
+    int segFrames = int64ToIntS(vsapi->propGetInt(in, "segFrames", 0, &err));
+    if (err)
+        segFrames = 0;
+
 
     TDecimate *tdecimate_data;
 
     try {
-        tdecimate_data = new TDecimate(clip, mode, cycleR, cycle, rate, dupThresh, vidThresh, sceneThresh, hybrid, vidDetect, conCycle, conCycleTP, ovr, output, input, tfmIn, mkvOut, nt, blockx, blocky, debug, display, vfrDec, batch, tcfv1, se, chroma, exPP, maxndl, m2PA, denoise, noblend, ssd, hint, clip2, sdlim, opt, orgOut, vsapi, core);
+        tdecimate_data = new TDecimate(clip, mode, cycleR, cycle, rate, dupThresh, vidThresh, sceneThresh, hybrid, vidDetect, conCycle, conCycleTP, ovr, output, input, tfmIn, mkvOut, nt, blockx, blocky, debug, display, vfrDec, batch, tcfv1, se, chroma, exPP, maxndl, m2PA, denoise, noblend, ssd, hint, clip2, sdlim, opt, orgOut, binary, segStart, segWarmup, segLookahead, segFrames, vsapi, core);
     } catch (const TIVTCError& e) {
         vsapi->setError(out, e.what());
 
@@ -595,7 +631,7 @@ static void VS_CC tdecimateCreate(const VSMap *in, VSMap *out, void *userData, V
         fmParallel,
         fmParallel,
         fmParallel,
-        fmUnordered
+        fmParallel
     };
     int filter_flags[8] = {
         0,
@@ -643,6 +679,21 @@ static void VS_CC tdecimateCreate(const VSMap *in, VSMap *out, void *userData, V
 }
 
 
+static void VS_CC convertPassFileCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    (void)userData;
+    (void)core;
+
+    const char *input = vsapi->propGetData(in, "input", 0, nullptr);
+    const char *output = vsapi->propGetData(in, "output", 0, nullptr);
+
+    try {
+        convertTwoPassFile(input, output);
+    } catch (const TIVTCError& e) {
+        vsapi->setError(out, e.what());
+    }
+}
+
+
 VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin) {
     configFunc("com.nodame.tivtc", "tivtc", "Field matching and decimation", (3 << 16) | 5, 1, plugin);
     registerFunc("TFM",
@@ -682,6 +733,10 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegiste
                  "ubsco:int:opt;"
                  "mmsco:int:opt;"
                  "opt:int:opt;"
+                 "binary:int:opt;"
+                 "d2vtrust:int:opt;"
+                 "segStart:int:opt;"
+                 "segFrames:int:opt;"
                  , tfmCreate, nullptr, plugin);
 
     registerFunc("TDecimate",
@@ -723,5 +778,15 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegiste
                  "sdlim:int:opt;"
                  "opt:int:opt;"
                  "orgOut:data:opt;"
+                 "binary:int:opt;"
+                 "segStart:int:opt;"
+                 "segWarmup:int:opt;"
+                 "segLookahead:int:opt;"
+                 "segFrames:int:opt;"
                  , tdecimateCreate, nullptr, plugin);
+
+    registerFunc("ConvertPassFile",
+                 "input:data;"
+                 "output:data;"
+                 , convertPassFileCreate, nullptr, plugin);
 }
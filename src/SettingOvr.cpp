@@ -0,0 +1,107 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include "SettingOvr.h"
+
+void SettingOvr::add(int key, int start, int stop, int value)
+{
+  const size_t slot = keys.find((char)key);
+  if (slot == std::string::npos || stop < start) return;
+  entries.push_back({ (int)slot, start, stop, value });
+}
+
+void SettingOvr::build()
+{
+  starts.clear();
+  values.clear();
+  if (entries.empty()) return;
+
+  std::vector<int> bounds;
+  bounds.reserve(entries.size() * 2);
+  for (const Entry &e : entries)
+  {
+    bounds.push_back(e.start);
+    bounds.push_back(e.stop + 1);
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+  const int nkeys = numKeys();
+  const int nsegs = (int)bounds.size() - 1;
+  std::vector<int> segv(nsegs * nkeys, unset);
+
+  // Paint each setting with the lines in reverse order, so the last line
+  // covering a segment wins. nextFree skips already painted segments
+  // (path compressed), keeping this near linear in the number of lines.
+  std::vector<int> nextFree(nsegs + 1);
+  for (int k = 0; k < nkeys; ++k)
+  {
+    for (int i = 0; i <= nsegs; ++i) nextFree[i] = i;
+    auto findFree = [&nextFree](int i) {
+      int r = i;
+      while (nextFree[r] != r) r = nextFree[r];
+      while (nextFree[i] != r) { const int t = nextFree[i]; nextFree[i] = r; i = t; }
+      return r;
+    };
+    for (auto e = entries.rbegin(); e != entries.rend(); ++e)
+    {
+      if (e->slot != k) continue;
+      const int s0 = int(std::lower_bound(bounds.begin(), bounds.end(), e->start) - bounds.begin());
+      const int s1 = int(std::lower_bound(bounds.begin(), bounds.end(), e->stop + 1) - bounds.begin());
+      for (int s = findFree(s0); s < s1; s = findFree(s + 1))
+      {
+        segv[s * nkeys + k] = e->value;
+        nextFree[s] = s + 1;
+      }
+    }
+  }
+
+  // merge neighbouring segments that ended up with identical settings
+  for (int s = 0; s < nsegs; ++s)
+  {
+    const int *v = &segv[s * nkeys];
+    if (!starts.empty() && std::equal(v, v + nkeys, values.end() - nkeys))
+      continue;
+    starts.push_back(bounds[s]);
+    values.insert(values.end(), v, v + nkeys);
+  }
+  starts.push_back(bounds[nsegs]);
+
+  entries.clear();
+  entries.shrink_to_fit();
+}
+
+void SettingOvr::shift(int offset)
+{
+  for (int &s : starts) s -= offset;
+}
+
+const int *SettingOvr::find(int n) const
+{
+  if (starts.empty() || n < starts.front() || n >= starts.back()) return nullptr;
+  const size_t run = std::upper_bound(starts.begin(), starts.end(), n) - starts.begin() - 1;
+  return &values[run * keys.size()];
+}
@@ -0,0 +1,71 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SETTINGOVR_H
+#define SETTINGOVR_H
+
+/*
+** Frame range -> setting lookup for the "frame,frame x value" lines
+** of TFM/TFMPP ovr files.
+**
+** Entries are added in file order, then build() flattens them into
+** a sorted list of runs holding the final value of every setting, so
+** that the per frame lookup is a binary search instead of a scan over
+** all override lines. Like the old scan, a later line overrides an
+** earlier one where their ranges overlap.
+*/
+
+#include <climits>
+#include <string>
+#include <vector>
+
+class SettingOvr
+{
+private:
+  struct Entry {
+    int slot, start, stop, value;
+  };
+
+  std::string keys;           // one setting per character, e.g. "omfPi"
+  std::vector<Entry> entries; // only needed until build()
+  std::vector<int> starts;    // first frame of each run, plus end sentinel
+  std::vector<int> values;    // keys.size() values per run
+
+public:
+  static constexpr int unset = INT_MIN;
+
+  explicit SettingOvr(const char *_keys) : keys(_keys) {}
+
+  void add(int key, int start, int stop, int value);
+  void build();
+  // renumber the runs built from a file that starts offset frames earlier
+  void shift(int offset);
+  bool empty() const { return starts.empty(); }
+  int numKeys() const { return (int)keys.size(); }
+  // values for frame n in the order of keys, nullptr if no line covers n
+  const int *find(int n) const;
+};
+
+#endif // SETTINGOVR_H
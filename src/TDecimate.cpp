@@ -29,6 +29,9 @@
 #include "TCommonASM.h"
 #include <inttypes.h>
 #include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <thread>
 
 const VSFrameRef *TDecimate::GetFrame(int n, int activationReason, void **frameData, VSFrameContext *frameCtx, VSCore *core)
 {
@@ -60,6 +63,14 @@ enum OutputType {
     TwoFramesBlended,
 };
 
+// What GetFrameMode01 requested from child in arInitial. Kept in frameData
+// until it is replaced by the OutputInfo of the decided frame.
+enum Mode01Request : intptr_t {
+    RequestedNone = 1,
+    RequestedLookAhead,
+    RequestedWindow,
+};
+
 struct OutputInfo {
     OutputType type;
     int f1, f2;
@@ -98,19 +109,43 @@ const VSFrameRef * TDecimate::GetFrameMode01(int n, int activationReason, void *
     if (activationReason != arInitial && activationReason != arAllFramesReady)
         return nullptr;
 
+  // internal numbering, the cycles of a segment start at -segPhase
+  n += segSkip;
   int EvalGroup;
   if (hybrid != 3) EvalGroup = ((int)(n / (cycle - cycleR))) * cycle;
   else EvalGroup = ((int)(n / cycle)) * cycle;
+  EvalGroup -= segPhase;
 
   bool first_frame_in_cycle = hybrid != 3 ? n % (cycle - cycleR) == 0
                                           : n % cycle == 0;
 
-  if (activationReason == arInitial) {
-      for (int i = EvalGroup - cycle - 1; i < EvalGroup + (cycle * 3); i++)
+  auto requestChild = [&](int from, int to) {
+      for (int i = from; i < to; i++)
           vsapi->requestFrameFilter(std::max(0, std::min(i, vi_child->numFrames - 1)), child, frameCtx);
+  };
+  // everything a jump to EvalGroup may measure, including the warm-up cycles
+  auto requestWindow = [&]() {
+      requestChild(EvalGroup - cycle * (segWarmup + 1) - 1, EvalGroup + cycle * 3);
+      *frameData = (void *)RequestedWindow;
+  };
+
+  if (activationReason == arInitial) {
+      // Once a cycle has been measured the following one only adds the
+      // look-ahead cycle. At least one frame is always requested so that
+      // the second call happens.
+      const int group = mode01Group.load();
+      if (group == EvalGroup) {
+          requestChild(EvalGroup, EvalGroup + 1);
+          *frameData = (void *)RequestedNone;
+      } else if (group == EvalGroup - cycle) {
+          requestChild(EvalGroup + cycle * 2 - 1, EvalGroup + cycle * 3);
+          *frameData = (void *)RequestedLookAhead;
+      } else {
+          requestWindow();
+      }
 
       return nullptr;
-  } else if (activationReason == arAllFramesReady && *frameData != nullptr) {
+  } else if (activationReason == arAllFramesReady && (intptr_t)*frameData > RequestedWindow) {
       const OutputInfo *o = (const OutputInfo *)*frameData;
 
       VSFrameRef *dst = nullptr;
@@ -147,20 +182,67 @@ const VSFrameRef * TDecimate::GetFrameMode01(int n, int activationReason, void *
 
   // rerunFromStart is only executed if all the metrics are already available from the "input" file (fullInfo is true)
   // thus it never requests any frames, it always does calculations from the stored metrics
-  if (n != lastn + 1 && EvalGroup >= cycle && fullInfo && (EvalGroup != curr.frame ||
-    EvalGroup - cycle != prev.frame || EvalGroup + cycle != next.frame))
+  const bool rerun = n != lastn + 1 && EvalGroup >= cycle - segPhase && fullInfo && (EvalGroup != curr.frame ||
+    EvalGroup - cycle != prev.frame || EvalGroup + cycle != next.frame);
+  // otherwise a jump rebuilds the decision state from the segWarmup cycles
+  // before EvalGroup, the same way a segment starts
+  const bool warmup = !rerun && segWarmup > 0 && n != lastn + 1 && curr.frame != EvalGroup;
+
+  // the cycles may have moved since arInitial, ask for the rest if needed
+  intptr_t needed = RequestedWindow;
+  if (!rerun && !warmup && curr.frame == EvalGroup)
+    needed = RequestedNone;
+  else if (!rerun && !warmup && curr.frame == EvalGroup - cycle && mode01Group.load() == EvalGroup - cycle)
+    needed = RequestedLookAhead;
+  if (needed > (intptr_t)*frameData) {
+    requestWindow();
+    return nullptr;
+  }
+
+  if (rerun)
+  {
+    mode01Group = -1;
     rerunFromStart(EvalGroup, frameCtx, core);
+  }
+  else if (warmup)
+  {
+    mode01Group = -1;
+    replayCycles(std::max(EvalGroup - cycle * segWarmup, -segPhase), EvalGroup, false, frameCtx, core);
+  }
 
   lastn = n;
 //  if (ecf) child->SetCacheHints(EvalGroup, -20);
   if (curr.frame != EvalGroup)
   {
-    prev = curr;
-    if (prev.frame != EvalGroup - cycle)
+    prev.swap(curr);
+    const bool newPrev = prev.frame != EvalGroup - cycle;
+    if (newPrev)
     {
       prev.setFrame(EvalGroup - cycle);
       getOvrCycle(prev, false);
-      calcMetricCycle(prev, true, true, core, frameCtx);
+    }
+    curr.swap(next);
+    const bool newCurr = curr.frame != EvalGroup;
+    if (newCurr)
+    {
+      curr.setFrame(EvalGroup);
+      getOvrCycle(curr, false);
+    }
+    next.swap(nbuf);
+    if (next.frame != EvalGroup + cycle)
+      next.setFrame(EvalGroup + cycle);
+    getOvrCycle(next, false);
+    nbuf.setFrame(EvalGroup + cycle * 2);
+    getOvrCycle(nbuf, false);
+
+    // the look-ahead cycle is measured in the same batch, so the next
+    // cycle is ready as soon as its own look-ahead frames are
+    Cycle *cycles[4] = { &prev, &curr, &next, &nbuf };
+    calcMetricCycles(cycles, 4, true, true, core, frameCtx);
+    mode01Group = EvalGroup;
+
+    if (newPrev)
+    {
       if (hybrid > 0)
       {
         checkVideoMatches(prev, prev);
@@ -168,12 +250,8 @@ const VSFrameRef * TDecimate::GetFrameMode01(int n, int activationReason, void *
       }
       if (output.size()) addMetricCycle(prev);
     }
-    curr = next;
-    if (curr.frame != EvalGroup)
+    if (newCurr)
     {
-      curr.setFrame(EvalGroup);
-      getOvrCycle(curr, false);
-      calcMetricCycle(curr, true, true, core, frameCtx);
       if (hybrid > 0)
       {
         checkVideoMatches(prev, curr);
@@ -181,19 +259,12 @@ const VSFrameRef * TDecimate::GetFrameMode01(int n, int activationReason, void *
       }
       if (output.size()) addMetricCycle(curr);
     }
-    next = nbuf;
-    if (next.frame != EvalGroup + cycle)
-      next.setFrame(EvalGroup + cycle);
-    getOvrCycle(next, false);
-    calcMetricCycle(next, true, true, core, frameCtx);
     if (hybrid > 0)
     {
       checkVideoMatches(curr, next);
       checkVideoMetrics(next, vidThresh);
     }
     if (output.size()) addMetricCycle(next);
-    nbuf.setFrame(EvalGroup + cycle * 2);
-    getOvrCycle(nbuf, false);
     if (hybrid > 0 && curr.type > 1)
     {
       int scenetest = curr.sceneDetect(prev, next, sceneThreshU);
@@ -247,16 +318,7 @@ const VSFrameRef * TDecimate::GetFrameMode01(int n, int activationReason, void *
     }
 //    if (debug) debugOutput1(n, curr.blend == 1 ? false : true, curr.blend);
   }
-  for (int j = nbuf.cycleS; j < nbuf.cycleE; ++j)
-  {
-    if (nbuf.diffMetricsU[j] == UINT64_MAX || nbuf.diffMetricsUF[j] == UINT64_MAX ||
-      nbuf.match[j] == -20)
-    {
-      calcMetricPreBuf(next.frameEO - 1 + j, next.frameEO + j, j, vi_child, true, true, frameCtx, core);
-      break;
-    }
-  }
-  
+
   OutputInfo *o = new OutputInfo;
   *frameData = (void *)o;
 
@@ -549,12 +611,7 @@ void setBlack(VSFrameRef *dst, const VSAPI *vsapi)
 
 const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **frameData, VSFrameContext *frameCtx, VSCore *core)
 {
-  static int vidC = 0;
-  static int filmC = 0;
-  static int longestT = 0;
-  static int longestV = 0;
-  static int countVT = 0;
-  static double timestamp = 0.0;
+  Mode3Stats &st = mode3Stats;
 
   if (activationReason != arInitial && activationReason != arAllFramesReady)
       return nullptr;
@@ -606,10 +663,7 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
   }
 
   if (n == 0)
-  {
-    vidC = filmC = longestT = longestV = countVT = 0;
-    timestamp = 0.0;
-  }
+    st = Mode3Stats();
   if (linearCount != n) {
       vsapi->setFilterError("TDecimate:  non-linear access detected in mode 3!", frameCtx);
       return nullptr;
@@ -620,37 +674,48 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
     lastGroup = n;
     lastCycle += cycle;
 //    if (ecf) child->SetCacheHints(lastCycle, -20);
-    prev = curr;
-    if (prev.frame != lastCycle - cycle)
+    prev.swap(curr);
+    const bool newPrev = prev.frame != lastCycle - cycle;
+    if (newPrev)
     {
       prev.setFrame(lastCycle - cycle);
       getOvrCycle(prev, false);
-      calcMetricCycle(prev, true, true, core, frameCtx);
+    }
+    curr.swap(next);
+    const bool newCurr = curr.frame != lastCycle;
+    if (newCurr)
+    {
+      curr.setFrame(lastCycle);
+      getOvrCycle(curr, false);
+    }
+    next.swap(nbuf);
+    if (next.frame != lastCycle + cycle)
+      next.setFrame(lastCycle + cycle);
+    getOvrCycle(next, false);
+    nbuf.setFrame(lastCycle + cycle * 2);
+    getOvrCycle(nbuf, false);
+
+    // the cycle after next is measured now as well, so only the decisions
+    // below are left for the following cycle
+    Cycle *cycles[4] = { &prev, &curr, &next, &nbuf };
+    calcMetricCycles(cycles, 4, true, true, core, frameCtx);
+
+    if (newPrev)
+    {
       checkVideoMatches(prev, prev);
       checkVideoMetrics(prev, vidThresh);
       if (output.size()) addMetricCycle(prev);
     }
-    curr = next;
-    if (curr.frame != lastCycle)
+    if (newCurr)
     {
-      curr.setFrame(lastCycle);
-      getOvrCycle(curr, false);
-      calcMetricCycle(curr, true, true, core, frameCtx);
       checkVideoMatches(prev, curr);
       checkVideoMetrics(curr, vidThresh);
       if (output.size()) addMetricCycle(curr);
     }
-    next = nbuf;
-    if (next.frame != lastCycle + cycle)
-      next.setFrame(lastCycle + cycle);
-    getOvrCycle(next, false);
-    calcMetricCycle(next, true, true, core, frameCtx);
     checkVideoMatches(curr, next);
     checkVideoMetrics(next, vidThresh);
     if (output.size()) addMetricCycle(next);
 
-    nbuf.setFrame(lastCycle + cycle * 2);
-    getOvrCycle(nbuf, false);
     int scenetest = curr.sceneDetect(prev, next, sceneThreshU);
     bool isVid = ((curr.type == 2 || curr.type == 4) && !curr.isfilmd2v && // matches
       (prev.type == 5 || (prev.type == 2 && (vidDetect == 0 || vidDetect == 2)) || prev.type == 4 ||
@@ -664,15 +729,15 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
       (vidDetect == 2 && (isVid2 || isVid)) || (vidDetect == 3 && (isVid2 && isVid)))
     {
       retFrames = cycle;
-      vidC += (curr.frame + cycle <= nfrms ? cycle : nfrms - curr.frame + 1);
-      longestT += (curr.frame + cycle <= nfrms ? cycle : nfrms - curr.frame + 1);
+      st.vidC += (curr.frame + cycle <= nfrms ? cycle : nfrms - curr.frame + 1);
+      st.longestT += (curr.frame + cycle <= nfrms ? cycle : nfrms - curr.frame + 1);
       if (!tcfv1)
       {
         int stop = (lastCycle + cycle <= nfrms ? cycle : nfrms - lastCycle + 1);
         for (int u = 0; u < stop; ++u)
         {
-          fprintf(mkvOutF, "%3.6f\n", timestamp);
-          timestamp += 1000.0 / fps;
+          fprintf(mkvOutF, "%3.6f\n", st.timestamp);
+          st.timestamp += 1000.0 / fps;
         }
       }
     }
@@ -689,12 +754,12 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
         next.setDups(dupThresh);
         findDupStrings(prev, curr, next);
       }
-      filmC += (curr.frame + cycle <= nfrms ? cycle : nfrms - curr.frame + 1);
+      st.filmC += (curr.frame + cycle <= nfrms ? cycle : nfrms - curr.frame + 1);
       if (retFrames == cycle)
       {
-        if (longestT > longestV) longestV = longestT;
-        ++countVT;
-        longestT = 0;
+        if (st.longestT > st.longestV) st.longestV = st.longestT;
+        ++st.countVT;
+        st.longestT = 0;
       }
       if (curr.blend != 3)
       {
@@ -703,8 +768,8 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
           int stop = (lastCycle + cycle <= nfrms ? cycle - cycleR : nfrms - lastCycle + 1 - cycleR);
           for (int u = 0; u < stop; ++u)
           {
-            fprintf(mkvOutF, "%3.6f\n", timestamp);
-            timestamp += 1000.0 / mkvfps;
+            fprintf(mkvOutF, "%3.6f\n", st.timestamp);
+            st.timestamp += 1000.0 / mkvfps;
           }
         }
         retFrames = cycle - cycleR;
@@ -718,8 +783,8 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
           int stop = (lastCycle + cycle <= nfrms ? cycle - cycleR - 1 : nfrms - lastCycle + 1 - cycleR - 1);
           for (int u = 0; u < stop; ++u)
           {
-            fprintf(mkvOutF, "%3.6f\n", timestamp);
-            timestamp += 1000.0 / mkvfps2;
+            fprintf(mkvOutF, "%3.6f\n", st.timestamp);
+            st.timestamp += 1000.0 / mkvfps2;
           }
         }
         else fprintf(mkvOutF, "%d,%d,%4.6f\n", lastGroup, lastGroup + cycle - cycleR - 2, mkvfps2);
@@ -733,16 +798,6 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
 //    if (debug) debugOutput1(n, retFrames == cycle ? false : true, curr.blend);
   }
 
-  for (int j = nbuf.cycleS; j < nbuf.cycleE; ++j)
-  {
-    if (nbuf.diffMetricsU[j] == UINT64_MAX || nbuf.diffMetricsUF[j] == UINT64_MAX ||
-      nbuf.match[j] == -20)
-    {
-      calcMetricPreBuf(next.frameEO - 1 + j, next.frameEO + j, j, vi_child, true, true, frameCtx, core);
-      break;
-    }
-  }
-
   if (retFrames == cycle)
   {
     if (lastCycle + (n - lastGroup) > nfrms)
@@ -792,12 +847,12 @@ const VSFrameRef * TDecimate::GetFrameMode3(int n, int activationReason, void **
 
   if (retFrames == -1 && mkvOutF != nullptr)
   {
-    double filmCf = ((double)(filmC) / (double)(nfrms + 1))*100.0;
-    double videoCf = ((double)(vidC) / (double)(nfrms + 1))*100.0;
+    double filmCf = ((double)(st.filmC) / (double)(nfrms + 1))*100.0;
+    double videoCf = ((double)(st.vidC) / (double)(nfrms + 1))*100.0;
     fprintf(mkvOutF, "# vfr stats:  %05.2f%c film  %05.2f%c video\n", filmCf, '%', videoCf, '%');
-    fprintf(mkvOutF, "# vfr stats:  %d - film  %d - video  %d - total\n", filmC, vidC, nfrms + 1);
-    fprintf(mkvOutF, "# vfr stats:  longest vid section - %d frames\n", longestV);
-    fprintf(mkvOutF, "# vfr stats:  # of detected vid sections - %d", countVT);
+    fprintf(mkvOutF, "# vfr stats:  %d - film  %d - video  %d - total\n", st.filmC, st.vidC, nfrms + 1);
+    fprintf(mkvOutF, "# vfr stats:  longest vid section - %d frames\n", st.longestV);
+    fprintf(mkvOutF, "# vfr stats:  # of detected vid sections - %d", st.countVT);
     fclose(mkvOutF);
     mkvOutF = nullptr;
   }
@@ -875,11 +930,15 @@ const VSFrameRef * TDecimate::GetFrameMode4(int n, int activationReason, VSFrame
 
   const VSFrameRef * prv = vsapi->getFrameFilter(n > 0 ? n - 1 : 0, child, frameCtx);
   const VSFrameRef * src = vsapi->getFrameFilter(n, child, frameCtx);
-  int blockN = -20, xblocks;
   uint64_t metricU = UINT64_MAX, metricF = UINT64_MAX;
   getOvrFrame(n, metricU, metricF);
   if (metricU == UINT64_MAX || metricF == UINT64_MAX || display)
-    metricU = calcMetric(prv, src, vi_child, blockN, xblocks, metricF, true, core);
+  {
+    std::vector<PairMetric> pair = { { n, prv, src, 0, 0 } };
+    calcPairMetrics(pair, true, core);
+    metricU = pair[0].metricU;
+    metricF = pair[0].metricF;
+  }
 
   vsapi->freeFrame(prv);
 
@@ -928,9 +987,9 @@ const VSFrameRef * TDecimate::GetFrameMode4(int n, int activationReason, VSFrame
 
 const VSFrameRef * TDecimate::GetFrameMode56(int n, int activationReason, VSFrameContext *frameCtx, VSCore *core)
 {
-  int frame = aLUT[n];
-  int durNum = frame_duration_info[frame].first;
-  int durDen = frame_duration_info[frame].second;
+  int frame = remap56[n];
+  int durNum, durDen;
+  durations56.get(frame, durNum, durDen);
 
   if (activationReason == arInitial) {
       vsapi->requestFrameFilter(frame, clip2, frameCtx);
@@ -976,13 +1035,51 @@ const VSFrameRef * TDecimate::GetFrameMode56(int n, int activationReason, VSFram
   return dst;
 }
 
+// cycles between the states saved by rerunFromStart
+static const int checkpointCycles = 64;
+
 // PF 180131 uses usehints! but its runtime alreadz, no problem
 void TDecimate::rerunFromStart(const int s, VSFrameContext *frameCtx, VSCore *core)
 {
-  int EvalGroup = 0;
+  const int interval = checkpointCycles * cycle;
+  int EvalGroup = -segPhase;
+
+  // continue from the closest saved state instead of frame 0
+  int k = std::min((s + segPhase) / interval, (int)checkpoints.size() - 1);
+  while (k > 0 && !checkpoints[k]) --k;
+  if (k > 0)
+  {
+    prev = checkpoints[k]->prev;
+    curr = checkpoints[k]->curr;
+    next = checkpoints[k]->next;
+    EvalGroup = k * interval - segPhase;
+  }
+
+  replayCycles(EvalGroup, s, true, frameCtx, core);
+}
+
+// runs the decisions of the cycles [EvalGroup, s) so prev/curr/next are as
+// a linear run leaves them before cycle s
+void TDecimate::replayCycles(int EvalGroup, const int s, bool saveCheckpoints, VSFrameContext *frameCtx, VSCore *core)
+{
+  const int interval = checkpointCycles * cycle;
+
   while (EvalGroup < s)
   {
-    prev = curr;
+    if (saveCheckpoints && EvalGroup + segPhase > 0 && (EvalGroup + segPhase) % interval == 0)
+    {
+      const size_t idx = (EvalGroup + segPhase) / interval;
+      if (checkpoints.size() <= idx)
+        checkpoints.resize(idx + 1);
+      if (!checkpoints[idx])
+      {
+        checkpoints[idx].reset(new CycleCheckpoint(std::max(cycle, 5), sdlim));
+        checkpoints[idx]->prev = prev;
+        checkpoints[idx]->curr = curr;
+        checkpoints[idx]->next = next;
+      }
+    }
+    prev.swap(curr);
     if (prev.frame != EvalGroup - cycle)
     {
       prev.setFrame(EvalGroup - cycle);
@@ -994,7 +1091,7 @@ void TDecimate::rerunFromStart(const int s, VSFrameContext *frameCtx, VSCore *co
         checkVideoMetrics(prev, vidThresh);
       }
     }
-    curr = next;
+    curr.swap(next);
     if (curr.frame != EvalGroup)
     {
       curr.setFrame(EvalGroup);
@@ -1066,58 +1163,20 @@ void TDecimate::rerunFromStart(const int s, VSFrameContext *frameCtx, VSCore *co
   }
 }
 
-void TDecimate::calcMetricPreBuf(int n1, int n2, int pos, const VSVideoInfo *vit, bool scene,
-  bool gethint, VSFrameContext *frameCtx, VSCore *core)
-{
-  if (n2 > nbuf.maxFrame || n2 < 0) return;
-//  if (n2 < nbuf.frameSO || n2 >= nbuf.frameEO || n1 != n2 - 1 ||
-//    nbuf.frameSO + pos != n2)
-//    env->ThrowError("TDecimate:  internal error during pre-buffering (n1=%d,n2=%d,pos=%d,nbuf.FrameSO=%d,nBuf.frameEO=%d)!",
-//      n1, n2, pos, nbuf.frameSO, nbuf.frameEO);
-  if (n2 == 0) n1 = 0;
-  int blockNI, xblocksI;
-  uint64_t metricF;
-  const VSFrameRef *src = nullptr;
-  if (nbuf.diffMetricsU[pos] == UINT64_MAX ||
-    (nbuf.diffMetricsUF[pos] == UINT64_MAX && scene))
-  {
-    src = vsapi->getFrameFilter(n2, child, frameCtx);
-    const VSFrameRef *frame = vsapi->getFrameFilter(n1, child, frameCtx);
-    nbuf.diffMetricsU[pos] = calcMetric(frame, src, vit, blockNI, xblocksI, metricF, scene, core);
-    vsapi->freeFrame(frame);
-    nbuf.diffMetricsN[pos] = (nbuf.diffMetricsU[pos] * 100.0) / MAX_DIFF;
-    if (scene) nbuf.diffMetricsUF[pos] = metricF;
-  }
-  if (gethint && nbuf.match[pos] == -20)
-  {
-    if (!usehints) nbuf.match[pos] = -200;
-    else
-    {
-      if (!src)
-        src = vsapi->getFrameFilter(n2, child, frameCtx);
-
-      nbuf.match[pos] = getTFMFrameProperties(src, nbuf.filmd2v[pos]);
-
-    }
-  }
-  vsapi->freeFrame(src);
-}
-
 void CalcMetricsExtracted(const VSFrameRef *prevt, const VSFrameRef *currt, CalcMetricData& d, VSCore *core, const VSAPI *vsapi)
 {
-  VSFrameRef *prev = nullptr, *curr = nullptr;
+  // read straight from the source frames, only blurring needs new ones
+  VSFrameRef *prevb = nullptr, *currb = nullptr;
+  const VSFrameRef *prev = prevt, *curr = currt;
 
   if (d.predenoise)
   {
-    prev = vsapi->newVideoFrame(d.vi.format, d.vi.width, d.vi.height, nullptr, core);
-    curr = vsapi->newVideoFrame(d.vi.format, d.vi.width, d.vi.height, nullptr, core);
-    blurFrame(prevt, prev, 2, d.chroma, d.cpuFlags, core, vsapi);
-    blurFrame(currt, curr, 2, d.chroma, d.cpuFlags, core, vsapi);
-  }
-  else
-  {
-    prev = vsapi->copyFrame(prevt, core);
-    curr = vsapi->copyFrame(currt, core);
+    prevb = vsapi->newVideoFrame(d.vi.format, d.vi.width, d.vi.height, nullptr, core);
+    currb = vsapi->newVideoFrame(d.vi.format, d.vi.width, d.vi.height, nullptr, core);
+    blurFrame(prevt, prevb, 2, d.chroma, d.cpuFlags, core, vsapi);
+    blurFrame(currt, currb, 2, d.chroma, d.cpuFlags, core, vsapi);
+    prev = prevb;
+    curr = currb;
   }
 
   // core start
@@ -1126,13 +1185,16 @@ void CalcMetricsExtracted(const VSFrameRef *prevt, const VSFrameRef *currt, Calc
   int prv_pitch, cur_pitch, width, height;
 
   int xblocks = ((d.vi.width + d.blockx_half) >> d.blockx_shift) + 1;
-  int xblocks4 = xblocks << 2;
   int yblocks = ((d.vi.height + d.blocky_half) >> d.blocky_shift) + 1;
   int arraysize = (xblocks * yblocks) << 2;
+  // kernels add each half-block once, the overlapping blocks are put together at the end
+  int hbpitch = xblocks << 1;
 
   const bool use_sse2 = d.cpuFlags->sse2;
+  const bool use_avx2 = d.cpuFlags->avx2;
+  const bool use_avx512 = d.cpuFlags->avx512_f && d.cpuFlags->avx512_bw;
 
-  memset(d.diff, 0, arraysize * sizeof(uint64_t));
+  memset(d.hbsum, 0, arraysize * sizeof(uint64_t));
 
   const int stop = !d.chroma ? 1 : d.vi.format->numPlanes; // luma only (!chroma) only 1 planar planes
 
@@ -1148,253 +1210,227 @@ void CalcMetricsExtracted(const VSFrameRef *prevt, const VSFrameRef *currt, Calc
     curp = vsapi->getReadPtr(curr, plane);
     cur_pitch = vsapi->getStride(curr, plane) / pixelsize;
 
-    // sum is gathered in uint64_t diff
-    // diff[] entries are normalized back to 8 bit
+    // sum is gathered in uint64_t hbsum
+    // hbsum[] entries are normalized back to 8 bit
+    // every kernel returns what it added, for luma that is the scene metric
+    uint64_t total;
 
-    if (pixelsize == 1 && d.blockx == 32 && d.blocky == 32 && d.nt <= 0)
+    if (pixelsize == 1 && d.blockx == 32 && d.blocky == 32 && d.nt <= 0 && (use_avx2 || use_sse2))
     {
-      if (d.ssd && use_sse2)
-        calcDiffSSD_32x32_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, &d.vi);
-      else if (!d.ssd && use_sse2)
-        calcDiffSAD_32x32_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, &d.vi);
-      else { goto use_c; }
+#ifdef VS_TARGET_CPU_X86
+      if (use_avx2)
+        total = d.ssd ?
+          calcDiffSSD_32x32_AVX2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, &d.vi) :
+          calcDiffSAD_32x32_AVX2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, &d.vi);
+      else
+#endif
+        total = d.ssd ?
+          calcDiffSSD_32x32_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, &d.vi) :
+          calcDiffSAD_32x32_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, &d.vi);
     }
-    else if (pixelsize == 1 && d.blockx >= 16 && d.blocky >= 16 && d.nt <= 0)
+    else if (pixelsize == 1 && d.blockx >= 16 && d.blocky >= 16 && d.nt <= 0 && (use_avx2 || use_sse2))
     {
       // YUY2 block size 8 is really 16 in width because luma + chroma
-      if (d.ssd && use_sse2)
-        calcDiffSSD_Generic_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, &d.vi);
-      else if (!d.ssd && use_sse2)
-        calcDiffSAD_Generic_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, &d.vi);
-      else { goto use_c; }
+#ifdef VS_TARGET_CPU_X86
+      if (use_avx2)
+        total = d.ssd ?
+          calcDiffSSD_Generic_AVX2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, &d.vi) :
+          calcDiffSAD_Generic_AVX2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, &d.vi);
+      else
+#endif
+        total = d.ssd ?
+          calcDiffSSD_Generic_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, &d.vi) :
+          calcDiffSAD_Generic_SSE2(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, &d.vi);
     }
-    else
+    else if (use_avx512 || use_avx2 || use_sse2)
     {
-      // fixme: have calcDiffSSD uint16_t to SIMD.
-    use_c:
-      if (pixelsize == 1) {
-        if (!d.ssd) {
-          // SAD
-            calcDiff_SADorSSD_Generic_c<uint8_t, true, 1>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi);
-        }
-        else {
-          // SSD
-            calcDiff_SADorSSD_Generic_c<uint8_t, false, 1>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi);
-        }
+      // 10-16 bits, nt > 0 and the 8 bit block sizes not covered above
+      decltype(calcDiff_SADorSSD_Colsum_SSE2<uint8_t, true>) *calcDiff_fn;
+#ifdef VS_TARGET_CPU_X86
+      if (use_avx512)
+      {
+        if (pixelsize == 1)
+          calcDiff_fn = d.ssd ? calcDiff_SADorSSD_Colsum_AVX512<uint8_t, false> : calcDiff_SADorSSD_Colsum_AVX512<uint8_t, true>;
+        else
+          calcDiff_fn = d.ssd ? calcDiff_SADorSSD_Colsum_AVX512<uint16_t, false> : calcDiff_SADorSSD_Colsum_AVX512<uint16_t, true>;
       }
-      else {
-        // pixelsize == 2, 10-16 bits
-        if (!d.ssd) {
-          // SAD
-          calcDiff_SADorSSD_Generic_c<uint16_t, true, 1>((const uint16_t *)prvp, (const uint16_t*)curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi);
-        }
-        else {
-          // SSD
-          calcDiff_SADorSSD_Generic_c<uint16_t, false, 1>((const uint16_t*)prvp, (const uint16_t*)curp, prv_pitch, cur_pitch, width, height, plane, xblocks4, d.diff, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi);
-        }
+      else if (use_avx2)
+      {
+        if (pixelsize == 1)
+          calcDiff_fn = d.ssd ? calcDiff_SADorSSD_Colsum_AVX2<uint8_t, false> : calcDiff_SADorSSD_Colsum_AVX2<uint8_t, true>;
+        else
+          calcDiff_fn = d.ssd ? calcDiff_SADorSSD_Colsum_AVX2<uint16_t, false> : calcDiff_SADorSSD_Colsum_AVX2<uint16_t, true>;
       }
-    }
-
-    if (d.metricF_needed) { // called from TDecimate. from FrameDiff:false
-      if (b == 0) // luma
+      else
+#endif
       {
-        *d.metricF = 0;
-        if (d.scene)
-        {
-          // planar or YUY2 luma+chroma
-          if (true)
-          // fix in v18: v17 was: !d.chroma instead of d.chroma
-          {
-            for (int x = 0; x < arraysize; x += 4)
-              *d.metricF += d.diff[x];
-            // d.diff entries are normalized back to 8 bit video world, done inside calcDiff_SADorSSD_Generic_c
-          }
-        }
+        if (pixelsize == 1)
+          calcDiff_fn = d.ssd ? calcDiff_SADorSSD_Colsum_SSE2<uint8_t, false> : calcDiff_SADorSSD_Colsum_SSE2<uint8_t, true>;
+        else
+          calcDiff_fn = d.ssd ? calcDiff_SADorSSD_Colsum_SSE2<uint16_t, false> : calcDiff_SADorSSD_Colsum_SSE2<uint16_t, true>;
       }
+      total = calcDiff_fn(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi);
     }
+    else if (pixelsize == 1)
+    {
+      total = d.ssd ?
+        calcDiff_SADorSSD_Generic_c<uint8_t, false, 1>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi) :
+        calcDiff_SADorSSD_Generic_c<uint8_t, true, 1>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi);
+    }
+    else
+    {
+      // pixelsize == 2, 10-16 bits
+      total = d.ssd ?
+        calcDiff_SADorSSD_Generic_c<uint16_t, false, 1>((const uint16_t*)prvp, (const uint16_t*)curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi) :
+        calcDiff_SADorSSD_Generic_c<uint16_t, true, 1>((const uint16_t*)prvp, (const uint16_t*)curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, d.hbsum, d.chroma, d.blockx_shift, d.blocky_shift, d.blockx_half, d.blocky_half, d.nt, &d.vi);
+    }
+
+    // called from TDecimate. from FrameDiff:false
+    if (d.metricF_needed && b == 0)
+      *d.metricF = d.scene ? total : 0;
   }
 
-  vsapi->freeFrame(prev);
-  vsapi->freeFrame(curr);
+  addOverlappingBlocks(d.hbsum, d.diff, xblocks, yblocks);
+
+  vsapi->freeFrame(prevb);
+  vsapi->freeFrame(currb);
 }
 
-uint64_t TDecimate::calcMetric(const VSFrameRef *prevt, const VSFrameRef *currt, const VSVideoInfo *vit, int &blockNI,
-  int &xblocksI, uint64_t &metricF, bool scene, VSCore *core) const
+void MetricPool::Scratch::fit(size_t size)
 {
-  uint64_t highestDiff = 0;
-
-  struct CalcMetricData d;
-  //d.np = np;
-  d.predenoise = predenoise;
-  d.vi = *vit;
-  d.chroma = chroma;
-  d.cpuFlags = &cpuFlags;
-  d.blockx = blockx;
-  d.blockx_half = blockx_half;
-  d.blockx_shift = blockx_shift;
-  d.blocky = blocky;
-  d.blocky_half = blocky_half;
-  d.blocky_shift = blocky_shift;
-  d.diff = diff.get();
-  d.nt = nt;
-  d.ssd = ssd;
-
-  d.metricF_needed = true;
-  d.metricF = &metricF;
-  d.scene = scene; 
-
-  CalcMetricsExtracted(prevt, currt, d, core, vsapi);
+  if (diff.size() < size)
+  {
+    diff.resize(size);
+    hbsum.resize(size);
+  }
+}
 
-  int xblocks = ((d.vi.width + d.blockx_half) >> d.blockx_shift) + 1;
-  int xblocks4 = xblocks << 2;
-  int yblocks = ((d.vi.height + d.blocky_half) >> d.blocky_shift) + 1;
-  int arraysize = (xblocks * yblocks) << 2;
+std::shared_ptr<MetricPool> MetricPool::shared(int threads)
+{
+  static std::mutex sharedLock;
+  static std::weak_ptr<MetricPool> instance;
+  std::lock_guard<std::mutex> guard(sharedLock);
+  std::shared_ptr<MetricPool> pool = instance.lock();
+  if (!pool)
+  {
+    pool.reset(new MetricPool);
+    instance = pool;
+  }
+  std::lock_guard<std::mutex> running(pool->runLock);
+  pool->numWorkers = std::max(pool->numWorkers, threads - 1);
+  return pool;
+}
 
-  // output parameters
-  blockNI = -20;
-  xblocksI = xblocks4;
+MetricPool::~MetricPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stop = true;
+  }
+  wake.notify_all();
+  for (auto &t : workers)
+    t.join();
+}
 
-  for (int x = 0; x < arraysize; ++x)
+std::unique_ptr<MetricPool::Scratch> MetricPool::acquire(size_t size)
+{
+  std::unique_ptr<Scratch> scratch;
   {
-    if (diff.get()[x] > highestDiff)
+    std::lock_guard<std::mutex> guard(lock);
+    if (!spare.empty())
     {
-      highestDiff = diff.get()[x];
-      blockNI = x;
+      scratch = std::move(spare.back());
+      spare.pop_back();
     }
   }
-  if (blockNI == -20) blockNI = 0;
-  if (ssd)
+  if (!scratch)
+    scratch.reset(new Scratch);
+  scratch->fit(size);
+  return scratch;
+}
+
+void MetricPool::release(std::unique_ptr<Scratch> scratch)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  spare.push_back(std::move(scratch));
+}
+
+void MetricPool::work(Scratch &scratch)
+{
+  scratch.fit(scratchSize);
+  for (size_t k = next++; k < count; k = next++)
+    (*task)(k, scratch);
+}
+
+void MetricPool::loop()
+{
+  Scratch scratch;
+  unsigned seen = 0;
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;)
   {
-    highestDiff = (uint64_t)(sqrt((double)(highestDiff)));
-    metricF = (uint64_t)(sqrt((double)(metricF)));
+    wake.wait(guard, [&] { return stop || generation != seen; });
+    if (stop)
+      return;
+    seen = generation;
+    guard.unlock();
+    work(scratch);
+    guard.lock();
+    if (--busy == 0)
+      done.notify_one();
   }
-  return highestDiff;
 }
 
-// PF 180131 uses usehints!
-void TDecimate::calcMetricCycle(Cycle &current, bool scene, bool hnt, VSCore *core, VSFrameContext *frameCtx) const
+void MetricPool::run(size_t _count, size_t _scratchSize, const Task &_task)
 {
-  if (current.mSet || current.cycleS == current.cycleE) 
+  std::lock_guard<std::mutex> running(runLock);
+  std::unique_ptr<Scratch> own = acquire(_scratchSize);
+  if (_count <= 1)
+  {
+    if (_count)
+      _task(0, *own);
+    release(std::move(own));
     return;
-  
-  int i, w;
-  uint64_t highestDiff;
-  int next_num = -20, next_numd = -20;
+  }
 
-  VSFrameRef *prv = nullptr, *nxt = nullptr;
-  const VSFrameRef *prevt = nullptr, *nextt = nullptr;
-  if (predenoise)
   {
-    prv = vsapi->newVideoFrame(vi_child->format, vi_child->width, vi_child->height, nullptr, core);
-    nxt = vsapi->newVideoFrame(vi_child->format, vi_child->width, vi_child->height, nullptr, core);
+    std::unique_lock<std::mutex> guard(lock);
+    while ((int)workers.size() < numWorkers)
+      workers.emplace_back(&MetricPool::loop, this);
+    scratchSize = _scratchSize;
+    task = &_task;
+    count = _count;
+    next = 0;
+    busy = (int)workers.size();
+    ++generation;
   }
+  wake.notify_all();
 
-  for (w = current.frameSO, i = current.cycleS; i < current.cycleE; ++i, ++w)
-  {
-    if ((current.match[i] != -20 || !hnt) && current.diffMetricsU[i] != UINT64_MAX &&
-      (current.diffMetricsUF[i] != UINT64_MAX || !scene)) continue;
-    if (predenoise)
-    {
-      if (current.diffMetricsU[i] != UINT64_MAX &&
-        (current.diffMetricsUF[i] != UINT64_MAX || !scene))
-      {
-        if (current.match[i] == -20 && hnt)
-        {
-          if (!usehints) current.match[i] = -200;
-          else
-          {
-              vsapi->freeFrame(nextt);
-            if (frameCtx)
-                nextt = vsapi->getFrameFilter(w, child, frameCtx);
-            else
-                nextt = vsapi->getFrame(w, child, nullptr, 0);
-            next_num = w;
-            current.match[i] = getTFMFrameProperties(nextt, current.filmd2v[i]);
-          }
-        }
-        continue;
-      }
-      
-      vsapi->freeFrame(prevt);
-      if (next_num == w - 1)
-        prevt = vsapi->cloneFrameRef(nextt);
-      else {
-          if (frameCtx)
-            prevt = vsapi->getFrameFilter(w > 0 ? w - 1 : 0, child, frameCtx);
-          else
-            prevt = vsapi->getFrame(w > 0 ? w - 1 : 0, child, nullptr, 0);
-      }
+  // the calling thread takes its share too
+  work(*own);
+  release(std::move(own));
 
-      vsapi->freeFrame(nextt);
-      if (frameCtx)
-        nextt = vsapi->getFrameFilter(w, child, frameCtx);
-      else
-        nextt = vsapi->getFrame(w, child, nullptr, 0);
-      next_num = w;
-      if (current.match[i] == -20 && hnt)
-      {
-        if (!usehints) current.match[i] = -200;
-        else current.match[i] = getTFMFrameProperties(nextt, current.filmd2v[i]);
-      }
-      if (next_numd == w - 1) 
-        copyFrame(prv, nxt, vsapi);
-      else 
-        blurFrame(prevt, prv, 2, chroma, &cpuFlags, core, vsapi);
-      
-      blurFrame(nextt, nxt, 2, chroma, &cpuFlags, core, vsapi);
-      next_numd = w;
-    }
-    else
-    {
-      if (current.diffMetricsU[i] != UINT64_MAX &&
-        (current.diffMetricsUF[i] != UINT64_MAX || !scene))
-      {
-        if (current.match[i] == -20 && hnt)
-        {
-          if (!usehints) current.match[i] = -200;
-          else
-          {
-            const VSFrameRef *tmp;
-            if (frameCtx)
-                tmp = vsapi->getFrameFilter(w, child, frameCtx);
-            else
-                tmp = vsapi->getFrame(w, child, nullptr, 0);
-            vsapi->freeFrame(nxt);
-            nxt = vsapi->copyFrame(tmp, core);
-            vsapi->freeFrame(tmp);
-            next_num = w;
-            current.match[i] = getTFMFrameProperties(nxt, current.filmd2v[i]);
-          }
-        }
-        continue;
-      }
+  std::unique_lock<std::mutex> guard(lock);
+  done.wait(guard, [&] { return busy == 0; });
+  task = nullptr;
+}
 
-      vsapi->freeFrame(prv);
-      if (next_num == w - 1) 
-        prv = vsapi->copyFrame(nxt, core);
-      else {
-        const VSFrameRef *tmp;
-        if (frameCtx)
-            tmp = vsapi->getFrameFilter(w > 0 ? w - 1 : 0, child, frameCtx);
-        else
-            tmp = vsapi->getFrame(w > 0 ? w - 1 : 0, child, nullptr, 0);
-        prv = vsapi->copyFrame(tmp, core);
-        vsapi->freeFrame(tmp);
-      }
-      const VSFrameRef *tmp;
-      if (frameCtx)
-          tmp = vsapi->getFrameFilter(w, child, frameCtx);
-      else
-          tmp = vsapi->getFrame(w, child, nullptr, 0);
-      vsapi->freeFrame(nxt);
-      nxt = vsapi->copyFrame(tmp, core);
-      vsapi->freeFrame(tmp);
-      next_num = w;
-      if (current.match[i] == -20 && hnt)
-      {
-        if (!usehints) current.match[i] = -200;
-        else current.match[i] = getTFMFrameProperties(nxt, current.filmd2v[i]);
-      }
+// Evaluates the pairs on the metric pool. Results do not depend on the thread count.
+// Modes 4 and 7 are fmParallel, VapourSynth already spreads their requests over
+// its threads, so their pairs are evaluated on the calling thread.
+void TDecimate::calcPairMetrics(std::vector<PairMetric> &pairs, bool scene, VSCore *core) const
+{
+  const int xblocks = ((vi_child->width + blockx_half) >> blockx_shift) + 1;
+  const int yblocks = ((vi_child->height + blocky_half) >> blocky_shift) + 1;
+  const int arraysize = (xblocks * yblocks) << 2;
+
+  auto evaluate = [&](PairMetric &p, uint64_t *diffBuf, uint64_t *hbsumBuf) {
+    // without predenoise the metric reads the source frames directly
+    const VSFrameRef *prv = nullptr, *nxt = nullptr;
+    if (predenoise)
+    {
+      prv = blurCache->get(p.n > 0 ? p.n - 1 : 0, p.prevt, core);
+      nxt = blurCache->get(p.n, p.nextt, core);
     }
 
     struct CalcMetricData d;
@@ -1409,43 +1445,274 @@ void TDecimate::calcMetricCycle(Cycle &current, bool scene, bool hnt, VSCore *co
     d.blocky = blocky;
     d.blocky_half = blocky_half;
     d.blocky_shift = blocky_shift;
-    d.diff = diff.get();
+    d.diff = diffBuf;
+    d.hbsum = hbsumBuf;
     d.nt = nt;
     d.ssd = ssd;
 
     // here we need metrics and has scene
     d.metricF_needed = true;
-    d.metricF = &current.diffMetricsUF[i];
+    d.metricF = &p.metricF;
     d.scene = scene;
 
-    CalcMetricsExtracted(prv, nxt, d, core, vsapi);
-
-    int xblocks = ((d.vi.width + d.blockx_half) >> d.blockx_shift) + 1;
-    int yblocks = ((d.vi.height + d.blocky_half) >> d.blocky_shift) + 1;
-    int arraysize = (xblocks * yblocks) << 2;
+    if (predenoise)
+      CalcMetricsExtracted(prv, nxt, d, core, vsapi);
+    else
+      CalcMetricsExtracted(p.prevt, p.nextt, d, core, vsapi);
+    vsapi->freeFrame(prv);
+    vsapi->freeFrame(nxt);
 
-    highestDiff = 0;
+    uint64_t highestDiff = 0;
     for (int x = 0; x < arraysize; ++x)
     {
-      if (diff.get()[x] > highestDiff)
-        highestDiff = diff.get()[x];
+      if (diffBuf[x] > highestDiff)
+        highestDiff = diffBuf[x];
     }
     if (ssd)
     {
       highestDiff = (uint64_t)(sqrt((double)(highestDiff)));
-      current.diffMetricsUF[i] = (uint64_t)(sqrt((double)(current.diffMetricsUF[i])));
+      p.metricF = (uint64_t)(sqrt((double)(p.metricF)));
     }
-    current.diffMetricsU[i] = highestDiff;
-    current.diffMetricsN[i] = (highestDiff * 100.0) / MAX_DIFF;
+    p.metricU = highestDiff;
+  };
+
+  auto task = [&](size_t k, MetricPool::Scratch &scratch) {
+    evaluate(pairs[k], scratch.diff.data(), scratch.hbsum.data());
+  };
+  if (mode == 4 || mode == 7)
+  {
+    std::unique_ptr<MetricPool::Scratch> scratch = metricPool->acquire(metricScratch);
+    for (size_t k = 0; k < pairs.size(); ++k)
+      task(k, *scratch);
+    metricPool->release(std::move(scratch));
   }
+  else
+    metricPool->run(pairs.size(), metricScratch, task);
+}
 
-  vsapi->freeFrame(prevt);
-  vsapi->freeFrame(nextt);
-  vsapi->freeFrame(prv);
-  vsapi->freeFrame(nxt);
+// PF 180131 uses usehints!
+void TDecimate::calcMetricCycle(Cycle &current, bool scene, bool hnt, VSCore *core, VSFrameContext *frameCtx) const
+{
+  Cycle *cycles[1] = { &current };
+  calcMetricCycles(cycles, 1, scene, hnt, core, frameCtx);
+}
 
-  current.mSet = true;
-  current.setIsFilmD2V();
+// Frames requested with getFrameAsync and waited for as a group
+class AsyncFrames
+{
+private:
+  const VSAPI *vsapi;
+  std::mutex lock;
+  std::condition_variable ready;
+  std::map<int, const VSFrameRef *> frames;
+  int pending = 0;
+  std::string error;
+
+  static void VS_CC frameDone(void *userData, const VSFrameRef *f, int n, VSNodeRef *, const char *errorMsg)
+  {
+    AsyncFrames *self = static_cast<AsyncFrames *>(userData);
+    std::lock_guard<std::mutex> guard(self->lock);
+    if (f)
+      self->frames[n] = f;
+    else if (self->error.empty())
+      self->error = errorMsg ? errorMsg : "unknown error";
+    if (--self->pending == 0)
+      self->ready.notify_all();
+  }
+
+public:
+  AsyncFrames(const VSAPI *_vsapi) : vsapi(_vsapi) {}
+  ~AsyncFrames() { clear(); }
+
+  void request(int n, VSNodeRef *node)
+  {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      ++pending;
+    }
+    vsapi->getFrameAsync(n, node, frameDone, this);
+  }
+
+  void wait()
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    ready.wait(guard, [this] { return pending == 0; });
+    if (!error.empty())
+      throw TIVTCError(("TDecimate:  frame request failed (" + error + ")!").c_str());
+  }
+
+  const VSFrameRef *get(int n) const { return frames.at(n); }
+
+  // waits for requests still in flight, then releases every frame
+  void clear()
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    ready.wait(guard, [this] { return pending == 0; });
+    for (auto &f : frames)
+      vsapi->freeFrame(f.second);
+    frames.clear();
+    error.clear();
+  }
+};
+
+// The frames are fetched first, outside GetFrame as one asynchronous batch,
+// then the frame pair metrics of all the cycles are evaluated together.
+void TDecimate::calcMetricCycles(Cycle *const *cycles, int count, bool scene, bool hnt, VSCore *core, VSFrameContext *frameCtx) const
+{
+  int i, w;
+
+  // frame w of a cycle needs its pair metrics, or only its TFM hints
+  struct Item {
+    Cycle *cycle;
+    int i, w;
+    bool pair;
+  };
+  std::vector<Item> items;
+  std::vector<Cycle *> filled;
+
+  for (int c = 0; c < count; ++c)
+  {
+    Cycle &current = *cycles[c];
+    if (current.mSet || current.cycleS == current.cycleE)
+      continue;
+    filled.push_back(&current);
+
+    for (w = current.frameSO, i = current.cycleS; i < current.cycleE; ++i, ++w)
+    {
+      if ((current.match[i] != -20 || !hnt) && current.diffMetricsU[i] != UINT64_MAX &&
+        (current.diffMetricsUF[i] != UINT64_MAX || !scene)) continue;
+      if (current.diffMetricsU[i] != UINT64_MAX &&
+        (current.diffMetricsUF[i] != UINT64_MAX || !scene))
+      {
+        if (!usehints) current.match[i] = -200;
+        else items.push_back({ &current, i, w, false });
+        continue;
+      }
+      items.push_back({ &current, i, w, true });
+    }
+  }
+
+  AsyncFrames async(vsapi);
+  if (!frameCtx)
+  {
+    std::vector<int> needed;
+    for (const Item &it : items)
+    {
+      if (it.pair)
+        needed.push_back(std::max(it.w - 1, 0));
+      needed.push_back(it.w);
+    }
+    std::sort(needed.begin(), needed.end());
+    needed.erase(std::unique(needed.begin(), needed.end()), needed.end());
+    for (int n : needed)
+      async.request(n, child);
+    async.wait();
+  }
+  auto fetch = [&](int n) {
+    return frameCtx ? vsapi->getFrameFilter(n, child, frameCtx) : vsapi->cloneFrameRef(async.get(n));
+  };
+
+  std::vector<PairMetric> pairs;
+  std::vector<std::pair<Cycle *, int>> slots; // cycle and position of each pair
+  for (const Item &it : items)
+  {
+    Cycle &current = *it.cycle;
+    const VSFrameRef *nextt = fetch(it.w);
+    if (current.match[it.i] == -20 && hnt)
+    {
+      if (!usehints) current.match[it.i] = -200;
+      else current.match[it.i] = getTFMFrameProperties(nextt, current.filmd2v[it.i]);
+    }
+    if (!it.pair)
+    {
+      vsapi->freeFrame(nextt);
+      continue;
+    }
+    pairs.push_back({ it.w, fetch(std::max(it.w - 1, 0)), nextt, 0, 0 });
+    slots.emplace_back(&current, it.i);
+  }
+
+  calcPairMetrics(pairs, scene, core);
+
+  for (size_t k = 0; k < pairs.size(); ++k)
+  {
+    Cycle &current = *slots[k].first;
+    const int c = slots[k].second;
+    current.diffMetricsU[c] = pairs[k].metricU;
+    current.diffMetricsUF[c] = pairs[k].metricF;
+    current.diffMetricsN[c] = (pairs[k].metricU * 100.0) / MAX_DIFF;
+  }
+
+  for (auto &p : pairs)
+  {
+    vsapi->freeFrame(p.prevt);
+    vsapi->freeFrame(p.nextt);
+  }
+
+  for (Cycle *current : filled)
+  {
+    current->mSet = true;
+    current->setIsFilmD2V();
+  }
+}
+
+// Mode 5 takes its metrics from the input file. Frames the file left without a metric
+// are computed here in advance, so the cycle passes of init_mode_5 never wait on a frame.
+// A bounded window of frames is kept in flight: the next batch is requested before the
+// current one is evaluated.
+void TDecimate::prefetchMissingMetrics(VSCore *core)
+{
+  std::vector<int> missing;
+  for (int n = 0; n < vi_child->numFrames; ++n)
+  {
+    if (metricsArray[n * 2] == UINT64_MAX || metricsArray[n * 2 + 1] == UINT64_MAX)
+      missing.push_back(n);
+  }
+  if (missing.empty())
+    return;
+
+  const size_t batchSize = std::max<size_t>(8, 4 * std::thread::hardware_concurrency());
+  AsyncFrames batches[2] = { AsyncFrames(vsapi), AsyncFrames(vsapi) };
+
+  auto request = [&](AsyncFrames &frames, size_t first) {
+    const size_t last = std::min(first + batchSize, missing.size());
+    int requested = -1;
+    for (size_t k = first; k < last; ++k)
+    {
+      const int n = missing[k];
+      const int p = n > 0 ? n - 1 : 0;
+      if (p > requested)
+        frames.request(p, child);
+      if (n > p)
+        frames.request(n, child);
+      requested = n;
+    }
+  };
+
+  request(batches[0], 0);
+  for (size_t first = 0, b = 0; first < missing.size(); first += batchSize, b ^= 1)
+  {
+    AsyncFrames &frames = batches[b];
+    frames.wait();
+    if (first + batchSize < missing.size())
+      request(batches[b ^ 1], first + batchSize);
+
+    std::vector<PairMetric> pairs;
+    const size_t last = std::min(first + batchSize, missing.size());
+    for (size_t k = first; k < last; ++k)
+    {
+      const int n = missing[k];
+      pairs.push_back({ n, frames.get(n > 0 ? n - 1 : 0), frames.get(n), 0, 0 });
+    }
+    calcPairMetrics(pairs, true, core);
+    // like calcMetricCycle, a pair with any metric missing gets both recomputed
+    for (const auto &p : pairs)
+    {
+      metricsArray[p.n * 2] = p.metricU;
+      metricsArray[p.n * 2 + 1] = p.metricF;
+    }
+    frames.clear();
+  }
 }
 
 template<bool SAD>
@@ -2571,6 +2838,7 @@ void TDecimate::init_mode_5(VSCore *core) {
   }
   prevM.length = currM.length = nextM.length = cycle;
   prevM.maxFrame = currM.maxFrame = nextM.maxFrame = nfrms;
+  prefetchMissingMetrics(core);
   bool vid, prevVid;
   int i, h, w, firstkv, countprev, filmC, videoC, longestT, longestV, countVT;
   int count, b, passThrough = 0;
@@ -2596,8 +2864,8 @@ twopassrun:
     }
     else
     {
-      prevM = currM;
-      currM = nextM;
+      prevM.swap(currM);
+      currM.swap(nextM);
     }
     nextM.setFrame(b + cycle);
     getOvrCycle(nextM, false); // PF 180131 uses usehints!
@@ -2770,10 +3038,7 @@ finishTP:
           break;
       }
       for (int frm = b; frm < b + cycle; frm++)
-      {
-        frame_duration_info[frm].first = frameNum;
-        frame_duration_info[frm].second = frameDen;
-      }
+        durations56.set(frm, frameNum, frameDen);
 
       if (vid)
       {
@@ -2844,19 +3109,13 @@ finishTP:
   {
     throw TIVTCError("TDecimate:  mkvOut file output error (cannot create file)!");
   }
-  if (aLUT.size())
-    aLUT.resize(0);
-
-  aLUT.resize(vi.numFrames + 1, 0);
+  remap56.clear();
 
-  i = w = 0;
-  while (i <= nfrms && w <= vi.numFrames - 1)
+  i = 0;
+  while (i <= nfrms && remap56.size() <= vi.numFrames - 1)
   {
     if (input_magic_numbers[i] != 2)
-    {
-      aLUT[w] = i;
-      ++w;
-    }
+      remap56.append(i);
     ++i;
   }
   input_magic_numbers.resize(0);
@@ -2868,14 +3127,12 @@ finishTP:
   //8day
   if (orgOut.size())
   {
-    if (aLUT.empty())
-      throw TIVTCError("TDecimate: aLUT is nullptr!");
     FILE *orgOutF = tivtc_fopen(orgOut.c_str(), "w");
     if (orgOutF == nullptr)
       throw TIVTCError("TDecimate: cannot create orgOut file!");
     for (int n = 0; n<vi.numFrames; ++n)
     {
-      fprintf(orgOutF, "%d\n", aLUT[n]);
+      fprintf(orgOutF, "%d\n", remap56[n]);
     }
     fclose(orgOutF);
   }
@@ -2889,7 +3146,7 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
   int _nt, int _blockx, int _blocky, bool _debug, bool _display, int _vfrDec,
   bool _batch, bool _tcfv1, bool _se, bool _chroma, bool _exPP, int _maxndl, bool _m2PA,
   bool _predenoise, bool _noblend, bool _ssd, bool _usehints, VSNodeRef *_clip2,
-  int _sdlim, int _opt, const char* _orgOut, const VSAPI *_vsapi, VSCore *core)
+  int _sdlim, int _opt, const char* _orgOut, bool _binary, int _segStart, int _segWarmup, int _segLookahead, int _segFrames, const VSAPI *_vsapi, VSCore *core)
     : vsapi(_vsapi), child(_child),
   mode(_mode),
   cycleR(_cycleR), cycle(_cycle), rate(_rate), dupThresh(_dupThresh),
@@ -2900,8 +3157,8 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
   vfrDec(_vfrDec), debug(_debug), display(_display), batch(_batch), tcfv1(_tcfv1), se(_se),
   maxndl(_maxndl), chroma(_chroma), m2PA(_m2PA), exPP(_exPP),
   noblend(_noblend), predenoise(_predenoise), ssd(_ssd), sdlim(_sdlim),
-  opt(_opt), clip2(_clip2), orgOut(_orgOut),
-  prev(5, 0), curr(5, 0), next(5, 0), nbuf(5, 0), usehints(_usehints), diff(nullptr, nullptr)
+  opt(_opt), clip2(_clip2), orgOut(_orgOut), binary(_binary), segStart(_segStart), segWarmup(_segWarmup), segLookahead(_segLookahead), segFrames(_segFrames),
+  prev(5, 0), curr(5, 0), next(5, 0), nbuf(5, 0), usehints(_usehints)
 {
     vi_child = vsapi->getVideoInfo(child);
     vi = *vi_child;
@@ -2953,6 +3210,18 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
     throw TIVTCError("TDecimate:  only hybrid = 0, 1, or 3 is supported in modes 0 and 1!");
   if (cycleR >= cycle || cycleR <= 0)
     throw TIVTCError("TDecimate:  cycleR must be greater than 0 and less than cycle!");
+  if (segStart < 0 || segWarmup < 0 || segLookahead < 0)
+    throw TIVTCError("TDecimate:  segStart, segWarmup and segLookahead must not be negative!");
+  if (segFrames == 0)
+    segFrames = segStart + vi.numFrames;
+  if (segFrames < segStart + vi.numFrames)
+    throw TIVTCError("TDecimate:  segFrames must be at least segStart plus the number of frames in the clip!");
+  if ((segFrames != vi.numFrames || segWarmup > 0 || segLookahead > 0) && mode > 1)
+    throw TIVTCError("TDecimate:  segStart, segWarmup, segLookahead and segFrames can only be used in modes 0 and 1!");
+  segPhase = segStart % cycle;
+  if (segPhase != 0 && segWarmup < 1)
+    throw TIVTCError("TDecimate:  segWarmup must be at least 1 if segStart is not a multiple of cycle!");
+  segSkip = segWarmup * (hybrid != 3 ? cycle - cycleR : cycle);
   if (cycle < 2 || cycle > vi.numFrames)
     throw TIVTCError("TDecimate:  cycle must be at least 2 and less than or equal to the number of frames in the clip!");
   if (sceneThresh < 0.0 || sceneThresh > 100.0)
@@ -3109,11 +3378,12 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
     }
 
 
+  if (predenoise && (mode <= 5 || mode == 7))
+    blurCache.reset(new BlurCache(std::min(std::max(cycle + 2, 8), 32), chroma, &cpuFlags, vsapi));
+
+  metricScratch = (size_t)((((vi.width + blockx_half) >> blockx_shift) + 1)*(((vi.height + blocky_half) >> blocky_shift) + 1) * 4);
   if (mode <= 5 || mode == 7)
-  {
-    diff = decltype(diff) (vs_aligned_malloc<uint64_t>((((vi.width + blockx_half) >> blockx_shift) + 1)*(((vi.height + blocky_half) >> blocky_shift) + 1) * 4 * sizeof(uint64_t), 16), &vs_aligned_free);
-    if (diff == nullptr) throw TIVTCError("TDecimate:  malloc failure (diff)!");
-  }
+    metricPool = MetricPool::shared(vsapi->getCoreInfo(core)->numThreads);
   if (output.size())
   {
     if ((f = tivtc_fopen(output.c_str(), "w")) != nullptr)
@@ -3126,6 +3396,11 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
     }
     else throw TIVTCError("TDecimate:  output error (cannot create output file)!");
   }
+  // input, ovr and tfmIn files describe the whole clip, a segment reads them
+  // at that length and keeps only [segStart, segStart + numFrames) afterwards
+  const int segLength = vi.numFrames;
+  vi.numFrames = segFrames;
+  nfrms = segFrames - 1;
   if (input.size())
   {
     metricsArray.resize(vi.numFrames * 2);
@@ -3135,11 +3410,45 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
       if (!batch || (mode != 5 && mode != 6)) metricsArray[h] = UINT64_MAX;
       else metricsArray[h] = 0;
     }
-    if ((f = tivtc_fopen(input.c_str(), "r")) != nullptr)
+    MappedFile inputMap(input.c_str());
+    const bool inputBinary = inputMap.isOpen() && isTwoPassBinary(inputMap);
+    if (inputBinary || (f = tivtc_fopen(input.c_str(), "r")) != nullptr)
     {
       uint64_t metricU, metricF;
       int w;
-      while (fgets(linein, 1024, f) != nullptr)
+      if (inputBinary)
+      {
+        TwoPassView bin(inputMap, TWOPASS_TDECIMATE, "TDecimate");
+        unsigned int tempCrc;
+        calcCRC(child, 15, tempCrc, vsapi);
+        if (tempCrc != bin.header().crc && !batch && segFrames == segLength)
+        {
+          char msg[160] = { 0 };
+          snprintf(msg, 160, "TDecimate:  crc32 in input file does not match that of the current clip (%#x vs %#x)!",
+            bin.header().crc, tempCrc);
+          throw TIVTCError(msg);
+        }
+        if (bin.header().blockx != blockx)
+          throw TIVTCError("TDecimate:  current blockx value does not match" \
+            " that which was used to create the given input file!");
+        if (bin.header().blocky != blocky)
+          throw TIVTCError("TDecimate:  current blocky value does not match" \
+            " that which was used to create the given input file!");
+        if ((bin.header().chroma != 0) != chroma)
+          throw TIVTCError("TDecimate:  current chroma setting does not match" \
+            " that which was used to create the given input file!");
+        if (bin.numFrames() > nfrms + 1)
+          throw TIVTCError("TDecimate:  input error (out of range frame #)!");
+        for (w = 0; w < bin.numFrames(); ++w)
+        {
+          bin.metrics(w, metricU, metricF);
+          if (metricU == UINT64_MAX && metricF == UINT64_MAX)
+            continue;
+          metricsArray[w * 2] = metricU;
+          metricsArray[w * 2 + 1] = metricF;
+        }
+      }
+      while (f != nullptr && fgets(linein, 1024, f) != nullptr)
       {
         if (linein[0] == 0 || linein[0] == '\n' || linein[0] == '\r' || linein[0] == '#' || linein[0] == ';')
           continue;
@@ -3157,7 +3466,7 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
             unsigned int z, tempCrc;
             sscanf(linet, "%x", &z);
             calcCRC(child, 15, tempCrc, vsapi);
-            if (tempCrc != z && !batch)
+            if (tempCrc != z && !batch && segFrames == segLength)
             {
               fclose(f);
               f = nullptr;
@@ -3244,7 +3553,7 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
           metricsArray[w * 2 + 1] = metricF;
         }
       }
-      fclose(f);
+      if (f != nullptr) fclose(f);
       f = nullptr;
       metricsFullInfo = true;
       for (int h = 0; h < vi.numFrames * 2; h += 2)
@@ -3461,7 +3770,9 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
   if (tfmIn.size())
   {
     bool d2vmarked, micmarked;
-    if ((f = tivtc_fopen(tfmIn.c_str(), "r")) != nullptr)
+    MappedFile tfmInMap(tfmIn.c_str());
+    const bool tfmInBinary = tfmInMap.isOpen() && isTwoPassBinary(tfmInMap);
+    if (tfmInBinary || (f = tivtc_fopen(tfmIn.c_str(), "r")) != nullptr)
     {
       int fieldt, firstLine, z, q, r;
       if (ovrArray.empty())
@@ -3471,7 +3782,36 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
         else memset(ovrArray.data(), 0, vi.numFrames);
       }
       fieldt = firstLine = 0;
-      while (fgets(linein, 1024, f) != nullptr)
+      if (tfmInBinary)
+      {
+        TwoPassView bin(tfmInMap, TWOPASS_TFM, "TDecimate");
+        if (bin.numFrames() > nfrms + 1)
+          throw TIVTCError("TDecimate:  tfmIn file error (out of range frame #)!");
+        fieldt = bin.header().field;
+        for (z = 0; z < bin.numFrames(); ++z)
+        {
+          const uint8_t hint = bin.hint(z);
+          if (!(hint & FILE_ENTRY))
+            continue;
+          q = hint & 0x07;
+          if (fieldt != 0)
+          {
+            if (q == 0) q = 3;
+            else if (q == 2) q = 4;
+            else if (q == 3) q = 0;
+            else if (q == 4) q = 2;
+          }
+          if ((hint & FILE_COMBED) == FILE_COMBED && q < 5 && useTFMPP)
+          {
+            if (fieldt == 0) q = 5;
+            else q = 6;
+          }
+          if (hint & FILE_D2V) ovrArray[z] |= ISD2VFILM;
+          ovrArray[z] |= 0x70;
+          ovrArray[z] &= ((q << 4) | 0x8F);
+        }
+      }
+      while (f != nullptr && fgets(linein, 1024, f) != nullptr)
       {
         if (linein[0] == 0 || linein[0] == '\n' || linein[0] == '\r' || linein[0] == ';' || linein[0] == '#')
           continue;
@@ -3574,7 +3914,7 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
           }
         }
       }
-      fclose(f);
+      if (f != nullptr) fclose(f);
       f = nullptr;
       tfmFullInfo = true;
       for (int h = 0; h < vi.numFrames; ++h)
@@ -3607,18 +3947,42 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
     }
   }
 
+  vi.numFrames = segLength;
+  nfrms = segLength - 1;
+  if (segFrames != segLength)
+  {
+    if (!metricsArray.empty())
+    {
+      metricsArray.erase(metricsArray.begin(), metricsArray.begin() + segStart * 2);
+      metricsArray.resize(segLength * 2);
+    }
+    if (!ovrArray.empty())
+    {
+      ovrArray.erase(ovrArray.begin(), ovrArray.begin() + segStart);
+      ovrArray.resize(segLength);
+    }
+  }
+
   if (metricsFullInfo && (tfmFullInfo || !usehints)) fullInfo = true;
   else fullInfo = false;
 
   if (mode < 2)
   {
+    // the partial first cycle of a segment counts as a whole one, the
+    // output of the warm-up cycles is dropped; with segLookahead the output
+    // also ends before the last segLookahead whole cycles and any partial
+    // cycle after them
+    const int cycleOut = hybrid != 3 ? cycle - cycleR : cycle;
+    if (segLookahead > 0)
+      vi.numFrames = ((vi.numFrames + segPhase) / cycle - segLookahead) * cycleOut - segSkip;
+    else if (hybrid != 3)
+      vi.numFrames = ((vi.numFrames + segPhase) * cycleOut) / cycle - segSkip;
+    else vi.numFrames += segPhase - segSkip;
     if (hybrid != 3)
-    {
-      vi.numFrames = (vi.numFrames * (cycle - cycleR)) / cycle;
-      nfrmsN = vi.numFrames - 1;
       muldivRational(&vi.fpsNum, &vi.fpsDen, cycle - cycleR, cycle);
-    }
-    else nfrmsN = vi.numFrames - 1;
+    if (vi.numFrames <= 0)
+      throw TIVTCError("TDecimate:  the clip is too short for segWarmup and segLookahead!");
+    nfrmsN = vi.numFrames - 1;
   }
   else if (mode == 2)
   {
@@ -3653,13 +4017,17 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
   }
   else if (mode == 7)
   {
-    if (metricsOutArray.empty())
+    mode7Metrics.reset(nfrms + 1, UINT64_MAX, UINT64_MAX - 1);
+    mode7Metrics.set(0, 0);
+    if (metricsArray.size())
     {
-      metricsOutArray.resize(vi.numFrames * 2, UINT64_MAX);
-      metricsOutArray[0] = 0;
+      for (int i = 1; i <= nfrms; ++i)
+      {
+        if (metricsArray[i << 1] != UINT64_MAX)
+          mode7Metrics.set(i, metricsArray[i << 1]);
+      }
     }
-    if (aLUT.size()) aLUT.resize(0);
-    aLUT.resize(vi.numFrames, -20);
+    mode7Analysis.reset(nfrms + 1, -20);
 
     if (rate <= 0)
         throw TIVTCError("TDecimate:  rate must be greater than 0.");
@@ -3670,7 +4038,7 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
     vi.fpsDen = den;
     vi.numFrames = (int)(vi.numFrames * (rate / fps));
     nfrmsN = vi.numFrames - 1;
-    mode2_decA.resize(vi.numFrames, -20);
+    mode7Dec.reset(vi.numFrames, -20);
 
 //    child->SetCacheHints(CACHE_GENERIC, int((fps / rate) + 1.0) * 2 + 3);  // fixed to diameter (07/30/2005)
     diff_thresh = uint64_t((vidThresh*MAX_DIFF) / 100.0);
@@ -3700,7 +4068,7 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
   else if (mode == 5)
   {
     init_mode_5(core);
-    diff = nullptr; // mode 5 is using diff buffer only at init
+    metricPool.reset(); // mode 5 is measuring only at init
   } // mode 5
   else if (mode == 6)
   {
@@ -3860,24 +4228,19 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
       }
       while (frm < j)
       {
-        frame_duration_info[frm].first = 1001;
-        frame_duration_info[frm].second = frameDen;
+        durations56.set(frm, 1001, frameDen);
         ++frm;
       }
     }
     if (tcfv1 && lastt != 5) fprintf(f, "%d,%d,%s\n", lastf, k - 1, cfps(lastt));
     vi.numFrames = k;
-    if (aLUT.size()) { aLUT.resize(0); }
-    aLUT.resize(vi.numFrames + 1, 0);
+    remap56.clear();
 
-    k = j = 0;
-    while (k <= nfrms && j <= vi.numFrames - 1)
+    k = 0;
+    while (k <= nfrms && remap56.size() <= vi.numFrames - 1)
     {
       if (input_magic_numbers[k] == 2)
-      {
-        aLUT[j] = k;
-        ++j;
-      }
+        remap56.append(k);
       ++k;
     }
 
@@ -3894,25 +4257,30 @@ TDecimate::TDecimate(VSNodeRef *_child, int _mode, int _cycleR, int _cycle, doub
 
 TDecimate::~TDecimate()
 {
+  if (mode == 7 && metricsOutArray.size())
+  {
+    for (int i = 1; i <= nfrms; ++i)
+      metricsOutArray[i << 1] = mode7Metrics.get(i);
+  }
   if (metricsOutArray.size())
   {
-    if (output.size())
+    if (output.size() && binary)
+    {
+      TwoPassHeader h = makeTwoPassHeader(TWOPASS_TDECIMATE, nfrms + 1);
+      h.crc = outputCrc;
+      h.blockx = blockx;
+      h.blocky = blocky;
+      h.chroma = chroma;
+      TwoPassWriter w(outputFull, h, 0xFF);
+      for (int n = 0; n <= nfrms; ++n)
+        w.writeTDecimate(n, metricsOutArray[n * 2], metricsOutArray[n * 2 + 1]);
+    }
+    else if (output.size())
     {
       FILE *f = nullptr;
       if ((f = tivtc_fopen(outputFull, "w")) != nullptr)
       {
-        uint64_t metricU, metricF;
-        fprintf(f, "#TDecimate %s by tritical\n", VERSION);
-        fprintf(f, "crc32 = %x, blockx = %d, blocky = %d, chroma = %c\n", outputCrc, blockx, blocky,
-          chroma ? 'T' : 'F');
-        for (int h = 0; h < (nfrms + 1) * 2; h += 2)
-        {
-          metricU = metricF = UINT64_MAX;
-          if (metricsOutArray[h] != UINT64_MAX) metricU = metricsOutArray[h];
-          if (metricsOutArray[h + 1] != UINT64_MAX) metricF = metricsOutArray[h + 1];
-          if (metricU != UINT64_MAX || metricF != UINT64_MAX)
-            fprintf(f, "%d %" PRIu64 " %" PRIu64 "\n", h >> 1, metricU, metricF);
-        }
+        writeTDecimateText(f, outputCrc, blockx, blocky, chroma, metricsOutArray.data(), nfrms + 1);
         fclose(f);
         f = nullptr;
       }
@@ -41,7 +41,12 @@
 #include <memory>
 #include <vector>
 #include <string>
-#include <unordered_map>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <thread>
 #include <VapourSynth.h>
 #include <VSHelper.h>
 
@@ -49,6 +54,8 @@
 //#include "Font.h"
 #include "Cycle.h"
 #include "calcCRC.h"
+#include "TwoPassFile.h"
+#include "FrameTables.h"
 //#include "profUtil.h"
 //#include "Cache.h"
 #include "cpufeatures.h"
@@ -72,6 +79,7 @@ struct CalcMetricData {
   int blocky_half;
   int blocky_shift;
   uint64_t* diff;
+  uint64_t* hbsum; // half-block sums, same size as diff
   int nt;
   bool ssd; // ssd or sad
 
@@ -86,6 +94,70 @@ void CalcMetricsExtracted(const VSFrameRef *prevt, const VSFrameRef *currt, Calc
 void blurFrame(const VSFrameRef *src, VSFrameRef *dst, int iterations,
   bool bchroma, const CPUFeatures *cpuFlags, VSCore *core, const VSAPI *vsapi);
 
+// Bounded LRU cache of predenoise blurred frames keyed by frame number, so
+// each source frame is blurred only once even though it takes part in two
+// difference metrics (n-1,n) and (n,n+1). Safe for parallel use.
+class BlurCache
+{
+private:
+  const VSAPI *vsapi;
+  bool chroma;
+  const CPUFeatures *cpuFlags;
+  size_t capacity;
+  std::mutex lock;
+  std::list<std::pair<int, const VSFrameRef *>> entries; // most recent first
+
+public:
+  BlurCache(size_t _capacity, bool _chroma, const CPUFeatures *_cpuFlags, const VSAPI *_vsapi);
+  ~BlurCache();
+  // returns a new reference to the blurred version of src (frame n)
+  const VSFrameRef *get(int n, const VSFrameRef *src, VSCore *core);
+};
+
+// Worker threads and diff/hbsum scratch buffers for TDecimate's pair metrics.
+// One pool is shared by all TDecimate instances of the process, so that they
+// don't each add a full set of threads to the VapourSynth ones. It has as many
+// workers as the largest core thread count asked for, less the calling
+// thread; they start on the first run().
+class MetricPool
+{
+public:
+  struct Scratch {
+    std::vector<uint64_t> diff, hbsum;
+    void fit(size_t size);
+  };
+  typedef std::function<void(size_t, Scratch &)> Task;
+
+private:
+  int numWorkers = 0;
+  size_t scratchSize = 0; // of the current batch
+  std::mutex runLock; // one batch at a time
+  std::mutex lock;
+  std::condition_variable wake, done;
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<Scratch>> spare;
+  const Task *task = nullptr;
+  size_t count = 0;
+  std::atomic<size_t> next{ 0 };
+  int busy = 0;
+  unsigned generation = 0;
+  bool stop = false;
+
+  MetricPool() {}
+  void work(Scratch &scratch);
+  void loop();
+
+public:
+  ~MetricPool();
+  static std::shared_ptr<MetricPool> shared(int threads);
+  // calls task(k, scratch) for every k < count on the workers and the calling
+  // thread, with at least scratchSize elements in both scratch buffers
+  void run(size_t count, size_t scratchSize, const Task &task);
+  // scratch for work done on the calling thread only
+  std::unique_ptr<Scratch> acquire(size_t scratchSize);
+  void release(std::unique_ptr<Scratch> scratch);
+};
+
 uint64_t calcLumaDiffYUY2_SSD(const uint8_t* prvp, const uint8_t* nxtp,
   int width, int height, int prv_pitch, int nxt_pitch, int nt, int cpuFlags);
 
@@ -134,28 +206,54 @@ private:
   int opt;
   VSNodeRef *clip2;
   std::string orgOut;
+  bool binary; // write output in the TwoPassFile format
+  // modes 0/1 segmented processing: absolute frame of the first input frame,
+  // number of leading cycles whose output is dropped, the resulting phase of
+  // the cycle grid and number of dropped output frames; segLookahead is the
+  // number of trailing cycles only used as look-ahead, segFrames is the
+  // length of the whole clip the input/ovr/tfmIn files describe
+  int segStart, segWarmup, segLookahead, segPhase, segSkip, segFrames;
   Cycle prev, curr, next, nbuf;
+  // mode 3 vfr statistics, written to the end of the timecodes file
+  struct Mode3Stats {
+    int vidC = 0, filmC = 0, longestT = 0, longestV = 0, countVT = 0;
+    double timestamp = 0.0;
+  } mode3Stats;
 
   int nfrms, nfrmsN, linearCount;
   int blocky_shift, blockx_shift, blockx_half, blocky_half;
   int lastn;
+  std::atomic<int> mode01Group{ -1 }; // modes 0/1: last cycle measured along with its look-ahead
+  // prev/curr/next as rerunFromStart has them before evaluating a cycle,
+  // saved every checkpointCycles cycles so a seek replays a bounded range
+  struct CycleCheckpoint {
+    Cycle prev, curr, next;
+    CycleCheckpoint(int size, int sdlim) : prev(size, sdlim), curr(size, sdlim), next(size, sdlim) {}
+  };
+  std::vector<std::unique_ptr<CycleCheckpoint>> checkpoints;
   int lastFrame, lastCycle, lastGroup, lastType, retFrames;
   uint64_t MAX_DIFF, sceneThreshU, sceneDivU, diff_thresh, same_thresh;
   double fps, mkvfps, mkvfps2;
   bool useTFMPP, cve, ecf, fullInfo;
   bool usehints;
-  std::unique_ptr<uint64_t, decltype (&vs_aligned_free)> diff;
+  std::unique_ptr<BlurCache> blurCache; // predenoise only
+  std::shared_ptr<MetricPool> metricPool;
+  size_t metricScratch; // diff/hbsum elements of a pair metric
   std::vector<uint64_t> metricsArray, metricsOutArray, mode2_metrics;
   std::vector<int> aLUT, mode2_decA, mode2_order;
-  std::unordered_map<int, std::pair<int, int>> frame_duration_info;
+  FrameRemap remap56;        // modes 5 and 6, output -> input frame
+  DurationTable durations56; // modes 5 and 6, per input frame
   unsigned int outputCrc;
   std::vector<uint8_t> ovrArray;
   int mode2_num, mode2_den, mode2_numCycles, mode2_cfs[10];
+  OnceSlots<uint64_t> mode7Metrics; // metricU of (n-1, n)
+  OnceSlots<int> mode7Analysis, mode7Dec;
   FILE *mkvOutF;
   char outputFull[MAX_PATH];
 
   void init_mode_5(VSCore *core);
   void rerunFromStart(const int s, VSFrameContext *frameCtx, VSCore *core);
+  void replayCycles(int EvalGroup, const int s, bool saveCheckpoints, VSFrameContext *frameCtx, VSCore *core);
   void checkVideoMetrics(Cycle &c, double thresh);
   void checkVideoMatches(Cycle &p, Cycle &c);
   bool checkMatchDup(int mp, int mc);
@@ -195,6 +293,7 @@ private:
   void mostSimilarDecDecision(Cycle &p, Cycle &c, Cycle &n);
   int checkForD2VDecFrame(Cycle &p, Cycle &c, Cycle &n);
   bool checkForTwoDropLongestString(Cycle &p, Cycle &c, Cycle &n);
+  int findCycleMode2(int n) const;
   int getNonDecMode2(int n, int start, int stop) const;
   double buildDecStrategy();
   void mode2MarkDecFrames(int cycleF);
@@ -206,9 +305,16 @@ private:
   void sortMetrics(uint64_t *metrics, int *order, int length) const;
   //void SedgeSort(uint64_t *metrics, int *order, int length);
   //void pQuickerSort(uint64_t *metrics, int *order, int lower, int upper);
+  // difference metrics of frame pair (n-1, n), filled in by calcPairMetrics
+  struct PairMetric {
+    int n;
+    const VSFrameRef *prevt, *nextt;
+    uint64_t metricU, metricF;
+  };
+  void calcPairMetrics(std::vector<PairMetric> &pairs, bool scene, VSCore *core) const;
   void calcMetricCycle(Cycle &current, bool scene, bool hnt, VSCore *core, VSFrameContext *frameCtx=nullptr) const;
-  uint64_t calcMetric(const VSFrameRef *prevt, const VSFrameRef *currt, const VSVideoInfo *vi, int &blockNI,
-    int &xblocksI, uint64_t &metricF, bool scene, VSCore *core) const;
+  void calcMetricCycles(Cycle *const *cycles, int count, bool scene, bool hnt, VSCore *core, VSFrameContext *frameCtx=nullptr) const;
+  void prefetchMissingMetrics(VSCore *core);
 
 
   void calcBlendRatios2(double &amount1, double &amount2, int &frame1,
@@ -218,9 +324,10 @@ private:
   bool diff_group(int f1, int f2);
   int diff_f(int f1, int f2);
   int mode7_analysis(int n) const;
+  void mode7Positions(int n, int pos[4]) const;
+  int mode7Decide(int n, int prev_real, const int pos[4], int &chosen);
 
-  bool wasChosen(int i, int n);
-  void calcMetricPreBuf(int n1, int n2, int pos, const VSVideoInfo *vit, bool scene, bool gethint, VSFrameContext *frameCtx, VSCore *core);
+  bool wasChosen(int i, int n) const;
 public:
   VSVideoInfo vi;
 
@@ -232,7 +339,7 @@ public:
     int _nt, int _blockx, int _blocky, bool _debug, bool _display, int _vfrDec,
     bool _batch, bool _tcfv1, bool _se, bool _chroma, bool _exPP, int _maxndl,
     bool _m2PA, bool _predenoise, bool _noblend, bool _ssd, bool _usehints,
-    VSNodeRef *_clip2, int _sdlim, int _opt, const char* _orgOut, const VSAPI *_vsapi, VSCore *core);
+    VSNodeRef *_clip2, int _sdlim, int _opt, const char* _orgOut, bool _binary, int _segStart, int _segWarmup, int _segLookahead, int _segFrames, const VSAPI *_vsapi, VSCore *core);
   ~TDecimate();
 
 //  int __stdcall SetCacheHints(int cachehints, int frame_range) override {
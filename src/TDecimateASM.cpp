@@ -30,11 +30,13 @@
 #ifdef VS_TARGET_CPU_X86
 #include "emmintrin.h"
 #include "smmintrin.h" // SSE4
+#include "immintrin.h" // AVX2
 #elif defined __ARM_NEON__
 #include "sse2neon.h"
 #endif
 
 #include <assert.h>
+#include <vector>
 
 static void blend_uint8_c(uint8_t* dstp, const uint8_t* srcp1,
   const uint8_t* srcp2, int width, int height, int dst_pitch,
@@ -1055,14 +1057,68 @@ void VerticalBlurSSE2_R(const uint8_t *srcp, uint8_t *dstp,
 
 //-------- helpers
 
+#ifdef VS_TARGET_CPU_X86
+// four horizontally adjacent 8xN blocks at once (one 32 byte row), sums[i] is block i
+template<bool SAD, int blkSizeY>
+#if defined(GCC) || defined(CLANG)
+__attribute__((__target__("avx2")))
+#endif
+static void calcSADorSSD_AVX2_4x8xN(const uint8_t* ptr1, const uint8_t* ptr2, int pitch1, int pitch2, int sums[4])
+{
+  if constexpr (SAD) {
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < blkSizeY; i++) {
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr1));
+      __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr2));
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a, b)); // one 64 bit lane per 8 bytes
+      ptr1 += pitch1;
+      ptr2 += pitch2;
+    }
+    __m128i lo = _mm256_castsi256_si128(acc);
+    __m128i hi = _mm256_extracti128_si256(acc, 1);
+    sums[0] = _mm_cvtsi128_si32(lo);
+    sums[1] = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+    sums[2] = _mm_cvtsi128_si32(hi);
+    sums[3] = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+  }
+  else {
+    // madd keeps pairs of columns in 32 bit lanes: acc_lo lanes 0-3 block 0, 4-7 block 1
+    __m256i acc_lo = _mm256_setzero_si256();
+    __m256i acc_hi = _mm256_setzero_si256();
+    for (int i = 0; i < blkSizeY; i++) {
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr1));
+      __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr2));
+      __m256i d = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+      __m256i dlo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(d));
+      __m256i dhi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(d, 1));
+      acc_lo = _mm256_add_epi32(acc_lo, _mm256_madd_epi16(dlo, dlo));
+      acc_hi = _mm256_add_epi32(acc_hi, _mm256_madd_epi16(dhi, dhi));
+      ptr1 += pitch1;
+      ptr2 += pitch2;
+    }
+    __m256i h = _mm256_hadd_epi32(acc_lo, acc_hi);
+    h = _mm256_hadd_epi32(h, h);
+    // h: block0 block2 x x | block1 block3 x x
+    __m128i lo = _mm256_castsi256_si128(h);
+    __m128i hi = _mm256_extracti128_si256(h, 1);
+    sums[0] = _mm_cvtsi128_si32(lo);
+    sums[2] = _mm_cvtsi128_si32(_mm_srli_si128(lo, 4));
+    sums[1] = _mm_cvtsi128_si32(hi);
+    sums[3] = _mm_cvtsi128_si32(_mm_srli_si128(hi, 4));
+  }
+}
+#endif
+
 // true SAD false SSD
-template<bool SAD>
-static void calcDiff_SADorSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, const VSVideoInfo *vi)
+// returns the sum of everything added, that is the plane total for the scene metric
+template<bool SAD, bool AVX2>
+static uint64_t calcDiff_SADorSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, const VSVideoInfo *vi)
 {
     (void)chroma;
 
-  int temp1, temp2, y, x, u, difft, box1, box2;
+  int hbrow, y, x, u, difft;
+  uint64_t total = 0;
   int widtha, heighta, heights = height, widths = width;
   const uint8_t* ptr1T, * ptr2T;
 
@@ -1105,24 +1161,33 @@ static void calcDiff_SADorSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr
     // number of whole blocks
     for (y = 0; y < height; ++y)
     {
-      // at other places:
-      // for (y = 0; y < heighta; y += yhalf)
-      //   const int temp1 = (y >> blocky_shift)*xblocks4;
-      //   const int temp2 = ((y + blocky_half) >> blocky_shift) * xblocks4;
-      // FIXME: why >>1 and +1>>1 here? 
-      // Fact 1: y here goes in block-counter mode
-      // Fact 2: Because we do 32x32 but with 16x16 luma (and divided chroma) blocks?
-      temp1 = (y >> 1) * xblocks4;
-      temp2 = ((y + 1) >> 1) * xblocks4;
-      for (x = 0; x < width; ++x) // width is the number of blocks
+      // y and x count 16x16 luma (and divided chroma) blocks, which are the half-blocks of 32x32
+      hbrow = y * hbpitch;
+      x = 0;
+#ifdef VS_TARGET_CPU_X86
+      if constexpr (AVX2) {
+        // luma: two 16x16 blocks per call
+        if (w_to_shift == 4 && h_to_shift == 4)
+        {
+          for (; x + 2 <= width; x += 2)
+          {
+            int sums[4];
+            calcSADorSSD_AVX2_4x8xN<SAD, 16>(ptr1 + (x << 4), ptr2 + (x << 4), pitch1, pitch2, sums);
+            for (int k = 0; k < 2; ++k)
+            {
+              difft = sums[k * 2] + sums[k * 2 + 1];
+              hbsum[hbrow + x + k] += difft;
+              total += difft;
+            }
+          }
+        }
+      }
+#endif
+      for (; x < width; ++x) // width is the number of blocks
       {
         SAD_fn(ptr1 + (x << w_to_shift), ptr2 + (x << w_to_shift), pitch1, pitch2, difft);
-        box1 = (x >> 1) << 2;
-        box2 = ((x + 1) >> 1) << 2;
-        diff[temp1 + box1 + 0] += difft;
-        diff[temp1 + box2 + 1] += difft;
-        diff[temp2 + box1 + 2] += difft;
-        diff[temp2 + box2 + 3] += difft;
+        hbsum[hbrow + x] += difft;
+        total += difft;
       }
       // rest non-simd
       for (x = widtha; x < widths; ++x)
@@ -1138,12 +1203,8 @@ static void calcDiff_SADorSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr
           ptr1T += pitch1;
           ptr2T += pitch2;
         }
-        box1 = (x >> (w_to_shift + 1)) << 2;
-        box2 = ((x + (1 << w_to_shift)) >> (w_to_shift + 1)) << 2;
-        diff[temp1 + box1 + 0] += difft;
-        diff[temp1 + box2 + 1] += difft;
-        diff[temp2 + box1 + 2] += difft;
-        diff[temp2 + box2 + 3] += difft;
+        hbsum[hbrow + (x >> w_to_shift)] += difft;
+        total += difft;
       }
       // += pitch1 * vertical blocksize
       ptr1 += pitch1 << h_to_shift;
@@ -1151,8 +1212,7 @@ static void calcDiff_SADorSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr
     }
     for (y = heighta; y < heights; ++y)
     {
-      temp1 = (y >> (h_to_shift + 1)) * xblocks4; // y >> 5 or 4
-      temp2 = ((y + (1 << h_to_shift)) >> (h_to_shift + 1)) * xblocks4;
+      hbrow = (y >> h_to_shift) * hbpitch; // y >> 4 or 3
       for (x = 0; x < widths; ++x)
       {
         if constexpr (SAD)
@@ -1161,42 +1221,55 @@ static void calcDiff_SADorSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr
           difft = ptr1[x] - ptr2[x];
           difft *= difft;
         }
-        box1 = (x >> (w_to_shift + 1)) << 2;
-        box2 = ((x + (1 << w_to_shift)) >> (w_to_shift + 1)) << 2;
-        diff[temp1 + box1 + 0] += difft;
-        diff[temp1 + box2 + 1] += difft;
-        diff[temp2 + box1 + 2] += difft;
-        diff[temp2 + box2 + 3] += difft;
+        hbsum[hbrow + (x >> w_to_shift)] += difft;
+        total += difft;
       }
       ptr1 += pitch1;
       ptr2 += pitch2;
     }
+    return total;
 }
 
-void calcDiffSAD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, const VSVideoInfo *vi)
+uint64_t calcDiffSAD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, const VSVideoInfo *vi)
 {
-  calcDiff_SADorSSD_32x32_SSE2<true>(ptr1, ptr2, pitch1, pitch2, width, height, plane, xblocks4, diff, chroma, vi);
+  return calcDiff_SADorSSD_32x32_SSE2<true, false>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, vi);
 }
 
-void calcDiffSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, const VSVideoInfo *vi)
+uint64_t calcDiffSSD_32x32_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, const VSVideoInfo *vi)
 {
-  calcDiff_SADorSSD_32x32_SSE2<false>(ptr1, ptr2, pitch1, pitch2, width, height, plane, xblocks4, diff, chroma, vi);
+  return calcDiff_SADorSSD_32x32_SSE2<false, false>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, vi);
 }
 
+#ifdef VS_TARGET_CPU_X86
+uint64_t calcDiffSAD_32x32_AVX2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, const VSVideoInfo *vi)
+{
+  return calcDiff_SADorSSD_32x32_SSE2<true, true>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, vi);
+}
+
+uint64_t calcDiffSSD_32x32_AVX2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, const VSVideoInfo *vi)
+{
+  return calcDiff_SADorSSD_32x32_SSE2<false, true>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, vi);
+}
+#endif
+
 
 // true: SAD, false: SSD
-template<bool SAD>
-void calcDiff_SADorSSD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
+template<bool SAD, bool AVX2>
+static uint64_t calcDiff_SADorSSD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
 {
     (void)chroma;
+    (void)xhalfS;
+    (void)yhalfS;
+  uint64_t total = 0;
 
-  int temp1, temp2, y, x, u, difft, box1, box2;
-  int yshift, yhalf, xshift, xhalf;
+  int hbrow, y, x, u, difft;
+  int yshift, xshift, yshifta, xshifta;
   int heighta, heights = height, widtha, widths = width;
-  int yshifta, yhalfa, xshifta, xhalfa;
   const uint8_t* ptr1T, * ptr2T;
 
     // from YV12 to generic planar
@@ -1235,29 +1308,40 @@ void calcDiff_SADorSSD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
     }
     // other formats are forbidden and were pre-checked
 
-    yshifta = yshiftS - ysubsampling; // yshiftS  or yshiftS - 1
-    yhalfa = yhalfS >> ysubsampling; // yhalfS  or yhalfS >> 1;
-    xshifta = xshiftS - xsubsampling; //  xshiftS or  xshiftS - 1;
-    xhalfa = xhalfS >> xsubsampling; // xhalfS  or xhalfS >> 1;
-    // these are the same for luma and chroma as well, 8x8
-    // FIXME: check, really? Really.
-    yshift = yshiftS - 3;
-    yhalf = yhalfS >> 3; // div 8
-    xshift = xshiftS - 3;
-    xhalf = xhalfS >> 3;
+    // pixel to half-block index
+    yshifta = yshiftS - 1 - ysubsampling;
+    xshifta = xshiftS - 1 - xsubsampling;
+    // 8x8 (or subsampled) cell to half-block index, the same for luma and chroma
+    yshift = yshiftS - 4;
+    xshift = xshiftS - 4;
     for (y = 0; y < height; ++y)
     {
-      temp1 = (y >> yshift) * xblocks4;
-      temp2 = ((y + yhalf) >> yshift) * xblocks4;
-      for (x = 0; x < width; ++x)
+      hbrow = (y >> yshift) * hbpitch;
+      x = 0;
+#ifdef VS_TARGET_CPU_X86
+      if constexpr (AVX2) {
+        // luma: four 8x8 blocks per call
+        if (w_to_shift == 3 && h_to_shift == 3)
+        {
+          for (; x + 4 <= width; x += 4)
+          {
+            int sums[4];
+            calcSADorSSD_AVX2_4x8xN<SAD, 8>(ptr1 + (x << 3), ptr2 + (x << 3), pitch1, pitch2, sums);
+            for (int k = 0; k < 4; ++k)
+            {
+              difft = sums[k];
+              hbsum[hbrow + ((x + k) >> xshift)] += difft;
+              total += difft;
+            }
+          }
+        }
+      }
+#endif
+      for (; x < width; ++x)
       {
         SAD_fn(ptr1 + (x << w_to_shift), ptr2 + (x << w_to_shift), pitch1, pitch2, difft);
-        box1 = (x >> xshift) << 2;
-        box2 = ((x + xhalf) >> xshift) << 2;
-        diff[temp1 + box1 + 0] += difft;
-        diff[temp1 + box2 + 1] += difft;
-        diff[temp2 + box1 + 2] += difft;
-        diff[temp2 + box2 + 3] += difft;
+        hbsum[hbrow + (x >> xshift)] += difft;
+        total += difft;
       }
       for (x = widtha; x < widths; ++x)
       {
@@ -1272,20 +1356,15 @@ void calcDiff_SADorSSD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
           ptr1T += pitch1;
           ptr2T += pitch2;
         }
-        box1 = (x >> xshifta) << 2;
-        box2 = ((x + xhalfa) >> xshifta) << 2;
-        diff[temp1 + box1 + 0] += difft;
-        diff[temp1 + box2 + 1] += difft;
-        diff[temp2 + box1 + 2] += difft;
-        diff[temp2 + box2 + 3] += difft;
+        hbsum[hbrow + (x >> xshifta)] += difft;
+        total += difft;
       }
       ptr1 += pitch1 << h_to_shift;
       ptr2 += pitch2 << h_to_shift;
     }
     for (y = heighta; y < heights; ++y)
     {
-      temp1 = (y >> yshifta) * xblocks4;
-      temp2 = ((y + yhalfa) >> yshifta) * xblocks4;
+      hbrow = (y >> yshifta) * hbpitch;
       for (x = 0; x < widths; ++x)
       {
         if constexpr (SAD)
@@ -1294,43 +1373,86 @@ void calcDiff_SADorSSD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
           difft = ptr1[x] - ptr2[x];
           difft *= difft;
         }
-        box1 = (x >> xshifta) << 2;
-        box2 = ((x + xhalfa) >> xshifta) << 2;
-        diff[temp1 + box1 + 0] += difft;
-        diff[temp1 + box2 + 1] += difft;
-        diff[temp2 + box1 + 2] += difft;
-        diff[temp2 + box2 + 3] += difft;
+        hbsum[hbrow + (x >> xshifta)] += difft;
+        total += difft;
       }
       ptr1 += pitch1;
       ptr2 += pitch2;
     }
     // end of YV12 / planar
+    return total;
+}
+
+uint64_t calcDiffSAD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
+{
+  return calcDiff_SADorSSD_Generic_SSE2<true, false>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, xshiftS, yshiftS, xhalfS, yhalfS, vi);
+}
+
+uint64_t calcDiffSSD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
+{
+  return calcDiff_SADorSSD_Generic_SSE2<false, false>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, xshiftS, yshiftS, xhalfS, yhalfS, vi);
 }
 
-void calcDiffSAD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
+#ifdef VS_TARGET_CPU_X86
+uint64_t calcDiffSAD_Generic_AVX2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
 {
-  calcDiff_SADorSSD_Generic_SSE2<true>(ptr1, ptr2, pitch1, pitch2, width, height, plane, xblocks4, diff, chroma, xshiftS, yshiftS, xhalfS, yhalfS, vi);
+  return calcDiff_SADorSSD_Generic_SSE2<true, true>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, xshiftS, yshiftS, xhalfS, yhalfS, vi);
 }
 
-void calcDiffSSD_Generic_SSE2(const uint8_t* ptr1, const uint8_t* ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
+uint64_t calcDiffSSD_Generic_AVX2(const uint8_t* ptr1, const uint8_t* ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi)
 {
-  calcDiff_SADorSSD_Generic_SSE2<false>(ptr1, ptr2, pitch1, pitch2, width, height, plane, xblocks4, diff, chroma, xshiftS, yshiftS, xhalfS, yhalfS, vi);
+  return calcDiff_SADorSSD_Generic_SSE2<false, true>(ptr1, ptr2, pitch1, pitch2, width, height, plane, hbpitch, hbsum, chroma, xshiftS, yshiftS, xhalfS, yhalfS, vi);
 }
+#endif
 
 
+// Builds the four overlapping block grids from the half-block sums.
+// Block (bx, by) of the straight grid (entry 0) covers half-blocks 2bx..2bx+1, 2by..2by+1,
+// the grids shifted by half a block horizontally (1), vertically (2) or both (3) start one half-block
+// earlier; half-blocks outside the frame are zero.
+void addOverlappingBlocks(const uint64_t* hbsum, uint64_t* diff, int xblocks, int yblocks)
+{
+  const int hbpitch = xblocks << 1;
+  for (int by = 0; by < yblocks; ++by)
+  {
+    const uint64_t* upper = by > 0 ? hbsum + ((by << 1) - 1) * hbpitch : nullptr;
+    const uint64_t* middle = hbsum + (by << 1) * hbpitch;
+    const uint64_t* lower = middle + hbpitch;
+    uint64_t lowerLeft = 0, upperLeft = 0;
+    for (int x = 0; x < hbpitch; x += 2)
+    {
+      // vertical pairs of the two half-block columns of this block
+      const uint64_t lower0 = middle[x] + lower[x];
+      const uint64_t lower1 = middle[x + 1] + lower[x + 1];
+      const uint64_t upper0 = (upper ? upper[x] : 0) + middle[x];
+      const uint64_t upper1 = (upper ? upper[x + 1] : 0) + middle[x + 1];
+      diff[0] = lower0 + lower1;
+      diff[1] = lowerLeft + lower0;
+      diff[2] = upper0 + upper1;
+      diff[3] = upperLeft + upper0;
+      diff += 4;
+      lowerLeft = lower1;
+      upperLeft = upper1;
+    }
+  }
+}
+
 // true: SAD, false: SSD
 // inc: YUY2 increment
 template<typename pixel_t, bool SAD, int inc>
-void calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff,
+uint64_t calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum,
   bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt,
   const VSVideoInfo *vi)
 {
     (void)chroma;
+  uint64_t total = 0;
 
-  int temp1, temp2, u;
+  int hbrow, u;
 
   // 16 bits SSD requires int64 intermediate
   typedef typename std::conditional<sizeof(pixel_t) == 1 && !SAD, int, int64_t> ::type safeint_t;
@@ -1356,11 +1478,12 @@ void calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
 
   heighta = (height >> (yshift - 1)) << (yshift - 1);
   widtha = (width >> (xshift - 1)) << (xshift - 1);
+  // the half-block of a pixel is the sum of its block indices in the straight and in the shifted grid
+  // (also well defined when a subsampled half-block is narrower than a pixel)
   // whole blocks
   for (int y = 0; y < heighta; y += yhalf)
   {
-    temp1 = (y >> yshift) * xblocks4;
-    temp2 = ((y + yhalf) >> yshift) * xblocks4;
+    hbrow = ((y >> yshift) + ((y + yhalf) >> yshift)) * hbpitch;
     for (int x = 0; x < widtha; x += xhalf)
     {
       prvpT = prvp;
@@ -1385,12 +1508,10 @@ void calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
       }
       if (diffs > nt)
       {
-        box1 = (x >> xshift) << 2;
-        box2 = ((x + xhalf) >> xshift) << 2;
-        diff[temp1 + box1 + 0] += diffs;
-        diff[temp1 + box2 + 1] += diffs;
-        diff[temp2 + box1 + 2] += diffs;
-        diff[temp2 + box2 + 3] += diffs;
+        box1 = (x >> xshift);
+        box2 = ((x + xhalf) >> xshift);
+        hbsum[hbrow + box1 + box2] += diffs;
+        total += diffs;
       }
     }
     // rest non - whole block on the right
@@ -1414,12 +1535,10 @@ void calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
       }
       if (diffs > nt)
       {
-        box1 = (x >> xshift) << 2;
-        box2 = ((x + xhalf) >> xshift) << 2;
-        diff[temp1 + box1 + 0] += diffs;
-        diff[temp1 + box2 + 1] += diffs;
-        diff[temp2 + box1 + 2] += diffs;
-        diff[temp2 + box2 + 3] += diffs;
+        box1 = (x >> xshift);
+        box2 = ((x + xhalf) >> xshift);
+        hbsum[hbrow + box1 + box2] += diffs;
+        total += diffs;
       }
     }
     prvp += prv_pitch * yhalf;
@@ -1428,8 +1547,7 @@ void calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
   // rest non-whole block at the bottom
   for (int y = heighta; y < height; ++y)
   {
-    temp1 = (y >> yshift) * xblocks4;
-    temp2 = ((y + yhalf) >> yshift) * xblocks4;
+    hbrow = ((y >> yshift) + ((y + yhalf) >> yshift)) * hbpitch;
     for (int x = 0; x < width; x += inc)
     {
       if constexpr (SAD) {
@@ -1442,32 +1560,305 @@ void calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
       if constexpr (sizeof(pixel_t) == 2) difft >>= shift_count; // back to 8 bit range
       if (difft > nt)
       {
-        box1 = (x >> xshift) << 2;
-        box2 = ((x + xhalf) >> xshift) << 2;
-        diff[temp1 + box1 + 0] += difft;
-        diff[temp1 + box2 + 1] += difft;
-        diff[temp2 + box1 + 2] += difft;
-        diff[temp2 + box2 + 3] += difft;
+        box1 = (x >> xshift);
+        box2 = ((x + xhalf) >> xshift);
+        hbsum[hbrow + box1 + box2] += difft;
+        total += difft;
       }
     }
     prvp += prv_pitch;
     curp += cur_pitch;
   }
+  return total;
 }
 
 // instantiate
-template void calcDiff_SADorSSD_Generic_c<uint8_t, false, 1>(const uint8_t* prvp, const uint8_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
-template void calcDiff_SADorSSD_Generic_c<uint8_t, false, 2>(const uint8_t* prvp, const uint8_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
-template void calcDiff_SADorSSD_Generic_c<uint8_t, true, 1>(const uint8_t* prvp, const uint8_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
-template void calcDiff_SADorSSD_Generic_c<uint8_t, true, 2>(const uint8_t* prvp, const uint8_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Generic_c<uint8_t, false, 1>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Generic_c<uint8_t, false, 2>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Generic_c<uint8_t, true, 1>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Generic_c<uint8_t, true, 2>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+
+template uint64_t calcDiff_SADorSSD_Generic_c<uint16_t, false, 1>(const uint16_t* prvp, const uint16_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Generic_c<uint16_t, true, 1>(const uint16_t* prvp, const uint16_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+
+
+
+// SIMD SAD/SSD for any block size, bit depth and nt.
+// Each band of yhalf lines is first reduced to per-column sums (uint32 is enough: at most
+// 1024 lines of 8 bit normalized SSD values), then the columns are summed into 64 bit
+// half-block totals. Differences are scaled back to the 8 bit range and compared against nt
+// per pixel, exactly like calcDiff_SADorSSD_Generic_c does.
+
+template<typename pixel_t, bool SAD>
+static void accumulateDiffRow_c(const uint8_t* ptr1, const uint8_t* ptr2, uint32_t* colsum, int x, int width, int shift, int nt)
+{
+  const pixel_t* p1 = reinterpret_cast<const pixel_t*>(ptr1);
+  const pixel_t* p2 = reinterpret_cast<const pixel_t*>(ptr2);
+  for (; x < width; ++x)
+  {
+    uint32_t d = abs(p1[x] - p2[x]);
+    if constexpr (!SAD)
+      d *= d;
+    d >>= shift;
+    if ((int64_t)d > nt)
+      colsum[x] += d;
+  }
+}
 
-template void calcDiff_SADorSSD_Generic_c<uint16_t, false, 1>(const uint16_t* prvp, const uint16_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
-template void calcDiff_SADorSSD_Generic_c<uint16_t, true, 1>(const uint16_t* prvp, const uint16_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+// squares need no SSE4.1 pmulld: the low and high halves of the 16x16 bit products are interleaved
+template<typename pixel_t, bool SAD>
+static void accumulateDiffRow_SSE2(const uint8_t* ptr1, const uint8_t* ptr2, uint32_t* colsum, int width, int shift, int nt)
+{
+  const pixel_t* p1 = reinterpret_cast<const pixel_t*>(ptr1);
+  const pixel_t* p2 = reinterpret_cast<const pixel_t*>(ptr2);
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ntv = _mm_set1_epi32(nt);
+  int x = 0;
+  for (; x + 8 <= width; x += 8)
+  {
+    __m128i a, b;
+    if constexpr (sizeof(pixel_t) == 1) {
+      a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p1 + x)), zero);
+      b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p2 + x)), zero);
+    }
+    else {
+      a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + x));
+      b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p2 + x));
+    }
+    __m128i d = _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+    __m128i lo, hi;
+    if constexpr (SAD) {
+      lo = _mm_unpacklo_epi16(d, zero);
+      hi = _mm_unpackhi_epi16(d, zero);
+    }
+    else {
+      __m128i sqlo = _mm_mullo_epi16(d, d);
+      __m128i sqhi = _mm_mulhi_epu16(d, d);
+      lo = _mm_unpacklo_epi16(sqlo, sqhi);
+      hi = _mm_unpackhi_epi16(sqlo, sqhi);
+    }
+    // after the shift values fit in 17 bits, signed compare is safe
+    lo = _mm_srl_epi32(lo, sh);
+    hi = _mm_srl_epi32(hi, sh);
+    lo = _mm_and_si128(lo, _mm_cmpgt_epi32(lo, ntv));
+    hi = _mm_and_si128(hi, _mm_cmpgt_epi32(hi, ntv));
+    __m128i* dst = reinterpret_cast<__m128i*>(colsum + x);
+    _mm_storeu_si128(dst, _mm_add_epi32(_mm_loadu_si128(dst), lo));
+    _mm_storeu_si128(dst + 1, _mm_add_epi32(_mm_loadu_si128(dst + 1), hi));
+  }
+  accumulateDiffRow_c<pixel_t, SAD>(ptr1, ptr2, colsum, x, width, shift, nt);
+}
 
+#ifdef VS_TARGET_CPU_X86
+template<typename pixel_t, bool SAD>
+#if defined(GCC) || defined(CLANG)
+__attribute__((__target__("avx2")))
+#endif
+static void accumulateDiffRow_AVX2(const uint8_t* ptr1, const uint8_t* ptr2, uint32_t* colsum, int width, int shift, int nt)
+{
+  const pixel_t* p1 = reinterpret_cast<const pixel_t*>(ptr1);
+  const pixel_t* p2 = reinterpret_cast<const pixel_t*>(ptr2);
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const __m256i ntv = _mm256_set1_epi32(nt);
+  int x = 0;
+  for (; x + 16 <= width; x += 16)
+  {
+    __m256i a, b;
+    if constexpr (sizeof(pixel_t) == 1) {
+      a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + x)));
+      b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p2 + x)));
+    }
+    else {
+      a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + x));
+      b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p2 + x));
+    }
+    __m256i d = _mm256_or_si256(_mm256_subs_epu16(a, b), _mm256_subs_epu16(b, a));
+    __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(d));
+    __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(d, 1));
+    if constexpr (!SAD) {
+      lo = _mm256_mullo_epi32(lo, lo);
+      hi = _mm256_mullo_epi32(hi, hi);
+    }
+    lo = _mm256_srl_epi32(lo, sh);
+    hi = _mm256_srl_epi32(hi, sh);
+    lo = _mm256_and_si256(lo, _mm256_cmpgt_epi32(lo, ntv));
+    hi = _mm256_and_si256(hi, _mm256_cmpgt_epi32(hi, ntv));
+    __m256i* dst = reinterpret_cast<__m256i*>(colsum + x);
+    _mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_loadu_si256(dst), lo));
+    _mm256_storeu_si256(dst + 1, _mm256_add_epi32(_mm256_loadu_si256(dst + 1), hi));
+  }
+  accumulateDiffRow_c<pixel_t, SAD>(ptr1, ptr2, colsum, x, width, shift, nt);
+}
 
+template<typename pixel_t, bool SAD>
+#if defined(GCC) || defined(CLANG)
+__attribute__((__target__("avx512f,avx512bw")))
+#endif
+static void accumulateDiffRow_AVX512(const uint8_t* ptr1, const uint8_t* ptr2, uint32_t* colsum, int width, int shift, int nt)
+{
+  const pixel_t* p1 = reinterpret_cast<const pixel_t*>(ptr1);
+  const pixel_t* p2 = reinterpret_cast<const pixel_t*>(ptr2);
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  const __m512i ntv = _mm512_set1_epi32(nt);
+  int x = 0;
+  for (; x + 32 <= width; x += 32)
+  {
+    // zero-masked forms throughout: the plain ones trip gcc's maybe-uninitialized check in the intrinsic headers
+    __m512i a, b;
+    if constexpr (sizeof(pixel_t) == 1) {
+      a = _mm512_maskz_cvtepu8_epi16(0xFFFFFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + x)));
+      b = _mm512_maskz_cvtepu8_epi16(0xFFFFFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p2 + x)));
+    }
+    else {
+      a = _mm512_loadu_si512(p1 + x);
+      b = _mm512_loadu_si512(p2 + x);
+    }
+    __m512i d = _mm512_or_si512(_mm512_subs_epu16(a, b), _mm512_subs_epu16(b, a));
+    __m512i lo = _mm512_maskz_cvtepu16_epi32(0xFFFF, _mm512_maskz_extracti64x4_epi64(0xFF, d, 0));
+    __m512i hi = _mm512_maskz_cvtepu16_epi32(0xFFFF, _mm512_maskz_extracti64x4_epi64(0xFF, d, 1));
+    if constexpr (!SAD) {
+      lo = _mm512_mullo_epi32(lo, lo);
+      hi = _mm512_mullo_epi32(hi, hi);
+    }
+    lo = _mm512_maskz_srl_epi32(0xFFFF, lo, sh);
+    hi = _mm512_maskz_srl_epi32(0xFFFF, hi, sh);
+    uint32_t* dst = colsum + x;
+    _mm512_storeu_si512(dst, _mm512_mask_add_epi32(_mm512_loadu_si512(dst), _mm512_cmpgt_epi32_mask(lo, ntv), _mm512_loadu_si512(dst), lo));
+    _mm512_storeu_si512(dst + 16, _mm512_mask_add_epi32(_mm512_loadu_si512(dst + 16), _mm512_cmpgt_epi32_mask(hi, ntv), _mm512_loadu_si512(dst + 16), hi));
+  }
+  accumulateDiffRow_c<pixel_t, SAD>(ptr1, ptr2, colsum, x, width, shift, nt);
+}
+#endif
+
+template<typename pixel_t, bool SAD>
+static uint64_t calcDiff_SADorSSD_Colsum(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum,
+  bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi,
+  void (*accumulateRow)(const uint8_t*, const uint8_t*, uint32_t*, int, int, int))
+{
+  const int ysubsampling = plane == 0 ? 0 : vi->format->subSamplingH;
+  const int xsubsampling = plane == 0 ? 0 : vi->format->subSamplingW;
+  const int yshift = yshiftS - ysubsampling;
+  const int yhalf = yhalfS >> ysubsampling;
+  const int xshift = xshiftS - xsubsampling;
+  const int xhalf = xhalfS >> xsubsampling;
+
+  if (xhalf == 0 || yhalf == 0)
+  {
+    // 4:1:1 chroma with blockx=4, no whole half-blocks at all
+    return calcDiff_SADorSSD_Generic_c<pixel_t, SAD, 1>(reinterpret_cast<const pixel_t*>(prvp), reinterpret_cast<const pixel_t*>(curp),
+      prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum, chroma, xshiftS, yshiftS, xhalfS, yhalfS, nt, vi);
+  }
+
+  const int bits_per_pixel = vi->format->bitsPerSample;
+  const int shift_count = sizeof(pixel_t) == 1 ? 0 : SAD ? (bits_per_pixel - 8) : 2 * (bits_per_pixel - 8);
+  prv_pitch *= sizeof(pixel_t);
+  cur_pitch *= sizeof(pixel_t);
+
+  std::vector<uint32_t> colsum(width);
+  uint64_t total = 0;
+
+  for (int y = 0; y < height; y += yhalf)
+  {
+    const int lines = std::min(yhalf, height - y);
+    std::fill(colsum.begin(), colsum.end(), 0);
+    for (int u = 0; u < lines; ++u)
+    {
+      accumulateRow(prvp, curp, colsum.data(), width, shift_count, nt);
+      prvp += prv_pitch;
+      curp += cur_pitch;
+    }
+    const int hbrow = ((y >> yshift) + ((y + yhalf) >> yshift)) * hbpitch;
+    for (int x = 0; x < width; x += xhalf)
+    {
+      const int xe = std::min(x + xhalf, width);
+      uint64_t diffs = 0;
+      if (lines < yhalf)
+      {
+        // bottom lines are only thresholded per pixel
+        for (int v = x; v < xe; ++v)
+          diffs += colsum[v];
+      }
+      else if (xe - x == xhalf)
+      {
+        for (int v = x; v < xe; ++v)
+          diffs += colsum[v];
+        if ((int64_t)diffs <= nt)
+          continue;
+      }
+      else
+      {
+        // columns on the right are thresholded one by one
+        for (int v = x; v < xe; ++v)
+          if ((int64_t)colsum[v] > nt)
+            diffs += colsum[v];
+      }
+      const int box1 = (x >> xshift);
+      const int box2 = ((x + xhalf) >> xshift);
+      hbsum[hbrow + box1 + box2] += diffs;
+      total += diffs;
+    }
+  }
+  return total;
+}
+
+template<typename pixel_t, bool SAD>
+uint64_t calcDiff_SADorSSD_Colsum_SSE2(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum,
+  bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi)
+{
+  return calcDiff_SADorSSD_Colsum<pixel_t, SAD>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum,
+    chroma, xshiftS, yshiftS, xhalfS, yhalfS, nt, vi, accumulateDiffRow_SSE2<pixel_t, SAD>);
+}
+
+template uint64_t calcDiff_SADorSSD_Colsum_SSE2<uint8_t, false>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_SSE2<uint8_t, true>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_SSE2<uint16_t, false>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_SSE2<uint16_t, true>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+
+#ifdef VS_TARGET_CPU_X86
+template<typename pixel_t, bool SAD>
+uint64_t calcDiff_SADorSSD_Colsum_AVX2(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum,
+  bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi)
+{
+  return calcDiff_SADorSSD_Colsum<pixel_t, SAD>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum,
+    chroma, xshiftS, yshiftS, xhalfS, yhalfS, nt, vi, accumulateDiffRow_AVX2<pixel_t, SAD>);
+}
+
+template uint64_t calcDiff_SADorSSD_Colsum_AVX2<uint8_t, false>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_AVX2<uint8_t, true>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_AVX2<uint16_t, false>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_AVX2<uint16_t, true>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template<typename pixel_t, bool SAD>
+uint64_t calcDiff_SADorSSD_Colsum_AVX512(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum,
+  bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi)
+{
+  return calcDiff_SADorSSD_Colsum<pixel_t, SAD>(prvp, curp, prv_pitch, cur_pitch, width, height, plane, hbpitch, hbsum,
+    chroma, xshiftS, yshiftS, xhalfS, yhalfS, nt, vi, accumulateDiffRow_AVX512<pixel_t, SAD>);
+}
+template uint64_t calcDiff_SADorSSD_Colsum_AVX512<uint8_t, false>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_AVX512<uint8_t, true>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_AVX512<uint16_t, false>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+template uint64_t calcDiff_SADorSSD_Colsum_AVX512<uint16_t, true>(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+#endif
@@ -80,21 +80,55 @@ void calcSAD_SSE2_16xN(const uint8_t *ptr1, const uint8_t *ptr2, int pitch1, int
 
 
 //-- helpers
-void calcDiffSAD_32x32_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t *diff, bool chroma, const VSVideoInfo *vi);
+// block difference kernels add every half-block sum once into hbsum (hbpitch = 2 * xblocks entries a row)
+// and return the total they added (the scene metric of the plane)
+uint64_t calcDiffSAD_32x32_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, const VSVideoInfo *vi);
 
-void calcDiffSSD_32x32_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t *diff, bool chroma, const VSVideoInfo *vi);
+uint64_t calcDiffSSD_32x32_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, const VSVideoInfo *vi);
 
-void calcDiffSSD_Generic_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t *diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi);
+uint64_t calcDiffSSD_Generic_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi);
 
-void calcDiffSAD_Generic_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
-  int pitch1, int pitch2, int width, int height, int plane, int xblocks4, uint64_t *diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi);
+uint64_t calcDiffSAD_Generic_SSE2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi);
+
+#ifdef VS_TARGET_CPU_X86
+uint64_t calcDiffSAD_32x32_AVX2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, const VSVideoInfo *vi);
+
+uint64_t calcDiffSSD_32x32_AVX2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, const VSVideoInfo *vi);
+
+uint64_t calcDiffSSD_Generic_AVX2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi);
+
+uint64_t calcDiffSAD_Generic_AVX2(const uint8_t *ptr1, const uint8_t *ptr2,
+  int pitch1, int pitch2, int width, int height, int plane, int hbpitch, uint64_t *hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, const VSVideoInfo *vi);
+#endif
+
+// any block size, 8 and 10-16 bits, pitch in pixels
+template<typename pixel_t, bool SAD>
+uint64_t calcDiff_SADorSSD_Colsum_SSE2(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+
+#ifdef VS_TARGET_CPU_X86
+template<typename pixel_t, bool SAD>
+uint64_t calcDiff_SADorSSD_Colsum_AVX2(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+
+template<typename pixel_t, bool SAD>
+uint64_t calcDiff_SADorSSD_Colsum_AVX512(const uint8_t* prvp, const uint8_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+#endif
 
 template<typename pixel_t, bool SAD, int inc>
-void calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
-  int prv_pitch, int cur_pitch, int width, int height, int plane, int xblocks4, uint64_t* diff, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+uint64_t calcDiff_SADorSSD_Generic_c(const pixel_t* prvp, const pixel_t* curp,
+  int prv_pitch, int cur_pitch, int width, int height, int plane, int hbpitch, uint64_t* hbsum, bool chroma, int xshiftS, int yshiftS, int xhalfS, int yhalfS, int nt, const VSVideoInfo *vi);
+
+// half-block sums to the 4-entry-per-block overlapping grids
+void addOverlappingBlocks(const uint64_t* hbsum, uint64_t* diff, int xblocks, int yblocks);
 
 void CalcMetricsExtracted(const VSFrameRef *prevt, const VSFrameRef *currt, CalcMetricData& d, VSCore *core, const VSAPI *vsapi);
 
@@ -113,9 +147,6 @@ void HorizontalBlur_Planar_SSE2(const uint8_t* srcp, uint8_t* dstp, int src_pitc
 //void HorizontalBlur_YUY2_SSE2(const uint8_t* srcp, uint8_t* dstp, int src_pitch,
 //  int dst_pitch, int width, int height);
 
-void HorizontalBlur(const VSFrameRef *src, VSFrameRef *dst, bool bchroma,
-  const CPUFeatures *cpuFlags, const VSAPI *vsapi);
-
 template<typename pixel_t>
 void VerticalBlur_c(const uint8_t* srcp, uint8_t* dstp, int src_pitch,
   int dst_pitch, int width, int height);
@@ -125,7 +156,6 @@ void VerticalBlur_c(const uint8_t* srcp, uint8_t* dstp, int src_pitch,
 void VerticalBlur_SSE2(const uint8_t* srcp, uint8_t* dstp, int src_pitch,
   int dst_pitch, int width, int height);
 
-void VerticalBlur(const VSFrameRef *src, VSFrameRef *dst, bool bchroma, const CPUFeatures *opti, const VSAPI *vsapi);
 
 
 // handles 50% special case as well
@@ -26,62 +26,279 @@
 #include "TDecimate.h"
 #include "TDecimateASM.h"
 
-// hbd ready
-void blurFrame(const VSFrameRef *src, VSFrameRef *dst, int iterations,
-  bool bchroma, const CPUFeatures *cpuFlags, VSCore *core, const VSAPI *vsapi)
+#ifdef VS_TARGET_CPU_X86
+#include <immintrin.h>
+#endif
+
+// (a + 2b + c + 2) >> 2 without widening: average b with the rounded down average of a and c
+template<typename pixel_t>
+static inline __m128i blur3_SSE2(__m128i a, __m128i b, __m128i c)
 {
-    const VSFormat *format = vsapi->getFrameFormat(src);
-    int width = vsapi->getFrameWidth(src, 0);
-    int height = vsapi->getFrameHeight(src, 0);
-
-  VSFrameRef *tmp = vsapi->newVideoFrame(format, width, height, nullptr, core);
-  HorizontalBlur(src, tmp, bchroma, cpuFlags, vsapi);
-  VerticalBlur(tmp, dst, bchroma, cpuFlags, vsapi);
-  for (int i = 1; i < iterations; ++i)
-  {
-    HorizontalBlur(dst, tmp, bchroma, cpuFlags, vsapi);
-    VerticalBlur(tmp, dst, bchroma, cpuFlags, vsapi);
+  if constexpr (sizeof(pixel_t) == 1) {
+    __m128i ac = _mm_sub_epi8(_mm_avg_epu8(a, c), _mm_and_si128(_mm_xor_si128(a, c), _mm_set1_epi8(1)));
+    return _mm_avg_epu8(ac, b);
   }
-  vsapi->freeFrame(tmp);
+  else {
+    __m128i ac = _mm_sub_epi16(_mm_avg_epu16(a, c), _mm_and_si128(_mm_xor_si128(a, c), _mm_set1_epi16(1)));
+    return _mm_avg_epu16(ac, b);
+  }
+}
+
+template<typename pixel_t>
+static inline __m128i blur2_SSE2(__m128i a, __m128i b)
+{
+  if constexpr (sizeof(pixel_t) == 1)
+    return _mm_avg_epu8(a, b);
+  else
+    return _mm_avg_epu16(a, b);
 }
 
-void HorizontalBlur(const VSFrameRef *src, VSFrameRef *dst, bool bchroma,
-  const CPUFeatures *cpuFlags, const VSAPI *vsapi)
+// one row of the horizontal [1 2 1] pass, edges use [1 1]
+template<typename pixel_t>
+static void blurRowH_c(const uint8_t *srcp0, uint8_t *dstp0, int width)
 {
-    const VSFormat *format = vsapi->getFrameFormat(src);
+  const pixel_t *srcp = reinterpret_cast<const pixel_t *>(srcp0);
+  pixel_t *dstp = reinterpret_cast<pixel_t *>(dstp0);
+  if (width == 1) {
+    dstp[0] = srcp[0];
+    return;
+  }
+  dstp[0] = (srcp[0] + srcp[1] + 1) >> 1;
+  for (int x = 1; x < width - 1; ++x)
+    dstp[x] = (srcp[x - 1] + (srcp[x] << 1) + srcp[x + 1] + 2) >> 2;
+  dstp[width - 1] = (srcp[width - 2] + srcp[width - 1] + 1) >> 1;
+}
 
-  const int np = !bchroma ? 1 : format->numPlanes;
+// one row of the vertical pass, [1 1] of a and b for the top and bottom lines (c == nullptr)
+template<typename pixel_t>
+static void blurRowV_c(const uint8_t *ap0, const uint8_t *bp0, const uint8_t *cp0, uint8_t *dstp0, int width)
+{
+  const pixel_t *ap = reinterpret_cast<const pixel_t *>(ap0);
+  const pixel_t *bp = reinterpret_cast<const pixel_t *>(bp0);
+  const pixel_t *cp = reinterpret_cast<const pixel_t *>(cp0);
+  pixel_t *dstp = reinterpret_cast<pixel_t *>(dstp0);
+  if (cp == nullptr) {
+    for (int x = 0; x < width; ++x)
+      dstp[x] = (ap[x] + bp[x] + 1) >> 1;
+    return;
+  }
+  for (int x = 0; x < width; ++x)
+    dstp[x] = (ap[x] + (bp[x] << 1) + cp[x] + 2) >> 2;
+}
+
+template<typename pixel_t>
+static void blurRowH_SSE2(const uint8_t *srcp0, uint8_t *dstp0, int width)
+{
+  constexpr int step = 16 / sizeof(pixel_t);
+  if (width < step + 2) {
+    blurRowH_c<pixel_t>(srcp0, dstp0, width);
+    return;
+  }
+  const pixel_t *srcp = reinterpret_cast<const pixel_t *>(srcp0);
+  pixel_t *dstp = reinterpret_cast<pixel_t *>(dstp0);
+  dstp[0] = (srcp[0] + srcp[1] + 1) >> 1;
+  int x = 1;
+  for (; x + step <= width - 1; x += step) {
+    __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcp + x - 1));
+    __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcp + x));
+    __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcp + x + 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dstp + x), blur3_SSE2<pixel_t>(left, center, right));
+  }
+  // the rest as one vector overlapping the last one, dst is a separate row
+  if (x < width - 1) {
+    x = width - 1 - step;
+    __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcp + x - 1));
+    __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcp + x));
+    __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcp + x + 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dstp + x), blur3_SSE2<pixel_t>(left, center, right));
+  }
+  dstp[width - 1] = (srcp[width - 2] + srcp[width - 1] + 1) >> 1;
+}
+
+template<typename pixel_t>
+static void blurRowV_SSE2(const uint8_t *ap, const uint8_t *bp, const uint8_t *cp, uint8_t *dstp, int width)
+{
+  const int rowsize = width * sizeof(pixel_t);
+  const int rowsizea = rowsize & ~15;
+  for (int x = 0; x < rowsizea; x += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ap + x));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bp + x));
+    __m128i res = cp == nullptr ? blur2_SSE2<pixel_t>(a, b) :
+      blur3_SSE2<pixel_t>(a, b, _mm_loadu_si128(reinterpret_cast<const __m128i *>(cp + x)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dstp + x), res);
+  }
+  if (rowsizea < rowsize && rowsizea > 0) {
+    const int x = rowsize - 16;
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ap + x));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bp + x));
+    __m128i res = cp == nullptr ? blur2_SSE2<pixel_t>(a, b) :
+      blur3_SSE2<pixel_t>(a, b, _mm_loadu_si128(reinterpret_cast<const __m128i *>(cp + x)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dstp + x), res);
+  }
+  else if (rowsizea < rowsize)
+    blurRowV_c<pixel_t>(ap + rowsizea, bp + rowsizea, cp ? cp + rowsizea : nullptr, dstp + rowsizea, (rowsize - rowsizea) / sizeof(pixel_t));
+}
+
+#ifdef VS_TARGET_CPU_X86
+template<typename pixel_t>
+#if defined(GCC) || defined(CLANG)
+__attribute__((__target__("avx2")))
+#endif
+static inline __m256i blur3_AVX2(__m256i a, __m256i b, __m256i c)
+{
+  if constexpr (sizeof(pixel_t) == 1) {
+    __m256i ac = _mm256_sub_epi8(_mm256_avg_epu8(a, c), _mm256_and_si256(_mm256_xor_si256(a, c), _mm256_set1_epi8(1)));
+    return _mm256_avg_epu8(ac, b);
+  }
+  else {
+    __m256i ac = _mm256_sub_epi16(_mm256_avg_epu16(a, c), _mm256_and_si256(_mm256_xor_si256(a, c), _mm256_set1_epi16(1)));
+    return _mm256_avg_epu16(ac, b);
+  }
+}
+
+template<typename pixel_t>
+#if defined(GCC) || defined(CLANG)
+__attribute__((__target__("avx2")))
+#endif
+static inline __m256i blur2_AVX2(__m256i a, __m256i b)
+{
+  if constexpr (sizeof(pixel_t) == 1)
+    return _mm256_avg_epu8(a, b);
+  else
+    return _mm256_avg_epu16(a, b);
+}
 
-  const bool use_sse2 = cpuFlags->sse2;
+template<typename pixel_t>
+#if defined(GCC) || defined(CLANG)
+__attribute__((__target__("avx2")))
+#endif
+static void blurRowH_AVX2(const uint8_t *srcp0, uint8_t *dstp0, int width)
+{
+  constexpr int step = 32 / sizeof(pixel_t);
+  if (width < step + 2) {
+    blurRowH_SSE2<pixel_t>(srcp0, dstp0, width);
+    return;
+  }
+  const pixel_t *srcp = reinterpret_cast<const pixel_t *>(srcp0);
+  pixel_t *dstp = reinterpret_cast<pixel_t *>(dstp0);
+  dstp[0] = (srcp[0] + srcp[1] + 1) >> 1;
+  int x = 1;
+  for (; x + step <= width - 1; x += step) {
+    __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcp + x - 1));
+    __m256i center = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcp + x));
+    __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcp + x + 1));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dstp + x), blur3_AVX2<pixel_t>(left, center, right));
+  }
+  // the rest as one vector overlapping the last one, dst is a separate row
+  if (x < width - 1) {
+    x = width - 1 - step;
+    __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcp + x - 1));
+    __m256i center = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcp + x));
+    __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcp + x + 1));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dstp + x), blur3_AVX2<pixel_t>(left, center, right));
+  }
+  dstp[width - 1] = (srcp[width - 2] + srcp[width - 1] + 1) >> 1;
+}
+
+template<typename pixel_t>
+#if defined(GCC) || defined(CLANG)
+__attribute__((__target__("avx2")))
+#endif
+static void blurRowV_AVX2(const uint8_t *ap, const uint8_t *bp, const uint8_t *cp, uint8_t *dstp, int width)
+{
+  const int rowsize = width * sizeof(pixel_t);
+  const int rowsizea = rowsize & ~31;
+  for (int x = 0; x < rowsizea; x += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ap + x));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bp + x));
+    __m256i res = cp == nullptr ? blur2_AVX2<pixel_t>(a, b) :
+      blur3_AVX2<pixel_t>(a, b, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cp + x)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dstp + x), res);
+  }
+  // the rest as one vector overlapping the last one, the rows are not dst
+  if (rowsizea < rowsize && rowsizea > 0) {
+    const int x = rowsize - 32;
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ap + x));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bp + x));
+    __m256i res = cp == nullptr ? blur2_AVX2<pixel_t>(a, b) :
+      blur3_AVX2<pixel_t>(a, b, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cp + x)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dstp + x), res);
+  }
+  else if (rowsizea < rowsize)
+    blurRowV_SSE2<pixel_t>(ap + rowsizea, bp + rowsizea, cp ? cp + rowsizea : nullptr, dstp + rowsizea, (rowsize - rowsizea) / sizeof(pixel_t));
+}
+#endif
+
+typedef void (*BlurRowHFn)(const uint8_t *srcp, uint8_t *dstp, int width);
+typedef void (*BlurRowVFn)(const uint8_t *ap, const uint8_t *bp, const uint8_t *cp, uint8_t *dstp, int width);
+
+// Horizontal and vertical pass in one sweep: horizontally blurred lines are kept
+// in a three line ring, the vertical pass writes dst as soon as its lower
+// neighbour is ready. Source line y+1 is consumed before dst line y is written,
+// so src and dst may be the same plane.
+static void blurPlane(const uint8_t *srcp, uint8_t *dstp, int src_pitch, int dst_pitch,
+  int width, int height, uint8_t *rows[3], BlurRowHFn blurH, BlurRowVFn blurV)
+{
+  if (height == 1) {
+    blurH(srcp, rows[0], width);
+    blurV(rows[0], rows[0], nullptr, dstp, width);
+    return;
+  }
+  blurH(srcp, rows[0], width);
+  blurH(srcp + src_pitch, rows[1], width);
+  blurV(rows[0], rows[1], nullptr, dstp, width);
+  for (int y = 1; y < height - 1; ++y)
+  {
+    blurH(srcp + (y + 1) * src_pitch, rows[(y + 1) % 3], width);
+    blurV(rows[(y - 1) % 3], rows[y % 3], rows[(y + 1) % 3], dstp + y * dst_pitch, width);
+  }
+  blurV(rows[(height - 2) % 3], rows[(height - 1) % 3], nullptr, dstp + (height - 1) * dst_pitch, width);
+}
 
+// hbd ready
+void blurFrame(const VSFrameRef *src, VSFrameRef *dst, int iterations,
+  bool bchroma, const CPUFeatures *cpuFlags, VSCore *core, const VSAPI *vsapi)
+{
+  (void)core;
+  const VSFormat *format = vsapi->getFrameFormat(src);
+  const int np = !bchroma ? 1 : format->numPlanes;
   const int pixelsize = format->bytesPerSample;
 
+  BlurRowHFn blurH;
+  BlurRowVFn blurV;
+#ifdef VS_TARGET_CPU_X86
+  if (cpuFlags->avx2)
+  {
+    blurH = pixelsize == 1 ? blurRowH_AVX2<uint8_t> : blurRowH_AVX2<uint16_t>;
+    blurV = pixelsize == 1 ? blurRowV_AVX2<uint8_t> : blurRowV_AVX2<uint16_t>;
+  }
+  else
+#endif
+  if (cpuFlags->sse2)
+  {
+    blurH = pixelsize == 1 ? blurRowH_SSE2<uint8_t> : blurRowH_SSE2<uint16_t>;
+    blurV = pixelsize == 1 ? blurRowV_SSE2<uint8_t> : blurRowV_SSE2<uint16_t>;
+  }
+  else
+  {
+    blurH = pixelsize == 1 ? blurRowH_c<uint8_t> : blurRowH_c<uint16_t>;
+    blurV = pixelsize == 1 ? blurRowV_c<uint8_t> : blurRowV_c<uint16_t>;
+  }
+
+  const int rowsize = (vsapi->getFrameWidth(src, 0) * pixelsize + 63) & ~63;
+  std::vector<uint8_t> rowbuf(rowsize * 3);
+  uint8_t *rows[3] = { rowbuf.data(), rowbuf.data() + rowsize, rowbuf.data() + rowsize * 2 };
+
   for (int b = 0; b < np; ++b)
   {
-    const int plane = b;
-    const uint8_t *srcp = vsapi->getReadPtr(src, plane);
-    int src_pitch = vsapi->getStride(src, plane);
-    int width = vsapi->getFrameWidth(src, plane);
-    int widtha = (width >> 3) << 3; // mod 8
-    int height = vsapi->getFrameHeight(src, plane);
-    uint8_t *dstp = vsapi->getWritePtr(dst, plane);
-    int dst_pitch = vsapi->getStride(dst, plane);
-
-      if (pixelsize == 1 && use_sse2 && width >= 8)
-      {
-        // always mod 8, sse2 unaligned!
-        HorizontalBlur_Planar_SSE2(srcp, dstp, src_pitch, dst_pitch, widtha, height);
-        // rest non mod 8 no the right
-        HorizontalBlur_Planar_c<uint8_t>(srcp + widtha, dstp + widtha, src_pitch, dst_pitch, width - widtha, height, true);
-      }
-      else
-      {
-        // fixme: implement SIMD for 10-16 bits
-        if(pixelsize == 1)
-          HorizontalBlur_Planar_c<uint8_t>(srcp, dstp, src_pitch, dst_pitch, width, height, false);
-        else // 10-16 bits
-          HorizontalBlur_Planar_c<uint16_t>(srcp, dstp, src_pitch, dst_pitch, width, height, false);
-      }
+    const int width = vsapi->getFrameWidth(src, b);
+    const int height = vsapi->getFrameHeight(src, b);
+    const int dst_pitch = vsapi->getStride(dst, b);
+    uint8_t *dstp = vsapi->getWritePtr(dst, b);
+    blurPlane(vsapi->getReadPtr(src, b), dstp, vsapi->getStride(src, b), dst_pitch, width, height, rows, blurH, blurV);
+    // further iterations work in place
+    for (int i = 1; i < iterations; ++i)
+      blurPlane(dstp, dstp, dst_pitch, dst_pitch, width, height, rows, blurH, blurV);
   }
 }
 
@@ -162,46 +379,6 @@ void VerticalBlur_SSE2(const uint8_t* srcp, uint8_t* dstp, int src_pitch,
   }
 }
 
-void VerticalBlur(const VSFrameRef *src, VSFrameRef *dst, bool bchroma,
-  const CPUFeatures *cpuFlags, const VSAPI *vsapi)
-{
-    const VSFormat *format = vsapi->getFrameFormat(src);
-
-  const int np = !bchroma ? 1 : format->numPlanes;
-
-  const bool use_sse2 = cpuFlags->sse2;
-
-  const int pixelsize = format->bytesPerSample;
-
-  for (int b = 0; b < np; ++b)
-  {
-    const int plane = b;
-    const uint8_t* srcp = vsapi->getReadPtr(src, plane);
-    int src_pitch = vsapi->getStride(src, plane);
-    int width = vsapi->getFrameWidth(src, plane);
-    int widtha = (width >> 4) << 4; // mod 16
-    int height = vsapi->getFrameHeight(src, plane);
-    uint8_t* dstp = vsapi->getWritePtr(dst, plane);
-    int dst_pitch = vsapi->getStride(dst, plane);
-
-      if (pixelsize == 1 && use_sse2 && widtha >= 16)
-      {
-        // 16x block is Ok
-        VerticalBlur_SSE2(srcp, dstp, src_pitch, dst_pitch, widtha, height);
-        //the rest on the right not covered by SIMD
-        VerticalBlur_c<uint8_t>(srcp + widtha, dstp + widtha, src_pitch, dst_pitch, width - widtha, height);
-      }
-      else {
-        // fixme: implement SIMD for 10-16 bits
-        if(pixelsize == 1)
-          VerticalBlur_c<uint8_t>(srcp, dstp, src_pitch, dst_pitch, width, height);
-        else // 10-16 bits
-          VerticalBlur_c<uint16_t>(srcp, dstp, src_pitch, dst_pitch, width, height);
-      }
-
-  }
-}
-
 template<typename pixel_t>
 void HorizontalBlur_Planar_c(const uint8_t* srcp0, uint8_t* dstp0, int src_pitch,
   int dst_pitch, int width, int height, bool allow_leftminus1)
@@ -396,3 +573,53 @@ void HorizontalBlur_Planar_SSE2(const uint8_t *srcp, uint8_t *dstp, int src_pitc
 //    dstp += dst_pitch;
 //  }
 //}
+
+BlurCache::BlurCache(size_t _capacity, bool _chroma, const CPUFeatures *_cpuFlags, const VSAPI *_vsapi) :
+  vsapi(_vsapi), chroma(_chroma), cpuFlags(_cpuFlags), capacity(_capacity < 2 ? 2 : _capacity)
+{
+}
+
+BlurCache::~BlurCache()
+{
+  for (auto &e : entries)
+    vsapi->freeFrame(e.second);
+}
+
+const VSFrameRef *BlurCache::get(int n, const VSFrameRef *src, VSCore *core)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+      if (it->first == n)
+      {
+        entries.splice(entries.begin(), entries, it);
+        return vsapi->cloneFrameRef(it->second);
+      }
+    }
+  }
+
+  // blur outside of the lock, other threads may be working on other frames
+  const VSFormat *format = vsapi->getFrameFormat(src);
+  VSFrameRef *dst = vsapi->newVideoFrame(format, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), nullptr, core);
+  blurFrame(src, dst, 2, chroma, cpuFlags, core, vsapi);
+
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto it = entries.begin(); it != entries.end(); ++it)
+  {
+    if (it->first == n)
+    {
+      // someone else was faster, keep theirs
+      vsapi->freeFrame(dst);
+      entries.splice(entries.begin(), entries, it);
+      return vsapi->cloneFrameRef(it->second);
+    }
+  }
+  entries.emplace_front(n, dst);
+  while (entries.size() > capacity)
+  {
+    vsapi->freeFrame(entries.back().second);
+    entries.pop_back();
+  }
+  return vsapi->cloneFrameRef(dst);
+}
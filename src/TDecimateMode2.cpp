@@ -35,76 +35,69 @@ const VSFrameRef * TDecimate::GetFrameMode2(int n, int activationReason, void **
   int ret = -20;
   if (mode2_numCycles >= 0)
   {
-    int cycleF = -20;
-    for (int x = 0; x < mode2_numCycles; ++x)
-    {
-      if (aLUT[x * 5 + 1] <= n && aLUT[x * 5 + 3] > n)
-      {
-        cycleF = x;
-        break;
-      }
+    const int cycleF = findCycleMode2(n);
+    if (cycleF < 0) {
+      vsapi->setFilterError("TDecimate:  mode 2 internal error (no cycle for output frame). Please report this ASAP!", frameCtx);
+      return nullptr;
     }
 
     if (activationReason == arInitial) {
-        if (cycleF > 0) {
-            int start = aLUT[(cycleF - 1) * 5] - 1;
-            int end = start + curr.length;
-            for (int i = start; i < end; i++)
-                vsapi->requestFrameFilter(std::max(0, std::min(i, vi_child->numFrames - 1)), child, frameCtx);
+        // a decided cycle only needs the output frame, see below
+        if (mode2_decA[aLUT[cycleF * 5]] == -20) {
+            const int first = std::max(cycleF - 1, 0);
+            const int last = std::min(cycleF + 1, mode2_numCycles - 1);
+            for (int c = first; c <= last; ++c) {
+                int start = aLUT[c * 5] - 1;
+                int end = start + curr.length + 1;
+                for (int i = start; i < end; i++)
+                    vsapi->requestFrameFilter(std::max(0, std::min(i, vi_child->numFrames - 1)), child, frameCtx);
+            }
+            return nullptr;
         }
-
+    }
+    else if ((intptr_t)*frameData != RetFrameIsReady)
+    {
+      // once decided a cycle never changes
+      if (mode2_decA[aLUT[cycleF * 5]] == -20)
+      {
+        if (cycleF > 0 && prev.frame != aLUT[(cycleF - 1) * 5])
         {
-            int start = aLUT[cycleF * 5] - 1;
-            int end = start + curr.length;
-            for (int i = start; i < end; i++)
-                vsapi->requestFrameFilter(std::max(0, std::min(i, vi_child->numFrames - 1)), child, frameCtx);
+          if (curr.frame == aLUT[(cycleF - 1) * 5]) prev.swap(curr);
+          else
+          {
+            prev.setFrame(aLUT[(cycleF - 1) * 5]);
+            getOvrCycle(prev, true);
+            calcMetricCycle(prev, true, false, core, frameCtx);
+            addMetricCycle(prev);
+          }
         }
+        else if (cycleF <= 0) prev.setFrame(-prev.length);
 
-        if (cycleF < mode2_numCycles - 1) {
-            int start = aLUT[(cycleF + 1) * 5] - 1;
-            int end = start + curr.length;
-            for (int i = start; i < end; i++)
-                vsapi->requestFrameFilter(std::max(0, std::min(i, vi_child->numFrames - 1)), child, frameCtx);
+        if (curr.frame != aLUT[cycleF * 5])
+        {
+          if (next.frame == aLUT[cycleF * 5]) curr.swap(next);
+          else
+          {
+            curr.setFrame(aLUT[cycleF * 5]);
+            getOvrCycle(curr, true);
+            calcMetricCycle(curr, true, false, core, frameCtx);
+            addMetricCycle(curr);
+          }
         }
 
-        return nullptr;
-    }
-
-    if (cycleF > 0 && prev.frame != aLUT[(cycleF - 1) * 5])
-    {
-      if (curr.frame == aLUT[(cycleF - 1) * 5]) prev = curr;
-      else
-      {
-        prev.setFrame(aLUT[(cycleF - 1) * 5]);
-        getOvrCycle(prev, true);
-        calcMetricCycle(prev, true, false, core, frameCtx);
-        addMetricCycle(prev);
-      }
-    }
-    else if (cycleF <= 0) prev.setFrame(-prev.length);
+        if (cycleF < mode2_numCycles - 1 && next.frame != aLUT[(cycleF + 1) * 5])
+        {
+          next.setFrame(aLUT[(cycleF + 1) * 5]);
+          getOvrCycle(next, true);
+          calcMetricCycle(next, true, false, core, frameCtx);
+          addMetricCycle(next);
+        }
+        else if (cycleF >= mode2_numCycles - 1) next.setFrame(-next.length);
 
-    if (curr.frame != aLUT[cycleF * 5])
-    {
-      if (next.frame == aLUT[cycleF * 5]) curr = next;
-      else
-      {
-        curr.setFrame(aLUT[cycleF * 5]);
-        getOvrCycle(curr, true);
-        calcMetricCycle(curr, true, false, core, frameCtx);
-        addMetricCycle(curr);
+        mode2MarkDecFrames(cycleF);
       }
     }
 
-    if (cycleF < mode2_numCycles - 1 && next.frame != aLUT[(cycleF + 1) * 5])
-    {
-      next.setFrame(aLUT[(cycleF + 1) * 5]);
-      getOvrCycle(next, true);
-      calcMetricCycle(next, true, false, core, frameCtx);
-      addMetricCycle(next);
-    }
-    else if (cycleF >= mode2_numCycles - 1) next.setFrame(-next.length);
-
-    mode2MarkDecFrames(cycleF);
     ret = getNonDecMode2(n - aLUT[cycleF * 5 + 1], aLUT[cycleF * 5], aLUT[cycleF * 5 + 2]);
   }
   else ret = aLUT[n];
@@ -152,6 +145,23 @@ const VSFrameRef * TDecimate::GetFrameMode2(int n, int activationReason, void **
   return src;
 }
 
+// Output start positions (aLUT[x * 5 + 1]) are non-decreasing and a cycle
+// that outputs nothing shares its start with the following one, so the last
+// cycle starting at or before n is the only one that can contain it.
+int TDecimate::findCycleMode2(int n) const
+{
+  int lo = 0, hi = mode2_numCycles;
+  while (lo < hi)
+  {
+    const int mid = (lo + hi) >> 1;
+    if (aLUT[mid * 5 + 1] <= n) lo = mid + 1;
+    else hi = mid;
+  }
+  const int x = lo - 1;
+  if (x < 0 || aLUT[x * 5 + 3] <= n) return -20;
+  return x;
+}
+
 int TDecimate::getNonDecMode2(int n, int start, int stop) const
 {
   int count = -1, ret = -1;
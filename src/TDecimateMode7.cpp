@@ -27,100 +27,95 @@
 #include <inttypes.h>
 #include <algorithm>
 
+// A decision looks at the one for the previous frame, so they form one
+// chain from frame 0. Decisions are made in chain order and kept in
+// mode7Dec, a request continues from the last one made, mode7Step
+// decisions at a time, each step requesting the frames its metrics need.
+static const int mode7Step = 64;
+
 const VSFrameRef * TDecimate::GetFrameMode7(int n, int activationReason, void **frameData, VSFrameContext *frameCtx, VSCore *core)
 {
     if (activationReason != arInitial && activationReason != arAllFramesReady)
         return nullptr;
 
-  double ratio = fps / rate;
-  int prev_f = int(double(n - 1)*ratio + 1.0);
-  if (prev_f < 0) prev_f = 0;
-  int curr1_f = int(double(n)*ratio);
-  if (curr1_f > nfrms) mode2_decA[n] = nfrms;
-  int curr2_f = int(double(n)*ratio + 1.0);
-  if (curr2_f > nfrms) mode2_decA[n] = nfrms;
-  int next_f = int(double(n + 1)*ratio);
-  if (next_f > nfrms) next_f = nfrms;
-  int curr_real = mode2_decA[n];
+  int pos[4];
+  mode7Positions(n, pos);
+  int &prev_f = pos[0], &curr1_f = pos[1], &curr2_f = pos[2], &next_f = pos[3];
   int chosen = 0;
 
-  if (curr_real == -20) {
-    int prev_real = n == 0 ? -20 : mode2_decA[n - 1];
-    if (prev_real != -20) prev_f = prev_real;
-    bool rup = double(n) * ratio - double(curr1_f) >= 0.5 ? true : false;
-    bool requesting_frames = false;
-    for (int i = std::max(prev_f - 3, 1); i <= std::min(next_f + 2, nfrms); ++i)
+  if (!mode7Dec.isSet(n) && (intptr_t)*frameData != RetFrameIsReady) {
+    // while frames are requested for a step, frameData holds -(last decision of the step + 1)
+    int requested = activationReason == arAllFramesReady && (intptr_t)*frameData < 0 ? int(-(intptr_t)*frameData - 1) : -1;
+    *frameData = nullptr;
+    for (;;)
     {
-      if (metricsOutArray[i << 1] == UINT64_MAX)
+      const bool framesReady = requested >= 0;
+      int base = n - 1;
+      while (base >= 0 && !mode7Dec.isSet(base))
+        --base;
+      const int last = requested >= 0 ? std::min(requested, n) : std::min(n, base + mode7Step);
+      requested = -1;
+      if (last <= base)
+        continue; // someone else made this step's decisions
+
+      int window[4];
+      mode7Positions(base + 1, window);
+      const int lo = std::max(window[0] - 4, 1);
+      mode7Positions(last, window);
+      const int hi = std::min(window[3] + 2, nfrms);
+
+      std::vector<int> missing;
+      for (int i = lo; i <= hi; ++i)
       {
-        if (metricsArray.size() && metricsArray[i << 1] != UINT64_MAX)
-          metricsOutArray[i << 1] = metricsArray[i << 1];
-        else
-        {
-            if (activationReason == arInitial) {
-                vsapi->requestFrameFilter(i - 1, child, frameCtx);
-                vsapi->requestFrameFilter(i, child, frameCtx);
-                requesting_frames = true;
-            } else {
-              int blockNI, blocksI;
-              uint64_t metricF;
-              const VSFrameRef *frame1 = vsapi->getFrameFilter(i - 1, child, frameCtx);
-              const VSFrameRef *frame2 = vsapi->getFrameFilter(i, child, frameCtx);
-              metricsOutArray[i << 1] =
-                calcMetric(frame1, frame2,
-                  vi_child, blockNI, blocksI, metricF, false, core);
-              vsapi->freeFrame(frame1);
-              vsapi->freeFrame(frame2);
-            }
-        }
+        if (!mode7Metrics.isSet(i))
+          missing.push_back(i);
       }
-    }
-    if (requesting_frames)
-        return nullptr;
-
-    try {
-        if (same_group(curr1_f, curr2_f))
-        {
-          if (next_f - curr2_f > 1 && similar_group(prev_f, curr2_f) &&
-            diff_group(next_f, next_f + 1) && diff_group(curr2_f, curr2_f + 1))
-            chosen = 4;
-          else chosen = 2;
-        }
-        else if (same_group(prev_f, curr1_f)) chosen = 1;
-        else if (similar_group(prev_f, curr1_f))
-        {
-          if (similar_group(curr1_f, curr2_f) && !same_group(curr2_f, next_f))
-            chosen = 3;
-          else if (diff_group(curr1_f, curr2_f))
-            chosen = 1;
-        }
-        else if (diff_group(prev_f, curr1_f))
+      if (missing.size() && !framesReady)
+      {
+        for (int i : missing)
         {
-          if (diff_group(curr2_f, next_f)) chosen = 3;
-          else if (diff_group(curr1_f, curr2_f) && same_group(curr1_f - 1, curr1_f) &&
-            same_group(curr2_f, next_f) && diff_group(next_f, next_f + 1) &&
-            curr1_f - prev_f == 2 && diff_group(prev_f - 1, prev_f))
-            chosen = 1;
+          vsapi->requestFrameFilter(i - 1, child, frameCtx);
+          vsapi->requestFrameFilter(i, child, frameCtx);
         }
-    } catch (const TIVTCError &e) {
-        vsapi->setFilterError(e.what(), frameCtx);
+        *frameData = (void *)(intptr_t)-(last + 1);
         return nullptr;
-    }
+      }
 
-    if (chosen == 4) mode2_decA[n] = curr2_f + 1;
-    else if (chosen >= 2) // either
-    {
-      if ((chosen == 2 && rup) || (chosen == 3 &&
-        ((metricsOutArray[curr2_f << 1] * 2 > metricsOutArray[curr1_f << 1] * 3) ||
-          (rup && metricsOutArray[curr2_f << 1] * 3 >= metricsOutArray[curr1_f << 1] * 2))))
-        mode2_decA[n] = curr2_f;
-      else mode2_decA[n] = curr1_f;
+      // concurrent requests for the same step split its pairs between them
+      std::vector<PairMetric> pairs;
+      for (int i : missing)
+      {
+        if (mode7Metrics.claim(i))
+          pairs.push_back({ i, vsapi->getFrameFilter(i - 1, child, frameCtx), vsapi->getFrameFilter(i, child, frameCtx), 0, 0 });
+      }
+      calcPairMetrics(pairs, false, core);
+      for (auto &p : pairs)
+      {
+        mode7Metrics.set(p.n, p.metricU);
+        vsapi->freeFrame(p.prevt);
+        vsapi->freeFrame(p.nextt);
+      }
+      for (int i : missing)
+        mode7Metrics.wait(i);
+
+      try {
+          int dec = base < 0 ? -20 : mode7Dec.get(base);
+          for (int k = base + 1; k <= last; ++k)
+          {
+            mode7Positions(k, pos);
+            dec = mode7Dec.set(k, mode7Decide(k, dec, pos, chosen));
+          }
+      } catch (const TIVTCError &e) {
+          vsapi->setFilterError(e.what(), frameCtx);
+          return nullptr;
+      }
+      if (last == n)
+        break;
     }
-    else if (chosen == 0) mode2_decA[n] = curr1_f;
-    else mode2_decA[n] = curr2_f;
   }
+  mode7Positions(n, pos);
 
-  int ret = mode2_decA[n];
+  int ret = mode7Dec.get(n);
   if (ret < 0 || ret > nfrms) {
       vsapi->setFilterError("TDecimate:  mode 7 internal error! Tried to request a frame that doesn't exist.", frameCtx);
       return nullptr;
@@ -177,11 +172,13 @@ const VSFrameRef * TDecimate::GetFrameMode7(int n, int activationReason, void **
 
     for (int i = std::max(0, ret - 3); i <= std::min(ret + 3, nfrms); ++i)
     {
-      snprintf(buf, SZ, "%d:  %3.2f  %" PRIu64 "%s%s\n", i, double(metricsOutArray[i << 1])*100.0 / double(MAX_DIFF),
-        metricsOutArray[i << 1], metricsOutArray[i << 1] < same_thresh ? "  (D)" :
-        metricsOutArray[i << 1] > diff_thresh ? "  (N)" :
-        aLUT[i] == 2 ? "  (N)" : aLUT[i] == 1 ? "  (S)" :
-        aLUT[i] == 0 ? "  (D)" : "", wasChosen(i, n) ? "  *" : "");
+      const uint64_t metric = mode7Metrics.get(i);
+      const int type = mode7Analysis.get(i);
+      snprintf(buf, SZ, "%d:  %3.2f  %" PRIu64 "%s%s\n", i, double(metric)*100.0 / double(MAX_DIFF),
+        metric, metric < same_thresh ? "  (D)" :
+        metric > diff_thresh ? "  (N)" :
+        type == 2 ? "  (N)" : type == 1 ? "  (S)" :
+        type == 0 ? "  (D)" : "", wasChosen(i, n) ? "  *" : "");
     text += buf;
     }
 #undef SZ
@@ -194,15 +191,72 @@ const VSFrameRef * TDecimate::GetFrameMode7(int n, int activationReason, void **
   return src;
 }
 
-bool TDecimate::wasChosen(int i, int n)
+bool TDecimate::wasChosen(int i, int n) const
 {
   for (int p = std::max(n - 5, 0); p < std::min(n + 5, nfrmsN); ++p)
   {
-    if (mode2_decA[p] == i) return true;
+    if (mode7Dec.get(p) == i) return true;
   }
   return false;
 }
 
+// previous, the two current and the next input frame of output frame n
+void TDecimate::mode7Positions(int n, int pos[4]) const
+{
+  double ratio = fps / rate;
+  pos[0] = std::max(int(double(n - 1)*ratio + 1.0), 0);
+  pos[1] = int(double(n)*ratio);
+  pos[2] = int(double(n)*ratio + 1.0);
+  pos[3] = std::min(int(double(n + 1)*ratio), nfrms);
+}
+
+// prev_real is the decision for frame n - 1, -20 if unknown
+int TDecimate::mode7Decide(int n, int prev_real, const int pos[4], int &chosen)
+{
+  int prev_f = pos[0];
+  const int curr1_f = pos[1], curr2_f = pos[2], next_f = pos[3];
+  chosen = 0;
+  if (curr1_f > nfrms || curr2_f > nfrms) return nfrms;
+  if (prev_real != -20) prev_f = prev_real;
+  bool rup = double(n) * (fps / rate) - double(curr1_f) >= 0.5 ? true : false;
+
+  if (same_group(curr1_f, curr2_f))
+  {
+    if (next_f - curr2_f > 1 && similar_group(prev_f, curr2_f) &&
+      diff_group(next_f, next_f + 1) && diff_group(curr2_f, curr2_f + 1))
+      chosen = 4;
+    else chosen = 2;
+  }
+  else if (same_group(prev_f, curr1_f)) chosen = 1;
+  else if (similar_group(prev_f, curr1_f))
+  {
+    if (similar_group(curr1_f, curr2_f) && !same_group(curr2_f, next_f))
+      chosen = 3;
+    else if (diff_group(curr1_f, curr2_f))
+      chosen = 1;
+  }
+  else if (diff_group(prev_f, curr1_f))
+  {
+    if (diff_group(curr2_f, next_f)) chosen = 3;
+    else if (diff_group(curr1_f, curr2_f) && same_group(curr1_f - 1, curr1_f) &&
+      same_group(curr2_f, next_f) && diff_group(next_f, next_f + 1) &&
+      curr1_f - prev_f == 2 && diff_group(prev_f - 1, prev_f))
+      chosen = 1;
+  }
+
+  if (chosen == 4) return curr2_f + 1;
+  else if (chosen >= 2) // either
+  {
+    const uint64_t m1 = mode7Metrics.get(curr1_f), m2 = mode7Metrics.get(curr2_f);
+    if ((chosen == 2 && rup) || (chosen == 3 &&
+      ((m2 * 2 > m1 * 3) || (rup && m2 * 3 >= m1 * 2))))
+      return curr2_f;
+    return curr1_f;
+  }
+  else if (chosen == 0) return curr1_f;
+  return curr2_f;
+}
+
 bool TDecimate::same_group(int f1, int f2)
 {
   return diff_f(f1, f2) <= 0;
@@ -227,14 +281,15 @@ int TDecimate::diff_f(int f1, int f2)
   if (f2 > nfrms) f2 = nfrms;
   if (f1 == f2)
   {
-    if (aLUT[f2] == -20)
-      aLUT[f2] = mode7_analysis(f2);
+    if (!mode7Analysis.isSet(f2))
+      mode7Analysis.set(f2, mode7_analysis(f2));
     return 0;
   }
   for (int i = f1 + 1; i <= f2; ++i)
   {
-    if (aLUT[i] == -20) aLUT[i] = mode7_analysis(i);
-    mx = std::max(mx, aLUT[i]);
+    int type = mode7Analysis.get(i);
+    if (type == -20) type = mode7Analysis.set(i, mode7_analysis(i));
+    mx = std::max(mx, type);
   }
   return mx;
 }
@@ -243,9 +298,9 @@ int TDecimate::mode7_analysis(int n) const
 {
   uint64_t vals[3] = { UINT64_MAX, UINT64_MAX, UINT64_MAX };
   if (n == 0) return 2;
-  vals[0] = metricsOutArray[(n - 1) << 1];
-  vals[1] = metricsOutArray[n << 1];
-  if (n != nfrms) vals[2] = metricsOutArray[(n + 1) << 1];
+  vals[0] = mode7Metrics.get(n - 1);
+  vals[1] = mode7Metrics.get(n);
+  if (n != nfrms) vals[2] = mode7Metrics.get(n + 1);
   if (n == nfrms)
   {
     if (vals[0] == UINT64_MAX || vals[1] == UINT64_MAX)
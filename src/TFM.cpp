@@ -40,18 +40,33 @@ const VSFrameRef *TFM::GetFrame(int n, int activationReason, VSFrameContext *fra
   if (n < 0) n = 0;
   else if (n > nfrms) n = nfrms;
 
+  // a trusted d2v film frame only needs the frame its match weaves with,
+  // until its spot check has run it needs everything for both outcomes
+  int trust = d2vTrust(n);
   if (activationReason == arInitial) {
-      vsapi->requestFrameFilter(std::max(0, n - 1), child, frameCtx);
+      if (trust <= 1)
+        vsapi->requestFrameFilter(std::max(0, n - 1), child, frameCtx);
       vsapi->requestFrameFilter(n, child, frameCtx);
-      vsapi->requestFrameFilter(std::min(n + 1, nfrms), child, frameCtx);
+      if (trust <= 0 || trust == 3)
+        vsapi->requestFrameFilter(std::min(n + 1, nfrms), child, frameCtx);
+      if (trust < 0) {
+          const int s = d2vSpotFrame(n);
+          for (int i = std::max(0, s - 1); i <= s + 1 && i < n - 1; ++i)
+            vsapi->requestFrameFilter(i, child, frameCtx);
+      }
       return nullptr;
   } else if (activationReason != arAllFramesReady) {
       return nullptr;
   }
 
-  const VSFrameRef *prv = vsapi->getFrameFilter(std::max(0, n - 1), child, frameCtx);
+  if (trust < 0)
+    trust = d2vSpotCheckCombed(d2vSpotFrame(n), frameCtx, core) ? 0 : d2vtrusted[n];
+
   const VSFrameRef *src = vsapi->getFrameFilter(n, child, frameCtx);
-  const VSFrameRef *nxt = vsapi->getFrameFilter(std::min(n + 1, nfrms), child, frameCtx);
+  const VSFrameRef *prv = trust == 0 || trust == 1 ?
+    vsapi->getFrameFilter(std::max(0, n - 1), child, frameCtx) : vsapi->cloneFrameRef(src);
+  const VSFrameRef *nxt = trust == 0 || trust == 3 ?
+    vsapi->getFrameFilter(std::min(n + 1, nfrms), child, frameCtx) : vsapi->cloneFrameRef(src);
 
   int dfrm = -20, tfrm = -20;
   int mmatch1, nmatch1, nmatch2, mmatch2, fmatch, tmatch;
@@ -96,9 +111,10 @@ const VSFrameRef *TFM::GetFrame(int n, int activationReason, VSFrameContext *fra
 //    OutputDebugString(buf);
 //  }
   if (getMatchOvr(n, fmatch, combed, d2vmatch,
-    flags == 5 ? checkSceneChange(prv, src, nxt, n) : false))
+    flags == 5 && !trust ? checkSceneChange(prv, src, nxt, n) : false))
   {
     createWeaveFrame(dst, prv, src, nxt, fmatch, dfrm);
+    if (trust && PP > 0) combed = 0;
     if (PP > 0 && combed == -1)
     {
       if (checkCombed(dst, n, fmatch, blockN, xblocks, mics, false))
@@ -678,18 +694,13 @@ void TFM::writeDisplay(VSFrameRef *dst, int n, int fmatch, int combed, bool over
 // override from ovr file
 void TFM::getSettingOvr(int n)
 {
-  if (setArray.size() == 0) return;
-  for (int x = 0; x < (int)setArray.size(); x += 4)
-  {
-    if (n >= setArray[x + 1] && n <= setArray[x + 2])
-    {
-      if (setArray[x] == 111) order = setArray[x + 3]; // o
-      else if (setArray[x] == 109) mode = setArray[x + 3]; // m
-      else if (setArray[x] == 102) field = setArray[x + 3]; // f
-      else if (setArray[x] == 80) PP = setArray[x + 3]; // P
-      else if (setArray[x] == 105) MI = setArray[x + 3]; // i
-    }
-  }
+  const int *ovrs = setArray.find(n);
+  if (ovrs == nullptr) return;
+  if (ovrs[0] != SettingOvr::unset) order = ovrs[0]; // o
+  if (ovrs[1] != SettingOvr::unset) mode = ovrs[1]; // m
+  if (ovrs[2] != SettingOvr::unset) field = ovrs[2]; // f
+  if (ovrs[3] != SettingOvr::unset) PP = ovrs[3]; // P
+  if (ovrs[4] != SettingOvr::unset) MI = ovrs[4]; // i
 }
 
 bool TFM::getMatchOvr(int n, int &match, int &combed, bool &d2vmatch, bool isSC)
@@ -781,36 +792,26 @@ bool TFM::d2vduplicate(int match, int combed, int n)
 
 void TFM::fileOut(int match, int combed, bool d2vfilm, int n, int MICount, int mics[5])
 {
-  if (moutArray.size() && MICount != -1) moutArray[n] = MICount;
-  if (micout > 0 && moutArrayE.size())
+  if (!fileOutput) return;
+  if (field != fieldO)
   {
-    int sn = micout == 1 ? 3 : 5;
-    for (int i = 0; i < sn; ++i)
-      moutArrayE[n*sn + i] = mics[i];
-  }
-  if (outArray.size() == 0) return;
-  if (output.size() || outputC.size())
-  {
-    if (field != fieldO)
-    {
-      if (match == 0) match = 3;
-      else if (match == 2) match = 4;
-      else if (match == 3) match = 0;
-      else if (match == 4) match = 2;
-    }
-    if (match == 1 && combed > 1 && field == 0) match = 5;
-    else if (match == 1 && combed > 1 && field == 1) match = 6;
-    unsigned char hint = 0;
-    hint |= match;
-    if (combed > 1) hint |= FILE_COMBED;
-    else if (combed >= 0) hint |= FILE_NOTCOMBED;
-    if (d2vfilm) hint |= FILE_D2V;
-    hint |= FILE_ENTRY;
-    outArray[n] = hint;
+    if (match == 0) match = 3;
+    else if (match == 2) match = 4;
+    else if (match == 3) match = 0;
+    else if (match == 4) match = 2;
   }
+  if (match == 1 && combed > 1 && field == 0) match = 5;
+  else if (match == 1 && combed > 1 && field == 1) match = 6;
+  unsigned char hint = 0;
+  hint |= match;
+  if (combed > 1) hint |= FILE_COMBED;
+  else if (combed >= 0) hint |= FILE_NOTCOMBED;
+  if (d2vfilm) hint |= FILE_D2V;
+  hint |= FILE_ENTRY;
+  const int ordert = order_origSaved == -1 ? order : order_origSaved;
+  fileOutput->add(n, hint, MICount, mics, fieldO^ordert ? 0 : 2);
 }
 
-
 bool TFM::checkCombed(const VSFrameRef *src, int n, int match,
   int *blockN, int &xblocksi, int *mics, bool ddebug)
 {
@@ -2740,24 +2741,18 @@ TFM::TFM(VSNodeRef *_child, int _order, int _field, int _mode, int _PP, const ch
   int _slow, bool _mChroma, int _cNum, int _cthresh, int _MI, bool _chroma, int _blockx,
   int _blocky, int _y0, int _y1, const char* _d2v, int _ovrDefault, int _flags, double _scthresh,
   int _micout, int _micmatching, const char* _trimIn, bool _usehints, int _metric, bool _batch,
-  bool _ubsco, bool _mmsco, int _opt, const VSAPI *_vsapi, VSCore *core)
+  bool _ubsco, bool _mmsco, bool _binary, int _d2vtrust, int _opt, int _segStart, int _segFrames, const VSAPI *_vsapi, VSCore *core)
     : vsapi(_vsapi), child(_child),
   order(_order), field(_field), mode(_mode), PP(_PP), ovr(_ovr), input(_input), output(_output),
   outputC(_outputC), debug(_debug), display(_display), slow(_slow), mChroma(_mChroma), cNum(_cNum),
   cthresh(_cthresh), MI(_MI), chroma(_chroma), blockx(_blockx), blocky(_blocky), y0(_y0),
   y1(_y1), d2v(_d2v), ovrDefault(_ovrDefault), flags(_flags), scthresh(_scthresh), micout(_micout),
   micmatching(_micmatching), trimIn(_trimIn), usehints(_usehints), metric(_metric),
-  batch(_batch), ubsco(_ubsco), mmsco(_mmsco), opt(_opt), cArray(nullptr, nullptr), tbuffer(nullptr, nullptr),
+  batch(_batch), ubsco(_ubsco), mmsco(_mmsco), binary(_binary), d2vtrust(_d2vtrust), opt(_opt), segStart(_segStart), segFrames(_segFrames), cArray(nullptr, nullptr), d2vSpotChecks(false), tbuffer(nullptr, nullptr),
   map(nullptr, nullptr), cmask(nullptr, nullptr)
 {
     vi = vsapi->getVideoInfo(child);
 
-  int z, w, q = 0, b, i, count, last, fieldt, firstLine, qt;
-  int countOvrS, countOvrM;
-  char linein[1024];
-  char *linep, *linet;
-  std::unique_ptr<FILE, decltype (&fclose)> f(nullptr, nullptr);
-
 
   cpuFlags = *getCPUFeatures();
   if (opt == 0) memset(&cpuFlags, 0, sizeof(cpuFlags));
@@ -2810,6 +2805,16 @@ TFM::TFM(VSNodeRef *_child, int _order, int _field, int _mode, int _PP, const ch
     throw TIVTCError("TFM:  metric must be set to 0 or 1!");
   if (scthresh < 0.0 || scthresh > 100.0)
     throw TIVTCError("TFM:  scthresh must be between 0.0 and 100.0 (inclusive)!");
+  if (d2vtrust < 0)
+    throw TIVTCError("TFM:  d2vtrust must be at least 0!");
+  if (segStart < 0)
+    throw TIVTCError("TFM:  segStart must not be negative!");
+  if (segFrames == 0)
+    segFrames = segStart + vi->numFrames;
+  if (segFrames < segStart + vi->numFrames)
+    throw TIVTCError("TFM:  segFrames must be at least segStart plus the number of frames in the clip!");
+  if (segFrames != vi->numFrames && d2v.size())
+    throw TIVTCError("TFM:  segStart and segFrames cannot be used together with d2v!");
 
 //  if (debug)
 //  {
@@ -2913,616 +2918,37 @@ TFM::TFM(VSNodeRef *_child, int _order, int _field, int _mode, int _PP, const ch
   tbuffer = decltype(tbuffer) (vs_aligned_malloc<uint8_t>((vi->height >> 1) * tpitchy, ALIGN_BUF), &vs_aligned_free);
   if (!tbuffer) throw TIVTCError("TFM:  malloc failure (tbuffer)!");
   mode7_field = field;
+  // frame numbers in the files are absolute, so parse them against the
+  // whole clip and keep only the entries of [segStart, segStart + numFrames)
+  nfrms = segFrames - 1;
   if (input.size())
-  {
-    bool d2vmarked, micmarked;
-    if ((f = decltype (f)(tivtc_fopen(input.c_str(), "r"), &fclose)) != nullptr)
-    {
-      ovrArray.resize(vi->numFrames, 255);
-
-      if (d2vfilmarray.size() == 0)
-      {
-        d2vfilmarray.resize(vi->numFrames + 1, 0);
-      }
-      fieldt = fieldO;
-      firstLine = 0;
-//      if (debug)
-//      {
-//        sprintf(buf, "TFM:  successfully opened input file.  Field defaulting to - %s.\n",
-//          fieldt == 0 ? "bottom" : "top");
-//        OutputDebugString(buf);
-//      }
-      while (fgets(linein, 1024, f.get()) != nullptr)
-      {
-        if (linein[0] == 0 || linein[0] == '\n' || linein[0] == '\r' || linein[0] == ';' || linein[0] == '#')
-          continue;
-        ++firstLine;
-        linep = linein;
-        while (*linep != 'f' && *linep != 'F' && *linep != 0 && *linep != ' ' && *linep != 'c') linep++;
-        if (*linep == 'f' || *linep == 'F')
-        {
-          if (firstLine == 1)
-          {
-            bool changed = false;
-            if (_strnicmp(linein, "field = top", 11) == 0) { fieldt = 1; changed = true; }
-            else if (_strnicmp(linein, "field = bottom", 14) == 0) { fieldt = 0; changed = true; }
-//            if (debug && changed)
-//            {
-//              sprintf(buf, "TFM:  detected field for input file - %s.\n",
-//                fieldt == 0 ? "bottom" : "top");
-//              OutputDebugString(buf);
-//            }
-          }
-        }
-        else if (*linep == 'c')
-        {
-          if (_strnicmp(linein, "crc32 = ", 8) == 0)
-          {
-            linet = linein;
-            while (*linet != ' ') linet++;
-            linet++;
-            while (*linet != ' ') linet++;
-            linet++;
-            unsigned int m, tempCrc;
-            sscanf(linet, "%x", &m);
-            calcCRC(child, 15, tempCrc, vsapi);
-            if (tempCrc != m && !batch)
-            {
-              throw TIVTCError("TFM:  crc32 in input file does not match that of the current clip!");
-            }
-          }
-        }
-        else if (*linep == ' ')
-        {
-          linet = linein;
-          while (*linet != 0)
-          {
-            if (*linet != ' ' && *linet != 10) break;
-            linet++;
-          }
-          if (*linet == 0) { --firstLine; continue; }
-          sscanf(linein, "%d", &z);
-          linep = linein;
-          while (*linep != 'p' && *linep != 'c' && *linep != 'n' && *linep != 'u' &&
-            *linep != 'b' && *linep != 'l' && *linep != 'h' && *linep != 0) linep++;
-          if (*linep != 0)
-          {
-            if (z<0 || z>nfrms)
-            {
-              throw TIVTCError("TFM:  input file error (out of range or non-ascending frame #)!");
-            }
-            linep = linein;
-            while (*linep != ' ' && *linep != 0) linep++;
-            if (*linep != 0)
-            {
-              qt = -1;
-              d2vmarked = micmarked = false;
-              linep++;
-              q = *linep;
-              if (q == 112) q = 0;
-              else if (q == 99) q = 1;
-              else if (q == 110) q = 2;
-              else if (q == 98) q = 3;
-              else if (q == 117) q = 4;
-              else if (q == 108) q = 5;
-              else if (q == 104) q = 6;
-              else
-              {
-                throw TIVTCError("TFM:  input file error (invalid match specifier)!");
-              }
-              linep++;
-              linep++;
-              if (*linep != 0)
-              {
-                qt = *linep;
-                if (qt == 45) qt = 0;
-                else if (qt == 43) qt = COMBED;
-                else if (qt == '1') { d2vmarked = true; qt = -1; }
-                else if (qt == '[') { micmarked = true; qt = -1; }
-                else
-                {
-                  throw TIVTCError("TFM:  input file error (invalid specifier)!");
-                }
-              }
-              if (fieldt != fieldO)
-              {
-                if (q == 0) q = 3;
-                else if (q == 2) q = 4;
-                else if (q == 3) q = 0;
-                else if (q == 4) q = 2;
-              }
-              if (!d2vmarked && !micmarked && qt != -1)
-              {
-                linep++;
-                linep++;
-                if (*linep == '1') d2vmarked = true;
-                else if (*linep == '[') micmarked = true;
-              }
-              if (d2vmarked)
-              {
-                d2vfilmarray[z] &= ~0x03;
-                d2vfilmarray[z] |= fieldt == 1 ? 0x3 : 0x1;
-                if (!micmarked)
-                {
-                  linep++;
-                  linep++;
-                  if (*linep == '[') micmarked = true;
-                }
-              }
-              if (micmarked)
-              {
-                // add mic input handling in the future
-              }
-              ovrArray[z] |= 0x07;
-              ovrArray[z] &= (q | 0xF8);
-              if (qt != -1)
-              {
-                ovrArray[z] &= 0xDF;
-                ovrArray[z] |= 0x10;
-                ovrArray[z] &= (qt | 0xEF);
-              }
-            }
-          }
-        }
-      }
-    }
-    else throw TIVTCError("TFM:  input file error (could not open file)!");
-  }
+    parseInputFile();
   if (ovr.size())
+    parseOvrFile();
+  nfrms = vi->numFrames - 1;
+  if (segFrames != vi->numFrames)
   {
-    if ((f = decltype (f)(tivtc_fopen(ovr.c_str(), "r"), &fclose)) != nullptr)
+    if (ovrArray.size())
     {
-      countOvrS = countOvrM = 0;
-      while (fgets(linein, 1024, f.get()) != nullptr)
-      {
-        if (linein[0] == 0 || linein[0] == '\n' || linein[0] == '\r' || linein[0] == ';' || linein[0] == '#')
-          continue;
-        linep = linein;
-        while (*linep != 'c' && *linep != 'p' && *linep != 'n' && *linep != 'b' &&
-          *linep != 'u' && *linep != 'l' && *linep != 'h' && *linep != '+' && *linep != '-' && *linep != 0) linep++;
-        if (*linep == 0) ++countOvrS;
-        else ++countOvrM;
-      }
-      if (ovrDefault != 0 && ovrArray.size())
-      {
-        if (ovrDefault == 1) q = 0;
-        else if (ovrDefault == 2) q = COMBED;
-        for (int h = 0; h < vi->numFrames; ++h)
-        {
-          ovrArray[h] &= 0xDF;
-          ovrArray[h] |= 0x10;
-          ovrArray[h] &= (q | 0xEF);
-          if (q == 0 && ((ovrArray[h] & 7) == 6 ||
-            (ovrArray[h] & 7) == 5))
-          {
-            ovrArray[h] |= 0x07;
-            ovrArray[h] &= (1 | 0xF8);
-          }
-        }
-      }
-      if (countOvrS == 0 && countOvrM == 0) { goto emptyovr; }
-      if (countOvrS > 0)
-      {
-        ++countOvrS;
-        countOvrS *= 4;
-        setArray.resize(countOvrS, 0xffffffff);
-      }
-      if (countOvrM > 0 && ovrArray.size() == 0)
-      {
-        ovrArray.resize(vi->numFrames, 255);
-        if (ovrDefault != 0)
-        {
-          if (ovrDefault == 1) q = 0;
-          else if (ovrDefault == 2) q = COMBED;
-          for (int h = 0; h < vi->numFrames; ++h)
-          {
-            ovrArray[h] &= 0xDF;
-            ovrArray[h] |= 0x10;
-            ovrArray[h] &= (q | 0xEF);
-          }
-        }
-      }
-      last = -1;
-      fieldt = fieldO;
-      firstLine = 0;
-      i = 0;
-      if ((f = decltype (f)(tivtc_fopen(ovr.c_str(), "r"), &fclose)) != nullptr)
-      {
-//        if (debug)
-//        {
-//          sprintf(buf, "TFM:  successfully opened ovr file.  Field defaulting to - %s.\n",
-//            fieldt == 0 ? "bottom" : "top");
-//          OutputDebugString(buf);
-//        }
-        while (fgets(linein, 1024, f.get()) != nullptr)
-        {
-          if (linein[0] == 0 || linein[0] == '\n' || linein[0] == '\r' || linein[0] == ';' || linein[0] == '#')
-            continue;
-          ++firstLine;
-          linep = linein;
-          while (*linep != 'f' && *linep != 'F' && *linep != 0 && *linep != ' ' && *linep != ',') linep++;
-          if (*linep == 'f' || *linep == 'F')
-          {
-            if (firstLine == 1)
-            {
-              bool changed = false;
-              if (_strnicmp(linein, "field = top", 11) == 0) { fieldt = 1; changed = true; }
-              else if (_strnicmp(linein, "field = bottom", 14) == 0) { fieldt = 0; changed = true; }
-//              if (debug && changed)
-//              {
-//                sprintf(buf, "TFM:  detected field for ovr file - %s.\n",
-//                  fieldt == 0 ? "bottom" : "top");
-//                OutputDebugString(buf);
-//              }
-            }
-          }
-          else if (*linep == ' ')
-          {
-            linet = linein;
-            while (*linet != 0)
-            {
-              if (*linet != ' ' && *linet != 10) break;
-              linet++;
-            }
-            if (*linet == 0) { --firstLine; continue; }
-            linep++;
-            if (*linep == 'p' || *linep == 'c' || *linep == 'n' || *linep == 'b' || *linep == 'u' || *linep == 'l' || *linep == 'h')
-            {
-              sscanf(linein, "%d", &z);
-              if (z<0 || z>nfrms || z <= last)
-              {
-                throw TIVTCError("TFM:  ovr file error (out of range or non-ascending frame #)!");
-              }
-              linep = linein;
-              while (*linep != ' ' && *linep != 0) linep++;
-              if (*linep != 0)
-              {
-                linep++;
-                q = *linep;
-                if (q == 112) q = 0;
-                else if (q == 99) q = 1;
-                else if (q == 110) q = 2;
-                else if (q == 98) q = 3;
-                else if (q == 117) q = 4;
-                else if (q == 108) q = 5;
-                else if (q == 104) q = 6;
-                else
-                {
-                  throw TIVTCError("TFM:  ovr file error (invalid match specifier)!");
-                }
-                if (fieldt != fieldO)
-                {
-                  if (q == 0) q = 3;
-                  else if (q == 2) q = 4;
-                  else if (q == 3) q = 0;
-                  else if (q == 4) q = 2;
-                }
-                ovrArray[z] |= 0x07;
-                ovrArray[z] &= (q | 0xF8);
-                last = z;
-              }
-            }
-            else if (*linep == '-' || *linep == '+')
-            {
-              sscanf(linein, "%d", &z);
-              if (z<0 || z>nfrms)
-              {
-                throw TIVTCError("TFM:  ovr file error (out of range or non-ascending frame #)!");
-              }
-              linep = linein;
-              while (*linep != ' ' && *linep != 0) linep++;
-              if (*linep != 0)
-              {
-                linep++;
-                q = *linep;
-                if (q == 45) q = 0;
-                else if (q == 43) q = COMBED;
-                else
-                {
-                  throw TIVTCError("TFM:  ovr file error (invalid symbol)!");
-                }
-                ovrArray[z] &= 0xDF;
-                ovrArray[z] |= 0x10;
-                ovrArray[z] &= (q | 0xEF);
-                if (q == 0 && ((ovrArray[z] & 7) == 6 ||
-                  (ovrArray[z] & 7) == 5))
-                {
-                  ovrArray[z] |= 0x07;
-                  ovrArray[z] &= (1 | 0xF8);
-                }
-              }
-            }
-            else
-            {
-              sscanf(linein, "%d", &z);
-              if (z<0 || z>nfrms)
-              {
-                throw TIVTCError("TFM:  ovr input error (out of range frame #)!");
-              }
-              linep = linein;
-              while (*linep != ' ' && *linep != 0) linep++;
-              if (*linep != 0)
-              {
-                linep++;
-                if (*linep == 'f' || *linep == 'm' || *linep == 'o' || *linep == 'P' || *linep == 'i')
-                {
-                  q = *linep;
-                  linep++;
-                  linep++;
-                  if (*linep == 0) continue;
-                  sscanf(linep, "%d", &b);
-                  if (q == 102 && b != 0 && b != 1 && b != -1)
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad field value)!");
-                  }
-                  else if (q == 111 && b != 0 && b != 1 && b != -1)
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad order value)!");
-                  }
-                  else if (q == 109 && (b < 0 || b > 7))
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad mode value)!");
-                  }
-                  else if (q == 80 && (b < 0 || b > 7))
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad PP value)!");
-                  }
-                  setArray[i] = q; ++i;
-                  setArray[i] = z; ++i;
-                  setArray[i] = z; ++i;
-                  setArray[i] = b; ++i;
-                }
-              }
-            }
-          }
-          else if (*linep == ',')
-          {
-            while (*linep != ' ' && *linep != 0) linep++;
-            if (*linep == 0) continue;
-            linep++;
-            if (*linep == 'p' || *linep == 'c' || *linep == 'n' || *linep == 'u' || *linep == 'b' || *linep == 'l' || *linep == 'h')
-            {
-              sscanf(linein, "%d,%d", &z, &w);
-              if (w == 0) w = nfrms;
-              if (z<0 || z>nfrms || w<0 || w>nfrms || w < z || z <= last)
-              {
-                throw TIVTCError("TFM:  input file error (out of range or non-ascending frame #)!");
-              }
-              linep = linein;
-              while (*linep != ' ' && *linep != 0) linep++;
-              if (*linep != 0)
-              {
-                linep++;
-                if (*(linep + 1) == 'p' || *(linep + 1) == 'c' || *(linep + 1) == 'n' || *(linep + 1) == 'b' || *(linep + 1) == 'u' || *(linep + 1) == 'l' || *(linep + 1) == 'h')
-                {
-                  count = 0;
-                  while ((*linep == 'p' || *linep == 'c' || *linep == 'n' || *linep == 'b' || *linep == 'u' || *linep == 'l' || *linep == 'h') && (z + count <= w))
-                  {
-                    q = *linep;
-                    if (q == 112) q = 0;
-                    else if (q == 99) q = 1;
-                    else if (q == 110) q = 2;
-                    else if (q == 98) q = 3;
-                    else if (q == 117) q = 4;
-                    else if (q == 108) q = 5;
-                    else if (q == 104) q = 6;
-                    else
-                    {
-                      throw TIVTCError("TFM:  input file error (invalid match specifier)!");
-                    }
-                    if (fieldt != fieldO)
-                    {
-                      if (q == 0) q = 3;
-                      else if (q == 2) q = 4;
-                      else if (q == 3) q = 0;
-                      else if (q == 4) q = 2;
-                    }
-                    ovrArray[z + count] |= 0x07;
-                    ovrArray[z + count] &= (q | 0xF8);
-                    ++count;
-                    linep++;
-                  }
-                  while (z + count <= w)
-                  {
-                    ovrArray[z + count] |= 0x07;
-                    ovrArray[z + count] &= (ovrArray[z] | 0xF8);
-                    ++z;
-                  }
-                  last = w;
-                }
-                else
-                {
-                  q = *linep;
-                  if (q == 112) q = 0;
-                  else if (q == 99) q = 1;
-                  else if (q == 110) q = 2;
-                  else if (q == 98) q = 3;
-                  else if (q == 117) q = 4;
-                  else if (q == 108) q = 5;
-                  else if (q == 104) q = 6;
-                  else
-                  {
-                    throw TIVTCError("TFM:  input file error (invalid match specifier)!");
-                  }
-                  if (fieldt != fieldO)
-                  {
-                    if (q == 0) q = 3;
-                    else if (q == 2) q = 4;
-                    else if (q == 3) q = 0;
-                    else if (q == 4) q = 2;
-                  }
-                  while (z <= w)
-                  {
-                    ovrArray[z] |= 0x07;
-                    ovrArray[z] &= (q | 0xF8);
-                    ++z;
-                  }
-                  last = w;
-                }
-              }
-            }
-            else if (*linep == '-' || *linep == '+')
-            {
-              sscanf(linein, "%d,%d", &z, &w);
-              if (w == 0) w = nfrms;
-              if (z<0 || z>nfrms || w<0 || w>nfrms || w < z)
-              {
-                throw TIVTCError("TFM:  input file error (out of range or non-ascending frame #)!");
-              }
-              linep = linein;
-              while (*linep != ' ' && *linep != 0) linep++;
-              if (*linep != 0)
-              {
-                linep++;
-                if (*(linep + 1) == '-' || *(linep + 1) == '+')
-                {
-                  count = 0;
-                  while ((*linep == '-' || *linep == '+') && (z + count <= w))
-                  {
-                    q = *linep;
-                    if (q == 45) q = 0;
-                    else if (q == 43) q = COMBED;
-                    else
-                    {
-                      throw TIVTCError("TFM:  input file error (invalid symbol)!");
-                    }
-                    ovrArray[z + count] &= 0xDF;
-                    ovrArray[z + count] |= 0x10;
-                    ovrArray[z + count] &= (q | 0xEF);
-                    if (q == 0 && ((ovrArray[z + count] & 7) == 6 ||
-                      (ovrArray[z + count] & 7) == 5))
-                    {
-                      ovrArray[z + count] |= 0x07;
-                      ovrArray[z + count] &= (1 | 0xF8);
-                    }
-                    ++count;
-                    linep++;
-                  }
-                  while (z + count <= w)
-                  {
-                    ovrArray[z + count] &= 0xDF;
-                    ovrArray[z + count] |= 0x10;
-                    ovrArray[z + count] &= (ovrArray[z] | 0xEF);
-                    if ((ovrArray[z] & 0x10) == 0 && ((ovrArray[z + count] & 7) == 6 ||
-                      (ovrArray[z + count] & 7) == 5))
-                    {
-                      ovrArray[z + count] |= 0x07;
-                      ovrArray[z + count] &= (1 | 0xF8);
-                    }
-                    ++z;
-                  }
-                }
-                else
-                {
-                  q = *linep;
-                  if (q == 45) q = 0;
-                  else if (q == 43) q = COMBED;
-                  else
-                  {
-                    throw TIVTCError("TFM:  input file error (invalid symbol)!");
-                  }
-                  while (z <= w)
-                  {
-                    ovrArray[z] &= 0xDF;
-                    ovrArray[z] |= 0x10;
-                    ovrArray[z] &= (q | 0xEF);
-                    if (q == 0 && ((ovrArray[z] & 7) == 6 ||
-                      (ovrArray[z] & 7) == 5))
-                    {
-                      ovrArray[z] |= 0x07;
-                      ovrArray[z] &= (1 | 0xF8);
-                    }
-                    ++z;
-                  }
-                }
-              }
-            }
-            else
-            {
-              sscanf(linein, "%d,%d", &z, &w);
-              if (w == 0) w = nfrms;
-              if (z<0 || z>nfrms || w<0 || w>nfrms || w < z)
-              {
-                throw TIVTCError("TFM: ovr input error (invalid frame range)!");
-              }
-              linep = linein;
-              while (*linep != ' ' && *linep != 0) linep++;
-              if (*linep != 0)
-              {
-                linep++;
-                if (*linep == 'f' || *linep == 'm' || *linep == 'o' || *linep == 'P' || *linep == 'i')
-                {
-                  q = *linep;
-                  linep++;
-                  linep++;
-                  if (*linep == 0) continue;
-                  sscanf(linep, "%d", &b);
-                  if (q == 102 && b != 0 && b != 1 && b != -1)
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad field value)!");
-                  }
-                  else if (q == 111 && b != 0 && b != 1 && b != -1)
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad order value)!");
-                  }
-                  else if (q == 109 && (b < 0 || b > 7))
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad mode value)!");
-                  }
-                  else if (q == 80 && (b < 0 || b > 7))
-                  {
-                    throw TIVTCError("TFM:  ovr input error (bad PP value)!");
-                  }
-                  setArray[i] = q; ++i;
-                  setArray[i] = z; ++i;
-                  setArray[i] = w; ++i;
-                  setArray[i] = b; ++i;
-                }
-              }
-            }
-          }
-        }
-      }
-      else {
-          throw TIVTCError("TFM:  ovr file error (could not open file)!");
-      }
-    }
-    else {
-        throw TIVTCError("TFM:  ovr input error (could not open ovr file)!");
+      ovrArray.erase(ovrArray.begin(), ovrArray.begin() + segStart);
+      ovrArray.resize(vi->numFrames);
     }
-  }
-emptyovr:
-  if (output.size())
-  {
-    if ((f = decltype (f)(tivtc_fopen(output.c_str(), "w"), &fclose)) != nullptr)
+    if (d2vfilmarray.size())
     {
-      _fullpath(outputFull, output.c_str(), MAX_PATH);
-      calcCRC(child, 15, outputCrc, vsapi);
-      outArray.resize(vi->numFrames, 0);
-      moutArray.resize(vi->numFrames, -1);
-      if (micout > 0)
-      {
-        int sn = micout == 1 ? 3 : 5;
-        moutArrayE.resize(vi->numFrames * sn, -20);
-      }
-    }
-    else {
-        throw TIVTCError("TFM:  output file error (cannot create file)!");
+      d2vfilmarray.erase(d2vfilmarray.begin(), d2vfilmarray.begin() + segStart);
+      d2vfilmarray.resize(vi->numFrames + 1);
     }
+    setArray.shift(segStart);
   }
-  if (outputC.size())
+  if (d2vtrust > 0)
+    D2V_build_trust();
+  if (output.size() || outputC.size())
   {
-    if ((f = decltype (f)(tivtc_fopen(outputC.c_str(), "w"), &fclose)) != nullptr)
-    {
-      _fullpath(outputCFull, outputC.c_str(), MAX_PATH);
-      if (outArray.size() == 0)
-      {
-        outArray.resize(vi->numFrames, 0);
-      }
-    }
-    else {
-        throw TIVTCError("TFM:  outputC file error (cannot create file)!");
-    }
+    outputCrc = 0;
+    if (output.size())
+      calcCRC(child, 15, outputCrc, vsapi);
+    fileOutput.reset(new TFMOutput(output.c_str(), outputC.c_str(), vi->numFrames, fieldO,
+      outputCrc, micout, cNum, PP_origSaved, MI_origSaved, binary));
   }
   /// attach the value of PP to the first frame? TDecimate uses this to do something in the constructor while processing the tfmIn file.
   ///
@@ -3533,207 +2959,7 @@ emptyovr:
 
 TFM::~TFM()
 {
-  if (outArray.size())
-  {
-    FILE *f = nullptr;
-    if (output.size())
-    {
-      if ((f = tivtc_fopen(outputFull, "w")) != nullptr)
-      {
-        char tempBuf[40], tb2[40];
-        int match, sn = micout == 1 ? 3 : 5;
-        if (moutArrayE.size())
-        {
-          for (int i = 0; i < sn * vi->numFrames; ++i)
-          {
-            if (moutArrayE[i] == -20) moutArrayE[i] = -1;
-          }
-        }
-        fprintf(f, "#TFM %s by tritical\n", VERSION);
-        fprintf(f, "field = %s\n", fieldO == 1 ? "top" : "bottom");
-        fprintf(f, "crc32 = %x\n", outputCrc);
-        for (int h = 0; h <= nfrms; ++h)
-        {
-          if (outArray[h] & FILE_ENTRY)
-          {
-            match = (outArray[h] & 0x07);
-            sprintf(tempBuf, "%d %c", h, MTC(match));
-            if (outArray[h] & 0x20)
-            {
-              if (outArray[h] & 0x10) strcat(tempBuf, " +");
-              else strcat(tempBuf, " -");
-            }
-            if (outArray[h] & FILE_D2V) strcat(tempBuf, " 1");
-            if (moutArray.size() && moutArray[h] != -1)
-            {
-              sprintf(tb2, " [%d]", moutArray[h]);
-              strcat(tempBuf, tb2);
-            }
-            if (moutArrayE.size())
-            {
-              int th = h*sn;
-              if (sn == 3) sprintf(tb2, " (%d %d %d)", moutArrayE[th + 0],
-                moutArrayE[th + 1], moutArrayE[th + 2]);
-              else sprintf(tb2, " (%d %d %d %d %d)", moutArrayE[th + 0],
-                moutArrayE[th + 1], moutArrayE[th + 2], moutArrayE[th + 3],
-                moutArrayE[th + 4]);
-              strcat(tempBuf, tb2);
-            }
-            strcat(tempBuf, "\n");
-            fprintf(f, "%s", tempBuf);
-          }
-        }
-        generateOvrHelpOutput(f);
-        fclose(f);
-        f = nullptr;
-      }
-    }
-    if (outputC.size())
-    {
-      if ((f = tivtc_fopen(outputCFull, "w")) != nullptr)
-      {
-        int count = 0, match;
-        fprintf(f, "#TFM %s by tritical\n", VERSION);
-        for (int h = 0; h <= nfrms; ++h)
-        {
-          if (outArray[h] & FILE_ENTRY) match = (outArray[h] & 0x07);
-          else match = 0;
-          if (match == 1 || match == 5 || match == 6) ++count;
-          else
-          {
-            if (count > cNum) fprintf(f, "%d,%d\n", h - count, h - 1);
-            count = 0;
-          }
-        }
-        if (count > cNum) fprintf(f, "%d,%d\n", nfrms - count + 1, nfrms);
-        fclose(f);
-        f = nullptr;
-      }
-    }
-    if (f != nullptr) fclose(f);
-  }
+  fileOutput.reset();
 
   vsapi->freeNode(child);
 }
-
-void TFM::generateOvrHelpOutput(FILE *f) const
-{
-  int ccount = 0, mcount = 0, acount = 0;
-  int ordert = /*order == -1 ? child->GetParity(0) :*/ order; /// can order be -1 at this point? I think not, but test it
-  int ao = fieldO^ordert ? 0 : 2;
-  for (int i = 0; i < vi->numFrames; ++i)
-  {
-    if (!(outArray[i] & FILE_ENTRY)) return;
-    const int temp = outArray[i] & 0x07;
-    if (temp == 3 || temp == 4 || temp == ao) ++acount;
-    if (moutArray[i] != -1) ++mcount;
-    if ((outArray[i] & 0x30) == 0x30) ++ccount;
-  }
-  fprintf(f, "#\n#\n# OVR HELP INFORMATION:\n#\n");
-  fprintf(f, "# [COMBED FRAMES]\n#\n");
-  fprintf(f, "#   [Individual Frames]\n");
-  fprintf(f, "#   FORMAT:  frame_number (mic_value)\n#\n");
-  if (PP == 0) fprintf(f, "#   none detected (PP=0)\n");
-  else if (ccount)
-  {
-    for (int i = 0; i < vi->numFrames; ++i)
-    {
-      if ((outArray[i] & 0x30) == 0x30)
-      {
-        if (moutArray[i] < 0) fprintf(f, "#   %d\n", i);
-        else fprintf(f, "#   %d (%d)\n", i, moutArray[i]);
-      }
-    }
-  }
-  else fprintf(f, "#   none detected\n");
-  fprintf(f, "#\n#   [Grouped Ranges Allowing Small Breaks]\n");
-  fprintf(f, "#   FORMAT:  frame_start, frame_end (percentage combed)\n#\n");
-  if (PP == 0) fprintf(f, "#   none detected (PP=0)\n");
-  else if (ccount)
-  {
-    int icount = 0, pcount = 0, rcount = 0, i = 0;
-    for (; i < vi->numFrames; ++i)
-    {
-      if ((outArray[i] & 0x30) == 0x30)
-      {
-        ++icount;
-        ++rcount;
-        pcount = 0;
-      }
-      else
-      {
-        ++pcount;
-        if (rcount > 0) ++rcount;
-        if (pcount > 12)
-        {
-          if (icount > 1)
-            fprintf(f, "#   %d,%d (%3.1f%c)\n", i - rcount + 1, i - pcount,
-              icount*100.0 / double(rcount - pcount), '%');
-          rcount = icount = 0;
-        }
-      }
-    }
-    if (icount > 1)
-      fprintf(f, "#   %d,%d (%3.1f%c)\n", i - rcount, i - pcount,
-        icount*100.0 / double(rcount - pcount), '%');
-  }
-  else fprintf(f, "#   none detected\n");
-  fprintf(f, "#\n#\n# [POSSIBLE MISSED COMBED FRAMES]\n#\n");
-  fprintf(f, "#   FORMAT:  frame_number (mic_value)\n#\n");
-  if (PP == 0) fprintf(f, "#   none detected (PP=0)\n");
-  else if (mcount)
-  {
-    int maxcp = int(MI*0.85), count = 0;
-    int mt = std::max(int(MI*0.1875), 5);
-    for (int i = 0; i < vi->numFrames; ++i)
-    {
-      if ((outArray[i] & 0x30) == 0x30)
-        continue;
-      const int prev = i > 0 ? moutArray[i - 1] : 0;
-      const int curr = moutArray[i];
-      const int next = i < vi->numFrames - 1 ? moutArray[i + 1] : 0;
-      if (curr <= MI && ((curr >= mt && curr > next * 2 && curr > prev * 2 &&
-        curr - next > mt && curr - prev > mt) || (curr > maxcp) ||
-        (prev > MI && next > MI && curr > MI*0.5) ||
-        ((prev > MI || next > MI) && curr > MI*0.75)))
-      {
-        fprintf(f, "#   %d (%d)\n", i, moutArray[i]);
-        ++count;
-      }
-    }
-    if (!count) fprintf(f, "#   none detected\n");
-  }
-  else fprintf(f, "#   none detected\n");
-  fprintf(f, "#\n#\n# [u, b, AND AGAINST ORDER (%c) MATCHES]\n#\n", MTC(ao));
-  fprintf(f, "#   FORMAT:  frame_number match  or  range_start,range_end match\n#\n");
-  if (acount)
-  {
-    int lastf = -1, count = 0, i = 0;
-    for (; i < vi->numFrames; ++i)
-    {
-      const int temp = outArray[i] & 0x07;
-      if (temp == 3 || temp == 4 || temp == ao)
-      {
-        if (lastf == -1) lastf = temp;
-        else if (temp != lastf)
-        {
-          if (count == 1) fprintf(f, "#   %d %c\n", i - 1, MTC(lastf));
-          else fprintf(f, "#   %d,%d %c\n", i - count, i - 1, MTC(lastf));
-          count = 0;
-          lastf = temp;
-        }
-        ++count;
-      }
-      else if (count)
-      {
-        if (count == 1) fprintf(f, "#   %d %c\n", i - 1, MTC(lastf));
-        else fprintf(f, "#   %d,%d %c\n", i - count, i - 1, MTC(lastf));
-        count = 0;
-        lastf = -1;
-      }
-    }
-    if (count == 1) fprintf(f, "#   %d %c\n", i - 1, MTC(lastf));
-    else if (count > 1) fprintf(f, "#   %d,%d %c\n", i - count, i - 1, MTC(lastf));
-  }
-  else fprintf(f, "#   none detected\n");
-}
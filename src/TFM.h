@@ -47,7 +47,10 @@
 #include <VapourSynth.h>
 #include <VSHelper.h>
 #include "calcCRC.h"
+#include "FrameTables.h"
 #include "internal.h"
+#include "SettingOvr.h"
+#include "TFMOutput.h"
 #include "cpufeatures.h"
 
 
@@ -100,8 +103,11 @@ private:
   std::string trimIn;
   bool usehints;
   bool metric;
-  bool batch, ubsco, mmsco;
+  bool batch, ubsco, mmsco, binary;
+  int d2vtrust;
   int opt;
+  int segStart; // absolute frame of the first frame, for input/ovr files of the whole clip
+  int segFrames; // length of that whole clip
 
   int PP_origSaved, MI_origSaved;
   int order_origSaved, field_origSaved, mode_origSaved;
@@ -112,25 +118,30 @@ private:
   unsigned long diffmaxsc;
   
   std::unique_ptr<int, decltype (&vs_aligned_free)> cArray; // modified in GetFrame
-  std::vector<int> setArray;
+  SettingOvr setArray{ "omfPi" }; // o, m, f, P, i lines from the ovr file
 
   std::vector<bool> trimArray;
 
   double d2vpercent;
   
   std::vector<uint8_t> ovrArray;
-  std::vector<uint8_t> outArray; // modified in GetFrame, but only the element corresponding to frame n, so multithreaded access is fine
   std::vector<uint8_t> d2vfilmarray;
+  // per frame neighbour needed by a trusted d2v film match (0 = not trusted,
+  // 1 = prv, 2 = none, 3 = nxt), fixed when the filter is created
+  std::vector<uint8_t> d2vtrusted;
+  // with flags 4/5 and PP > 0 the d2v match of each spot check frame is
+  // checked for combing the first time a frame that depends on it is
+  // requested, 1 = combed, the frames that depend on it are not trusted
+  bool d2vSpotChecks;
+  OnceSlots<int8_t> d2vSpotCombed;
 
   std::unique_ptr<uint8_t, decltype (&vs_aligned_free)> tbuffer; // absdiff buffer // modified in GetFrame
   int tpitchy, tpitchuv;
 
-  std::vector<int> moutArray; // modified in GetFrame, but only the element corresponding to frame n
-  std::vector<int> moutArrayE; // modified in GetFrame, but only the elements corresponding to frame n
+  std::unique_ptr<TFMOutput> fileOutput; // output/outputC writer, fed from GetFrame
   
   MTRACK lastMatch; // modified in GetFrame
   SCTRACK sclast;  // modified in GetFrame
-  char outputFull[MAX_PATH], outputCFull[MAX_PATH];
   std::unique_ptr<VSFrameRef, decltype (VSAPI::freeFrame)> map; // modified in GetFrame
   std::unique_ptr<VSFrameRef, decltype (VSAPI::freeFrame)> cmask; // modified in GetFrame
 
@@ -169,6 +180,10 @@ private:
   
   bool getMatchOvr(int n, int &match, int &combed, bool &d2vmatch, bool isSC);
   void getSettingOvr(int n);
+  void parseInputFile();
+  void parseOvrFile();
+  void setOvrMatch(int n, int q);
+  void setOvrCombed(int n, int q);
   
   bool checkCombed(const VSFrameRef *src, int n, int match,
     int *blockN, int &xblocksi, int *mics, bool ddebug);
@@ -197,6 +212,10 @@ private:
   int D2V_write_array(const std::vector<int> &array, char wfile[]) const;
   int D2V_get_output_filename(char wfile[]) const;
   int D2V_fill_d2vfilmarray(const std::vector<int> &array, int frames);
+  void D2V_build_trust();
+  int d2vSpotFrame(int n) const;
+  int d2vTrust(int n) const;
+  bool d2vSpotCheckCombed(int n, VSFrameContext *frameCtx, VSCore *core);
   bool d2vduplicate(int match, int combed, int n);
   bool checkD2VCase(int check) const;
   bool checkInPatternD2V(const std::vector<int> &array, int i) const;
@@ -220,8 +239,6 @@ private:
   void buildABSDiffMask(const uint8_t *prvp, const uint8_t *nxtp,
     int prv_pitch, int nxt_pitch, int tpitch, int width, int height) const;
 
-  void generateOvrHelpOutput(FILE *f) const;
-
 public:
       const VSVideoInfo *vi;
 
@@ -233,7 +250,7 @@ public:
     bool _mChroma, int _cNum, int _cthresh, int _MI, bool _chroma, int _blockx, int _blocky,
     int _y0, int _y1, const char* _d2v, int _ovrDefault, int _flags, double _scthresh, int _micout,
     int _micmatching, const char* _trimIn, bool _usehints, int _metric, bool _batch, bool _ubsco,
-    bool _mmsco, int _opt, const VSAPI *_vsapi, VSCore *core);
+    bool _mmsco, bool _binary, int _d2vtrust, int _opt, int _segStart, int _segFrames, const VSAPI *_vsapi, VSCore *core);
   ~TFM();
 
 //  int __stdcall SetCacheHints(int cachehints, int frame_range) override {
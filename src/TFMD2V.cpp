@@ -23,9 +23,13 @@
 **   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <algorithm>
 #include <cstring>
+#include <functional>
 #include <memory>
+#include <thread>
 #include "TFM.h"
+#include "MappedFile.h"
 
 void TFM::parseD2V()
 {
@@ -168,6 +172,32 @@ int TFM::D2V_find_and_correct(std::vector<int> &array, bool &found, int &tff) co
 {
   found = false;
   tff = -1;
+  // One pass for the field order, illegal transitions and ignored rffs.
+  // Only a d2v with illegal transitions needs the correcting loop below.
+  if (array[0] != 9 && array[1] != 9) tff = array[0] < 2 ? 0 : 1;
+  int i = 1, top = array[0] == 3 ? 1 : 0, bot = array[0] == 1 ? 1 : 0, rff = 0;
+  while (array[i] != 9)
+  {
+    if (D2V_check_illegal(array[i - 1], array[i])) break;
+    if (top)
+    {
+      if (array[i] == 1) top = bot = 0;
+      else if (array[i] == 3) rff = 2;
+    }
+    else if (bot)
+    {
+      if (array[i] == 3) top = bot = 0;
+      else if (array[i] == 1) rff = 2;
+    }
+    else
+    {
+      if (array[i] == 3) top = 1;
+      else if (array[i] == 1) bot = 1;
+    }
+    ++i;
+  }
+  if (array[i] == 9) return rff;
+
   int count = 1, sync = 0, f1, f2, fix, temp, change;
   while (array[count] != 9)
   {
@@ -295,87 +325,150 @@ int TFM::D2V_check_final(const std::vector<int> &array) const
   return 0;
 }
 
-int TFM::D2V_initialize_array(std::vector<int> &array, int &d2vtype, int &frames) const
+namespace {
+
+// Flags of the GOP lines in [b, e), which must start at a line start.
+// Stops at the first line that isn't a GOP line (ended = true); the
+// first line of the data section is always taken, like the old parser.
+struct D2VChunk
 {
-    std::unique_ptr<FILE, decltype (&fclose)> ind2v(nullptr, nullptr);
-  if (array.size() != 0) { array.resize(0); }
-  int num = 0, num2 = 0, pass = 1, val, D2Vformat;
-  char line[1025], *p;
-pass2_start:
-  ind2v = decltype (ind2v)(tivtc_fopen(d2v.c_str(), "r"), &fclose);
-  if (ind2v == nullptr) return 1;
-  if (pass == 2)
+  const char *b, *e;
+  bool first;
+  bool ended;
+  std::vector<int> vals;
+};
+
+void parseD2VChunk(D2VChunk &c, int D2Vformat)
+{
+  const int skip = 3 + (D2Vformat > 9 ? 1 : 0) + (D2Vformat > 0 ? (D2Vformat > 18 ? 3 : 2) : 0);
+  LineReader lines(c.b, c.e);
+  const char *lb, *le;
+  unsigned int val = 0;
+  bool first = c.first;
+  c.ended = false;
+  while (lines.next(lb, le))
   {
-    array.resize(num + 10, 9);
+    if (!first && (lb == le || *lb <= 47 || *lb >= 123))
+    {
+      c.ended = true;
+      return;
+    }
+    first = false;
+    const char *p = lb;
+    for (int i = 0; i < skip && p < le; ++i)
+    {
+      p = (const char *)memchr(p, ' ', le - p);
+      p = p ? p + 1 : le;
+    }
+    while (p < le && *p > 47 && *p < 123)
+    {
+      scanHex(p, le, val);
+      if (D2Vformat > 9)
+      {
+        if (D2Vformat > 10 && val == 0xFF) c.vals.push_back(9);
+        else if (D2Vformat == 10 && (val & 0x40)) c.vals.push_back(9);
+        else c.vals.push_back(val & 0x03);
+      }
+      else c.vals.push_back(val & ~0x10);
+      while (p < le && *p != ' ') p++;
+      p++;
+    }
   }
-  fgets(line, 1024, ind2v.get());
-  D2Vformat = 0;
-  if (strncmp(line, "DVD2AVIProjectFile", 18) != 0)
+}
+
+}
+
+int TFM::D2V_initialize_array(std::vector<int> &array, int &d2vtype, int &frames) const
+{
+  MappedFile mf(d2v.c_str());
+  if (!mf.isOpen()) return 1;
+  if (array.size() != 0) { array.resize(0); }
+  int D2Vformat = 0;
+  const char *p = mf.begin();
+  if (mf.size() < 18 || strncmp(p, "DVD2AVIProjectFile", 18) != 0)
   {
-    if (strncmp(line, "DGIndexProjectFile", 18) != 0)
+    if (mf.size() < 18 || strncmp(p, "DGIndexProjectFile", 18) != 0)
     {
       return 2;
     }
-    sscanf(line, "DGIndexProjectFile%d", &D2Vformat);
+    p += 18;
+    scanInt(p, mf.end(), D2Vformat);
     /* Disabled the check for newer formats
     if (D2Vformat > 14)
     {
-      fclose(ind2v);
-      ind2v = nullptr;
       return 2;
     }
     */
     D2Vformat += 3;
   }
-  if (D2Vformat == 0) sscanf(line, "DVD2AVIProjectFile%d", &D2Vformat);
-  while (fgets(line, 1024, ind2v.get()) != nullptr)
+  else
   {
-    if (strncmp(line, "Location", 8) == 0) break;
+    p += 18;
+    scanInt(p, mf.end(), D2Vformat);
   }
-  fgets(line, 1024, ind2v.get());
-  fgets(line, 1024, ind2v.get());
-  do
+
+  LineReader lines(mf);
+  const char *lb, *le;
+  while (lines.next(lb, le))
   {
-    p = line;
-    while (*p++ != ' ');
-    while (*p++ != ' ');
-    if (D2Vformat > 9) while (*p++ != ' ');
-    while (*p++ != ' ');
-    if (D2Vformat > 0)
-    {
-      while (*p++ != ' ');
-      while (*p++ != ' ');
-      if (D2Vformat > 18)
-        while (*p++ != ' ');
-    }
-    while (*p > 47 && *p < 123)
-    {
-      if (pass == 1) ++num;
-      else
-      {
-        sscanf(p, "%x", &val);
-        if (D2Vformat > 9)
-        {
-          if (D2Vformat > 10 && val == 0xFF) array[num2++] = 9;
-          else if (D2Vformat == 10 && (val & 0x40)) array[num2++] = 9;
-          else array[num2++] = (val & 0x03);
-        }
-        else array[num2++] = (val&~0x10);
-      }
-      while (*p != ' ' && *p != '\n') p++;
-      p++;
-    }
-  } while ((fgets(line, 1024, ind2v.get()) != nullptr) && line[0] > 47 && line[0] < 123);
-  if (pass == 1) { pass++; goto pass2_start; }
-  d2vtype = D2Vformat;
+    if (le - lb >= 8 && strncmp(lb, "Location", 8) == 0) break;
+  }
+  lines.next(lb, le);
+  const char *data = lines.pos();
+
+  // Split the GOP lines into chunks at line starts and tokenize them in
+  // parallel. Small projects aren't worth a thread.
+  const size_t minChunk = 1 << 20;
+  const size_t len = mf.end() - data;
+  size_t numChunks = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), len / minChunk));
+  std::vector<D2VChunk> chunks(numChunks);
+  const char *cb = data;
+  for (size_t i = 0; i < numChunks; ++i)
+  {
+    const char *ce = i + 1 == numChunks ? mf.end() : data + len * (i + 1) / numChunks;
+    if (ce < cb) ce = cb;
+    const char *nl = (const char *)memchr(ce, '\n', mf.end() - ce);
+    ce = nl && i + 1 < numChunks ? nl + 1 : mf.end();
+    chunks[i].b = cb;
+    chunks[i].e = ce;
+    chunks[i].first = i == 0;
+    cb = ce;
+  }
+  if (numChunks == 1)
+    parseD2VChunk(chunks[0], D2Vformat);
+  else
+  {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numChunks; ++i)
+      threads.emplace_back(parseD2VChunk, std::ref(chunks[i]), D2Vformat);
+    parseD2VChunk(chunks[0], D2Vformat);
+    for (auto &t : threads)
+      t.join();
+  }
+
+  // Join the chunks up to the end of the GOP lines, counting the frames
+  // up to the first end marker on the way.
+  size_t num = 0;
+  for (size_t i = 0; i < numChunks; ++i)
+  {
+    num += chunks[i].vals.size();
+    if (chunks[i].ended) { numChunks = i + 1; break; }
+  }
+  array.reserve(num + 10);
   frames = 0;
-  int i = 0;
-  while (array[i] != 9)
+  bool counting = true;
+  for (size_t i = 0; i < numChunks; ++i)
   {
-    if (array[i] & 1) frames += 3;
-    else frames += 2;
-    ++i;
+    for (int v : chunks[i].vals)
+    {
+      if (v == 9) counting = false;
+      else if (counting) frames += (v & 1) ? 3 : 2;
+    }
+    array.insert(array.end(), chunks[i].vals.begin(), chunks[i].vals.end());
+    std::vector<int>().swap(chunks[i].vals);
   }
+  array.resize(num + 10, 9);
+  d2vtype = D2Vformat;
   frames >>= 1;
   return 0;
 }
@@ -623,3 +716,102 @@ bool TFM::checkD2VCase(int check) const
   }
   return false;
 }
+
+// d2vtrust: frames inside consistent d2v film runs take their match straight
+// from the d2v flags without fetching both neighbours or looking for combing.
+// A frame is trusted if it and its neighbours are in pattern film and nothing
+// in the ovr file touches it. Every d2vtrust-th frame, and the first frame of
+// a run, is a spot check and goes through the normal checks. With flags 4/5
+// the trusted frames after a spot check also depend on whether its d2v match
+// is combed; that is checked once, when the first of them is requested, so
+// trust is a function of the frame number and not of the request order.
+void TFM::D2V_build_trust()
+{
+  if (d2vfilmarray.empty() || flags == 0 || flags == 3 || order_origSaved == -1 ||
+    micout > 0 || display)
+    return;
+  const int fld = field_origSaved == -1 ? order_origSaved : field_origSaved;
+  const int size = std::min((int)d2vfilmarray.size(), vi->numFrames);
+  auto film = [&](int i) {
+    if (i < 0 || i >= size) return 0;
+    const int v = d2vfilmarray[i];
+    const int m = (v & D2VARRAY_MATCH_MASK) >> 2;
+    return (v & 0x40) && (m == 1 || m == 2) ? m : 0;
+  };
+  // a setting line only matters if it sets one of the keys
+  auto settingOvr = [&](int i) {
+    const int *s = setArray.find(i);
+    return s && std::any_of(s, s + setArray.numKeys(), [](int v) { return v != SettingOvr::unset; });
+  };
+  d2vtrusted.assign(vi->numFrames, 0);
+  for (int n = 0; n <= nfrms; ++n)
+  {
+    const int m = film(n);
+    if (m && (n == 0 || film(n - 1)) && (n == nfrms || film(n + 1)) &&
+      (ovrArray.empty() || ovrArray[n] == 255) && !settingOvr(n))
+      d2vtrusted[n] = m == 1 ? 2 : (fld ^ order_origSaved ? 3 : 1);
+  }
+
+  // the d2v match only gets a combing check with flags 4, or 5 at scene changes
+  d2vSpotChecks = PP_origSaved > 0 && (flags == 4 || flags == 5);
+  if (d2vSpotChecks)
+    d2vSpotCombed.reset(vi->numFrames, -1);
+}
+
+// the spot check a trusted frame n depends on, n itself if it is one
+int TFM::d2vSpotFrame(int n) const
+{
+  const int block = n - n % d2vtrust;
+  int s = n;
+  while (s > block && d2vtrusted[s - 1])
+    --s;
+  return s;
+}
+
+// 0 if n takes the normal path, else the neighbour its match needs as in
+// d2vtrusted, -1 while that depends on a spot check that hasn't run yet
+int TFM::d2vTrust(int n) const
+{
+  if (d2vtrusted.empty() || !d2vtrusted[n]) return 0;
+  const int s = d2vSpotFrame(n);
+  if (s == n) return 0;
+  if (!d2vSpotChecks) return d2vtrusted[n];
+  if (!d2vSpotCombed.isSet(s)) return -1;
+  return d2vSpotCombed.get(s) ? 0 : d2vtrusted[n];
+}
+
+// what GetFrame finds for the d2v match of spot check frame n, the frames
+// around it have to be requested; arAllFramesReady is serialized, so each
+// spot check runs once
+bool TFM::d2vSpotCheckCombed(int n, VSFrameContext *frameCtx, VSCore *core)
+{
+  if (d2vSpotCombed.isSet(n))
+    return d2vSpotCombed.get(n) != 0;
+
+  const VSFrameRef *prv = vsapi->getFrameFilter(std::max(0, n - 1), child, frameCtx);
+  const VSFrameRef *src = vsapi->getFrameFilter(n, child, frameCtx);
+  const VSFrameRef *nxt = vsapi->getFrameFilter(std::min(n + 1, nfrms), child, frameCtx);
+
+  order = order_origSaved;
+  mode = mode_origSaved;
+  field = field_origSaved == -1 ? order : field_origSaved;
+  PP = PP_origSaved;
+  MI = MI_origSaved;
+  int match = -20, combed = -1;
+  bool d2vmatch = false, result = false;
+  if (getMatchOvr(n, match, combed, d2vmatch, flags == 5 ? checkSceneChange(prv, src, nxt, n) : false) &&
+    d2vmatch && combed == -1)
+  {
+    VSFrameRef *dst = vsapi->newVideoFrame(vi->format, vi->width, vi->height, src, core);
+    int cfrm = -20, xblocks = -20;
+    int blockN[5] = { -20, -20, -20, -20, -20 };
+    int mics[5] = { -20, -20, -20, -20, -20 };
+    createWeaveFrame(dst, prv, src, nxt, match, cfrm);
+    result = checkCombed(dst, n, match, blockN, xblocks, mics, false);
+    vsapi->freeFrame(dst);
+  }
+  vsapi->freeFrame(prv);
+  vsapi->freeFrame(src);
+  vsapi->freeFrame(nxt);
+  return d2vSpotCombed.set(n, result ? 1 : 0) != 0;
+}
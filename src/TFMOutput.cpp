@@ -0,0 +1,463 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include "TFMOutput.h"
+#include "internal.h"
+
+TFMOutput::TFMOutput(const char *output, const char *outputC, int _numFrames, int _fieldO,
+  unsigned int _crc, int _micout, int _cNum, int _PP, int _MI, bool binary)
+  : out(nullptr), outC(nullptr), outputName(output), outputCName(outputC), fieldO(_fieldO), crc(_crc),
+  numFrames(_numFrames), micout(_micout), cNum(_cNum),
+  PP(_PP), MI(_MI), ao(-1), nextFrame(0), records(nullptr), recordsNext(0), late(false),
+  cCount(0), helpComplete(_PP >= 0),
+  ccount(0), mcount(0), acount(0), gIcount(0), gPcount(0), gRcount(0),
+  missedCount(0), mPrev(0), mCurr(0), mCurrCombed(false), aLast(-1), aCount(0)
+{
+  if (output[0] && binary)
+  {
+    TwoPassHeader h = makeTwoPassHeader(TWOPASS_TFM, numFrames);
+    h.crc = crc;
+    h.field = fieldO;
+    h.micout = micout;
+    h.recordSize = 8 + (micout == 0 ? 0 : micout == 1 ? 12 : 20);
+    h.PP = PP;
+    h.MI = MI;
+    bin.reset(new TwoPassWriter(output, h, 0));
+    if (!bin->isOpen())
+      throw TIVTCError("TFM:  output file error (cannot create file)!");
+    bin->flush();
+  }
+  else if (output[0])
+  {
+    if ((out = tivtc_fopen(output, "w")) == nullptr)
+      throw TIVTCError("TFM:  output file error (cannot create file)!");
+  }
+  if (outputC[0])
+  {
+    if ((outC = tivtc_fopen(outputC, "w")) == nullptr)
+    {
+      if (out) fclose(out);
+      throw TIVTCError("TFM:  outputC file error (cannot create file)!");
+    }
+  }
+  writeHeaders();
+  // the binary file is written in place, only the text files need it
+  if (out || outC)
+    records = tmpfile();
+}
+
+void TFMOutput::writeHeaders()
+{
+  if (out)
+  {
+    fprintf(out, "#TFM %s by tritical\n", VERSION);
+    fprintf(out, "field = %s\n", fieldO == 1 ? "top" : "bottom");
+    fprintf(out, "crc32 = %x\n", crc);
+    fflush(out);
+  }
+  if (outC)
+  {
+    fprintf(outC, "#TFM %s by tritical\n", VERSION);
+    fflush(outC);
+  }
+}
+
+TFMOutput::~TFMOutput()
+{
+  finish();
+  bin.reset();
+  if (out) fclose(out);
+  if (outC) fclose(outC);
+  if (records) fclose(records);
+}
+
+void TFMOutput::add(int n, uint8_t hint, int mic, const int mics[5], int againstOrder)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  Record r = {};
+  r.hint = hint;
+  r.mic = mic;
+  r.ao = againstOrder;
+  const int sn = micout == 1 ? 3 : 5;
+  for (int i = 0; i < 5; ++i)
+    r.mics[i] = micout > 0 && i < sn ? (mics[i] == -20 ? -1 : mics[i]) : -1;
+  r.stored = true;
+
+  if (bin)
+  {
+    if (bin->header().ao == -1)
+    {
+      bin->header().ao = againstOrder;
+      bin->writeHeader();
+    }
+    bin->writeTFM(n, hint, r.mic, r.mics);
+    if (!outC)
+    {
+      // nothing else needs frames in order
+      bin->flush();
+      return;
+    }
+  }
+
+  if (n < nextFrame)
+  {
+    // already written, or skipped and now written again at the end; a
+    // rerequested frame gives the same result
+    if (records && !late)
+    {
+      Record old;
+      if (fseek(records, (long)n * sizeof(Record), SEEK_SET) != 0 || fread(&old, sizeof(Record), 1, records) != 1 || !old.stored)
+        late = true;
+      recordsNext = -1;
+    }
+    if (late)
+      store(n, r);
+    return;
+  }
+  if (records)
+    store(n, r);
+  pending[n] = r;
+
+  drain();
+}
+
+void TFMOutput::store(int n, const Record &r)
+{
+  if (n != recordsNext)
+    fseek(records, (long)n * sizeof(Record), SEEK_SET);
+  fwrite(&r, sizeof(Record), 1, records);
+  recordsNext = n + 1;
+}
+
+// writes the text files again from the records file, after a frame that
+// was skipped as never requested finished after all
+void TFMOutput::replay()
+{
+  if (out)
+  {
+    fclose(out);
+    out = tivtc_fopen(outputName.c_str(), "w");
+  }
+  if (outC)
+  {
+    fclose(outC);
+    outC = tivtc_fopen(outputCName.c_str(), "w");
+  }
+  writeHeaders();
+
+  ao = -1;
+  cCount = 0;
+  helpComplete = PP >= 0;
+  ccount = mcount = acount = 0;
+  combedList.clear();
+  groupList.clear();
+  missedList.clear();
+  againstList.clear();
+  gIcount = gPcount = gRcount = 0;
+  missedCount = mPrev = mCurr = 0;
+  mCurrCombed = false;
+  aLast = -1;
+  aCount = 0;
+
+  fflush(records);
+  rewind(records);
+  Record r;
+  for (int n = 0; n < numFrames; ++n)
+  {
+    const bool ok = fread(&r, sizeof(Record), 1, records) == 1 && r.stored;
+    consume(n, ok ? &r : nullptr);
+  }
+}
+
+// writes the contiguous run at the head of the reorder buffer, giving up on
+// frames that are more than reorderWindow behind the newest one
+void TFMOutput::drain()
+{
+  const int start = nextFrame;
+  const int limit = pending.rbegin()->first - reorderWindow;
+  while (nextFrame <= limit && pending.begin()->first > nextFrame)
+  {
+    consume(nextFrame, nullptr);
+    nextFrame = std::min(pending.begin()->first, limit + 1);
+  }
+  while (!pending.empty() && pending.begin()->first == nextFrame)
+  {
+    consume(nextFrame, &pending.begin()->second);
+    pending.erase(pending.begin());
+    ++nextFrame;
+  }
+  if (nextFrame == start) return;
+  if (out) fflush(out);
+  if (outC) fflush(outC);
+  if (bin) bin->flush();
+}
+
+TFMOutput::Section::~Section()
+{
+  if (spill) fclose(spill);
+}
+
+void TFMOutput::Section::append(const char *s)
+{
+  text += s;
+  if (text.size() < 65536) return;
+  if (!spill) spill = tmpfile();
+  if (!spill) return; // keep it in memory then
+  fwrite(text.data(), 1, text.size(), spill);
+  text.clear();
+}
+
+void TFMOutput::Section::clear()
+{
+  text.clear();
+  text.shrink_to_fit();
+  if (spill) fclose(spill);
+  spill = nullptr;
+}
+
+void TFMOutput::Section::writeTo(FILE *f)
+{
+  if (spill)
+  {
+    char buf[65536];
+    size_t len;
+    rewind(spill);
+    while ((len = fread(buf, 1, sizeof(buf), spill)) > 0)
+      fwrite(buf, 1, len, f);
+  }
+  fputs(text.c_str(), f);
+}
+
+// r == nullptr marks a frame that was never requested
+void TFMOutput::consume(int n, const Record *r)
+{
+  if (r && ao == -1) ao = r->ao;
+  if (r && out) writeFrame(n, *r);
+  if (outC)
+  {
+    const int match = r ? (r->hint & 0x07) : 0;
+    if (match == 1 || match == 5 || match == 6) ++cCount;
+    else
+    {
+      if (cCount > cNum) fprintf(outC, "%d,%d\n", n - cCount, n - 1);
+      cCount = 0;
+    }
+  }
+  if (out && helpComplete)
+  {
+    if (r) helpFrame(n, *r);
+    else
+    {
+      // the help section needs every frame, don't keep collecting it
+      helpComplete = false;
+      combedList.clear();
+      groupList.clear();
+      missedList.clear();
+      againstList.clear();
+    }
+  }
+}
+
+void TFMOutput::writeFrame(int n, const Record &r)
+{
+  char buf[128];
+  const int match = r.hint & 0x07;
+  int len = snprintf(buf, sizeof(buf), "%d %c", n, MTC(match));
+  if (r.hint & 0x20)
+    len += snprintf(buf + len, sizeof(buf) - len, (r.hint & 0x10) ? " +" : " -");
+  if (r.hint & FILE_D2V)
+    len += snprintf(buf + len, sizeof(buf) - len, " 1");
+  if (r.mic != -1)
+    len += snprintf(buf + len, sizeof(buf) - len, " [%d]", r.mic);
+  if (micout == 1)
+    len += snprintf(buf + len, sizeof(buf) - len, " (%d %d %d)", r.mics[0], r.mics[1], r.mics[2]);
+  else if (micout > 1)
+    len += snprintf(buf + len, sizeof(buf) - len, " (%d %d %d %d %d)", r.mics[0], r.mics[1],
+      r.mics[2], r.mics[3], r.mics[4]);
+  fprintf(out, "%s\n", buf);
+}
+
+// Streaming version of the old whole clip ovr help pass. Each section
+// is kept as text until the end of the file is written.
+void TFMOutput::helpFrame(int i, const Record &r)
+{
+  char buf[96];
+  const bool combed = (r.hint & 0x30) == 0x30;
+  const int temp = r.hint & 0x07;
+
+  // [Individual Frames]
+  if (combed)
+  {
+    ++ccount;
+    if (r.mic < 0) snprintf(buf, sizeof(buf), "#   %d\n", i);
+    else snprintf(buf, sizeof(buf), "#   %d (%d)\n", i, r.mic);
+    combedList.append(buf);
+  }
+
+  // [Grouped Ranges Allowing Small Breaks]
+  if (combed)
+  {
+    ++gIcount;
+    ++gRcount;
+    gPcount = 0;
+  }
+  else
+  {
+    ++gPcount;
+    if (gRcount > 0) ++gRcount;
+    if (gPcount > 12)
+    {
+      if (gIcount > 1)
+      {
+        snprintf(buf, sizeof(buf), "#   %d,%d (%3.1f%c)\n", i - gRcount + 1, i - gPcount,
+          gIcount*100.0 / double(gRcount - gPcount), '%');
+        groupList.append(buf);
+      }
+      gRcount = gIcount = 0;
+    }
+  }
+
+  // [POSSIBLE MISSED COMBED FRAMES], decided one frame late
+  if (r.mic != -1) ++mcount;
+  if (i > 0) helpMissed(i - 1, r.mic);
+  mPrev = i > 0 ? mCurr : 0;
+  mCurr = r.mic;
+  mCurrCombed = combed;
+
+  // [u, b, AND AGAINST ORDER MATCHES]
+  auto endRun = [&](int end) {
+    if (aCount == 1) snprintf(buf, sizeof(buf), "#   %d %c\n", end - 1, MTC(aLast));
+    else snprintf(buf, sizeof(buf), "#   %d,%d %c\n", end - aCount, end - 1, MTC(aLast));
+    againstList.append(buf);
+  };
+  if (temp == 3 || temp == 4 || temp == ao)
+  {
+    ++acount;
+    if (aLast == -1) aLast = temp;
+    else if (temp != aLast)
+    {
+      endRun(i);
+      aCount = 0;
+      aLast = temp;
+    }
+    ++aCount;
+  }
+  else if (aCount)
+  {
+    endRun(i);
+    aCount = 0;
+    aLast = -1;
+  }
+}
+
+void TFMOutput::helpMissed(int i, int next)
+{
+  if (mCurrCombed) return;
+  const int maxcp = int(MI*0.85);
+  const int mt = std::max(int(MI*0.1875), 5);
+  const int prev = mPrev;
+  const int curr = mCurr;
+  if (curr <= MI && ((curr >= mt && curr > next * 2 && curr > prev * 2 &&
+    curr - next > mt && curr - prev > mt) || (curr > maxcp) ||
+    (prev > MI && next > MI && curr > MI*0.5) ||
+    ((prev > MI || next > MI) && curr > MI*0.75)))
+  {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "#   %d (%d)\n", i, curr);
+    missedList.append(buf);
+    ++missedCount;
+  }
+}
+
+void TFMOutput::finish()
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  // whatever is still parked sits behind frames that never finished
+  for (auto &p : pending)
+  {
+    if (p.first > nextFrame) consume(nextFrame, nullptr);
+    consume(p.first, &p.second);
+    nextFrame = p.first + 1;
+  }
+  pending.clear();
+  if (nextFrame < numFrames)
+  {
+    consume(nextFrame, nullptr);
+    nextFrame = numFrames;
+  }
+  if (late)
+  {
+    replay();
+    late = false;
+  }
+
+  if (outC && cCount > cNum)
+    fprintf(outC, "%d,%d\n", numFrames - cCount, numFrames - 1);
+  cCount = 0;
+
+  if (!out || !helpComplete || numFrames == 0) return;
+  helpComplete = false;
+
+  const int i = numFrames;
+  if (gIcount > 1)
+  {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "#   %d,%d (%3.1f%c)\n", i - gRcount, i - gPcount,
+      gIcount*100.0 / double(gRcount - gPcount), '%');
+    groupList.append(buf);
+  }
+  helpMissed(i - 1, 0);
+  if (aCount)
+  {
+    char buf[64];
+    if (aCount == 1) snprintf(buf, sizeof(buf), "#   %d %c\n", i - 1, MTC(aLast));
+    else snprintf(buf, sizeof(buf), "#   %d,%d %c\n", i - aCount, i - 1, MTC(aLast));
+    againstList.append(buf);
+  }
+
+  fprintf(out, "#\n#\n# OVR HELP INFORMATION:\n#\n");
+  fprintf(out, "# [COMBED FRAMES]\n#\n");
+  fprintf(out, "#   [Individual Frames]\n");
+  fprintf(out, "#   FORMAT:  frame_number (mic_value)\n#\n");
+  if (PP == 0) fprintf(out, "#   none detected (PP=0)\n");
+  else if (ccount) combedList.writeTo(out);
+  else fprintf(out, "#   none detected\n");
+  fprintf(out, "#\n#   [Grouped Ranges Allowing Small Breaks]\n");
+  fprintf(out, "#   FORMAT:  frame_start, frame_end (percentage combed)\n#\n");
+  if (PP == 0) fprintf(out, "#   none detected (PP=0)\n");
+  else if (ccount) groupList.writeTo(out);
+  else fprintf(out, "#   none detected\n");
+  fprintf(out, "#\n#\n# [POSSIBLE MISSED COMBED FRAMES]\n#\n");
+  fprintf(out, "#   FORMAT:  frame_number (mic_value)\n#\n");
+  if (PP == 0) fprintf(out, "#   none detected (PP=0)\n");
+  else if (mcount && missedCount) missedList.writeTo(out);
+  else fprintf(out, "#   none detected\n");
+  fprintf(out, "#\n#\n# [u, b, AND AGAINST ORDER (%c) MATCHES]\n#\n", MTC(ao));
+  fprintf(out, "#   FORMAT:  frame_number match  or  range_start,range_end match\n#\n");
+  if (acount) againstList.writeTo(out);
+  else fprintf(out, "#   none detected\n");
+}
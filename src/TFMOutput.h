@@ -0,0 +1,131 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TFMOUTPUT_H
+#define TFMOUTPUT_H
+
+/*
+** Incremental writer for the TFM output and outputC files.
+**
+** Frames may finish out of order, so finished frames are parked in a
+** small reorder buffer and written out (and flushed) as soon as they
+** extend the contiguous run starting at frame 0. A frame that is still
+** missing when the newest one is reorderWindow frames ahead is skipped.
+** Every record also goes to a temporary file indexed by frame number; if
+** a skipped frame finishes after all, the text files are written again
+** from it at the end. Everything that used to need whole clip arrays
+** (the outputC ranges and the ovr help section at the end of the output
+** file) is accumulated while streaming, the help text in temporary
+** files, so memory no longer grows with the clip length and a killed
+** job leaves all lines written so far behind.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "TwoPassFile.h"
+
+class TFMOutput
+{
+private:
+  static const int reorderWindow = 512;
+
+  // help section text, moved to a temporary file once it gets long
+  class Section
+  {
+  private:
+    std::string text;
+    FILE *spill;
+
+  public:
+    Section() : spill(nullptr) {}
+    ~Section();
+    Section(const Section &) = delete;
+    Section &operator=(const Section &) = delete;
+    void append(const char *s);
+    void clear();
+    void writeTo(FILE *f);
+  };
+
+  struct Record {
+    uint8_t hint;  // FILE_* flags and match, as in the output file
+    int mic;       // mic of the final match, -1 = none
+    int mics[5];
+    int ao;
+    bool stored; // false for the zero filled gaps of the records file
+  };
+
+  FILE *out, *outC;
+  std::unique_ptr<TwoPassWriter> bin;
+  std::string outputName, outputCName;
+  int fieldO;
+  unsigned int crc;
+  int numFrames;
+  int micout, cNum;
+  int PP, MI;
+  int ao; // against order match, -1 until the first frame is written
+  std::mutex lock;
+  int nextFrame;
+  std::map<int, Record> pending;
+  // every finished record, written again at the end if one came in late
+  FILE *records;
+  int recordsNext; // frame the file position of records points at
+  bool late;
+
+  // outputC state
+  int cCount;
+  // ovr help state, only valid while every frame so far had an entry
+  bool helpComplete;
+  int ccount, mcount, acount;
+  Section combedList, groupList, missedList, againstList;
+  int gIcount, gPcount, gRcount;
+  int missedCount, mPrev, mCurr;
+  bool mCurrCombed;
+  int aLast, aCount;
+
+  void writeHeaders();
+  void store(int n, const Record &r);
+  void replay();
+  void consume(int n, const Record *r);
+  void drain();
+  void writeFrame(int n, const Record &r);
+  void helpFrame(int n, const Record &r);
+  void helpMissed(int i, int next);
+  void finish();
+
+public:
+  // Empty file names disable the corresponding file. binary writes output
+  // in the TwoPassFile format, PP < 0 leaves out the ovr help section.
+  TFMOutput(const char *output, const char *outputC, int _numFrames, int fieldO,
+    unsigned int crc, int _micout, int _cNum, int _PP, int _MI, bool binary);
+  ~TFMOutput();
+
+  void add(int n, uint8_t hint, int mic, const int mics[5], int againstOrder);
+};
+
+#endif // TFMOUTPUT_H
@@ -0,0 +1,397 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <cstring>
+#include "TFM.h"
+#include "MappedFile.h"
+#include "TwoPassFile.h"
+
+// Single pass parsers for the TFM input and ovr files. Both files are
+// mapped and tokenized in place, one line at a time.
+
+namespace {
+
+struct OvrLine
+{
+  const char *b, *e;
+
+  // character at i, or 0 past the end of the line (fgets buffer semantics)
+  char at(ptrdiff_t i) const { return i >= 0 && b + i < e ? b[i] : 0; }
+
+  // index of the first character out of set, or the line length
+  ptrdiff_t firstOf(const char *set) const
+  {
+    const char *p = b;
+    while (p < e && *p != 0 && !strchr(set, *p)) ++p;
+    return p - b;
+  }
+
+  bool contains(const char *set) const { return at(firstOf(set)) != 0; }
+
+  bool skipped() const { return b == e || *b == 0 || *b == '\r' || *b == ';' || *b == '#'; }
+
+  bool blank() const
+  {
+    for (const char *p = b; p < e; ++p)
+      if (*p != ' ') return false;
+    return true;
+  }
+
+  bool startsWithNoCase(const char *s) const
+  {
+    const size_t n = strlen(s);
+    return (size_t)(e - b) >= n && _strnicmp(b, s, n) == 0;
+  }
+};
+
+int matchFromChar(char c)
+{
+  switch (c)
+  {
+  case 'p': return 0;
+  case 'c': return 1;
+  case 'n': return 2;
+  case 'b': return 3;
+  case 'u': return 4;
+  case 'l': return 5;
+  case 'h': return 6;
+  }
+  return -1;
+}
+
+inline bool isMatchChar(char c) { return c != 0 && matchFromChar(c) >= 0; }
+inline bool isCombChar(char c) { return c == '-' || c == '+'; }
+inline bool isSettingChar(char c) { return c == 'f' || c == 'm' || c == 'o' || c == 'P' || c == 'i'; }
+
+// file field differs from the clip field: p <-> b, n <-> u
+inline int swapMatchField(int q)
+{
+  return q == 0 ? 3 : q == 2 ? 4 : q == 3 ? 0 : q == 4 ? 2 : q;
+}
+
+void checkSettingValue(int q, int b)
+{
+  if (q == 'f' && b != 0 && b != 1 && b != -1)
+    throw TIVTCError("TFM:  ovr input error (bad field value)!");
+  else if (q == 'o' && b != 0 && b != 1 && b != -1)
+    throw TIVTCError("TFM:  ovr input error (bad order value)!");
+  else if (q == 'm' && (b < 0 || b > 7))
+    throw TIVTCError("TFM:  ovr input error (bad mode value)!");
+  else if (q == 'P' && (b < 0 || b > 7))
+    throw TIVTCError("TFM:  ovr input error (bad PP value)!");
+}
+
+} // namespace
+
+void TFM::setOvrMatch(int n, int q)
+{
+  ovrArray[n] |= 0x07;
+  ovrArray[n] &= (q | 0xF8);
+}
+
+void TFM::setOvrCombed(int n, int q)
+{
+  ovrArray[n] &= 0xDF;
+  ovrArray[n] |= 0x10;
+  ovrArray[n] &= (q | 0xEF);
+  // a forced clean frame can't keep a deinterlacing (l/h) match
+  if (q == 0 && ((ovrArray[n] & 7) == 6 || (ovrArray[n] & 7) == 5))
+    setOvrMatch(n, 1);
+}
+
+void TFM::parseInputFile()
+{
+  MappedFile mf(input.c_str());
+  if (!mf.isOpen())
+    throw TIVTCError("TFM:  input file error (could not open file)!");
+
+  ovrArray.resize(nfrms + 1, 255);
+  if (d2vfilmarray.size() == 0)
+    d2vfilmarray.resize(nfrms + 2, 0);
+
+  if (isTwoPassBinary(mf))
+  {
+    TwoPassView bin(mf, TWOPASS_TFM, "TFM");
+    unsigned int tempCrc;
+    calcCRC(child, 15, tempCrc, vsapi);
+    if (tempCrc != bin.header().crc && !batch && segFrames == vi->numFrames)
+      throw TIVTCError("TFM:  crc32 in input file does not match that of the current clip!");
+    if (bin.numFrames() > nfrms + 1)
+      throw TIVTCError("TFM:  input file error (out of range or non-ascending frame #)!");
+    const int fieldt = bin.header().field;
+    for (int z = 0; z < bin.numFrames(); ++z)
+    {
+      const uint8_t hint = bin.hint(z);
+      if (!(hint & FILE_ENTRY))
+        continue;
+      int q = hint & 0x07;
+      if (fieldt != fieldO)
+        q = swapMatchField(q);
+      if (hint & FILE_D2V)
+      {
+        d2vfilmarray[z] &= ~0x03;
+        d2vfilmarray[z] |= fieldt == 1 ? 0x3 : 0x1;
+      }
+      setOvrMatch(z, q);
+      if (hint & FILE_NOTCOMBED)
+      {
+        ovrArray[z] &= 0xDF;
+        ovrArray[z] |= 0x10;
+        ovrArray[z] &= ((hint & COMBED) | 0xEF);
+      }
+    }
+    return;
+  }
+
+  int fieldt = fieldO, firstLine = 0, z = 0;
+  LineReader lines(mf);
+  OvrLine l;
+  while (lines.next(l.b, l.e))
+  {
+    if (l.skipped())
+      continue;
+    ++firstLine;
+    const char c = l.at(l.firstOf("fF c"));
+    if (c == 'f' || c == 'F')
+    {
+      if (firstLine == 1)
+      {
+        if (l.startsWithNoCase("field = top")) fieldt = 1;
+        else if (l.startsWithNoCase("field = bottom")) fieldt = 0;
+      }
+    }
+    else if (c == 'c')
+    {
+      if (l.startsWithNoCase("crc32 = "))
+      {
+        const char *p = l.b + 8;
+        unsigned int m = 0, tempCrc;
+        scanHex(p, l.e, m);
+        calcCRC(child, 15, tempCrc, vsapi);
+        if (tempCrc != m && !batch && segFrames == vi->numFrames)
+          throw TIVTCError("TFM:  crc32 in input file does not match that of the current clip!");
+      }
+    }
+    else if (c == ' ')
+    {
+      if (l.blank()) { --firstLine; continue; }
+      const char *p = l.b;
+      scanInt(p, l.e, z);
+      if (!l.contains("pcnubhl"))
+        continue;
+      if (z < 0 || z > nfrms)
+        throw TIVTCError("TFM:  input file error (out of range or non-ascending frame #)!");
+      // "frame match [+|-] [1] [mic] [(mics)]"
+      const ptrdiff_t sp = l.firstOf(" ");
+      int q = matchFromChar(l.at(sp + 1));
+      if (q < 0)
+        throw TIVTCError("TFM:  input file error (invalid match specifier)!");
+      int qt = -1;
+      bool d2vmarked = false;
+      const char t = l.at(sp + 3);
+      if (t == '-') qt = 0;
+      else if (t == '+') qt = COMBED;
+      else if (t == '1') d2vmarked = true;
+      else if (t != 0 && t != '[')
+        throw TIVTCError("TFM:  input file error (invalid specifier)!");
+      if (fieldt != fieldO)
+        q = swapMatchField(q);
+      if (qt != -1 && l.at(sp + 5) == '1')
+        d2vmarked = true;
+      if (d2vmarked)
+      {
+        d2vfilmarray[z] &= ~0x03;
+        d2vfilmarray[z] |= fieldt == 1 ? 0x3 : 0x1;
+      }
+      // mic values ([n] and (n n n)) are not used as input yet
+      setOvrMatch(z, q);
+      if (qt != -1)
+      {
+        ovrArray[z] &= 0xDF;
+        ovrArray[z] |= 0x10;
+        ovrArray[z] &= (qt | 0xEF);
+      }
+    }
+  }
+}
+
+void TFM::parseOvrFile()
+{
+  MappedFile mf(ovr.c_str());
+  if (!mf.isOpen())
+    throw TIVTCError("TFM:  ovr input error (could not open ovr file)!");
+
+  const int qdef = ovrDefault == 2 ? COMBED : 0;
+  if (ovrDefault != 0 && ovrArray.size())
+  {
+    for (int h = 0; h <= nfrms; ++h)
+      setOvrCombed(h, qdef);
+  }
+
+  int last = -1, fieldt = fieldO, firstLine = 0;
+  int z = 0, w = 0, b = 0;
+  LineReader lines(mf);
+  OvrLine l;
+  while (lines.next(l.b, l.e))
+  {
+    if (l.skipped())
+      continue;
+    // any line with match or combed specifiers needs the per frame array
+    if (ovrArray.size() == 0 && l.contains("cpnbulh+-"))
+    {
+      ovrArray.resize(nfrms + 1, 255);
+      if (ovrDefault != 0)
+      {
+        for (int h = 0; h <= nfrms; ++h)
+          setOvrCombed(h, qdef);
+      }
+    }
+    ++firstLine;
+    const ptrdiff_t sp = l.firstOf("fF ,");
+    const char c = l.at(sp);
+    if (c == 'f' || c == 'F')
+    {
+      if (firstLine == 1)
+      {
+        if (l.startsWithNoCase("field = top")) fieldt = 1;
+        else if (l.startsWithNoCase("field = bottom")) fieldt = 0;
+      }
+    }
+    else if (c == ' ')
+    {
+      // "frame x"
+      if (l.blank()) { --firstLine; continue; }
+      const char m = l.at(sp + 1);
+      const char *p = l.b;
+      scanInt(p, l.e, z);
+      if (isMatchChar(m))
+      {
+        if (z < 0 || z > nfrms || z <= last)
+          throw TIVTCError("TFM:  ovr file error (out of range or non-ascending frame #)!");
+        int q = matchFromChar(m);
+        if (fieldt != fieldO)
+          q = swapMatchField(q);
+        setOvrMatch(z, q);
+        last = z;
+      }
+      else if (isCombChar(m))
+      {
+        if (z < 0 || z > nfrms)
+          throw TIVTCError("TFM:  ovr file error (out of range or non-ascending frame #)!");
+        setOvrCombed(z, m == '+' ? COMBED : 0);
+      }
+      else
+      {
+        if (z < 0 || z > nfrms)
+          throw TIVTCError("TFM:  ovr input error (out of range frame #)!");
+        if (!isSettingChar(m) || l.at(sp + 3) == 0)
+          continue;
+        p = l.b + sp + 3;
+        scanInt(p, l.e, b);
+        checkSettingValue(m, b);
+        setArray.add(m, z, z, b);
+      }
+    }
+    else if (c == ',')
+    {
+      // "start,end x" or "start,end xyz..." (pattern repeated over the range)
+      const ptrdiff_t rsp = l.firstOf(" ");
+      if (l.at(rsp) == 0)
+        continue;
+      const char m = l.at(rsp + 1);
+      const char *p = l.b;
+      if (scanInt(p, l.e, z) && p < l.e && *p == ',')
+      {
+        ++p;
+        scanInt(p, l.e, w);
+      }
+      if (w == 0) w = nfrms;
+      if (isMatchChar(m))
+      {
+        if (z < 0 || z > nfrms || w < 0 || w > nfrms || w < z || z <= last)
+          throw TIVTCError("TFM:  input file error (out of range or non-ascending frame #)!");
+        if (isMatchChar(l.at(rsp + 2)))
+        {
+          int count = 0;
+          char t;
+          while (isMatchChar(t = l.at(rsp + 1 + count)) && z + count <= w)
+          {
+            int q = matchFromChar(t);
+            if (fieldt != fieldO)
+              q = swapMatchField(q);
+            setOvrMatch(z + count, q);
+            ++count;
+          }
+          for (; z + count <= w; ++z)
+            setOvrMatch(z + count, ovrArray[z] & 0x07);
+        }
+        else
+        {
+          int q = matchFromChar(m);
+          if (fieldt != fieldO)
+            q = swapMatchField(q);
+          for (; z <= w; ++z)
+            setOvrMatch(z, q);
+        }
+        last = w;
+      }
+      else if (isCombChar(m))
+      {
+        if (z < 0 || z > nfrms || w < 0 || w > nfrms || w < z)
+          throw TIVTCError("TFM:  input file error (out of range or non-ascending frame #)!");
+        if (isCombChar(l.at(rsp + 2)))
+        {
+          int count = 0;
+          char t;
+          while (isCombChar(t = l.at(rsp + 1 + count)) && z + count <= w)
+          {
+            setOvrCombed(z + count, t == '+' ? COMBED : 0);
+            ++count;
+          }
+          for (; z + count <= w; ++z)
+            setOvrCombed(z + count, ovrArray[z] & COMBED);
+        }
+        else
+        {
+          const int q = m == '+' ? COMBED : 0;
+          for (; z <= w; ++z)
+            setOvrCombed(z, q);
+        }
+      }
+      else
+      {
+        if (z < 0 || z > nfrms || w < 0 || w > nfrms || w < z)
+          throw TIVTCError("TFM: ovr input error (invalid frame range)!");
+        if (!isSettingChar(m) || l.at(rsp + 3) == 0)
+          continue;
+        p = l.b + rsp + 3;
+        scanInt(p, l.e, b);
+        checkSettingValue(m, b);
+        setArray.add(m, z, w, b);
+      }
+    }
+  }
+  setArray.build();
+}
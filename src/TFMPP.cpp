@@ -749,6 +749,26 @@ void blendDeintMask_C(const pixel_t* srcp, pixel_t* dstp,
   }
 }
 
+// instantiate
+template void blendDeintMask_SSE2<false>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void blendDeintMask_SSE2<true>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void blendDeintMask_C<uint8_t, false>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void blendDeintMask_C<uint8_t, true>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void blendDeintMask_C<uint16_t, false>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void blendDeintMask_C<uint16_t, true>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+
 void TFMPP::CubicDeint(const VSFrameRef *src, const VSFrameRef *mask, VSFrameRef *dst, bool nomask,
   int field) const
 {
@@ -986,6 +1006,44 @@ void cubicDeintMask_C(const pixel_t* srcp, pixel_t* dstp,
 }
 
 
+// instantiate
+template void cubicDeintMask_SSE2<false>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_SSE2<true>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint8_t, 8, false>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint8_t, 8, true>(const uint8_t* srcp, uint8_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 10, false>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 10, true>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 12, false>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 12, true>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 14, false>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 14, true>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 16, false>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+template void cubicDeintMask_C<uint16_t, 16, true>(const uint16_t* srcp, uint16_t* dstp,
+  const uint8_t* maskp, int src_pitch, int dst_pitch, int msk_pitch,
+  int width, int height);
+
 //void TFMPP::destroyHint(VSFrameRef *dst, unsigned int hint)
 //{
 //  if (vi->format->bytesPerSample == 1)
@@ -1091,17 +1149,13 @@ void TFMPP::getProperties(const VSFrameRef *src, int& field, bool& combed) const
 
 void TFMPP::getSetOvr(int n)
 {
-  if (setArray.size() == 0) return;
+  if (setArray.empty()) return;
   mthresh = mthresh_origSaved;
   PP = PP_origSaved;
-  for (int x = 0; x < (int)setArray.size(); x += 4)
-  {
-    if (n >= setArray[x + 1] && n <= setArray[x + 2])
-    {
-      if (setArray[x] == 80) PP = setArray[x + 3]; // P
-      else if (setArray[x] == 77) mthresh = setArray[x + 3]; // M
-    }
-  }
+  const int *ovrs = setArray.find(n);
+  if (ovrs == nullptr) return;
+  if (ovrs[0] != SettingOvr::unset) PP = ovrs[0]; // P
+  if (ovrs[1] != SettingOvr::unset) mthresh = ovrs[1]; // M
 }
 
 void TFMPP::copyField(VSFrameRef *dst, const VSFrameRef *src, int field) const
@@ -1830,16 +1884,16 @@ void maskClip2_SSE2(const uint8_t *srcp, const uint8_t *dntp,
 
 
 TFMPP::TFMPP(VSNodeRef *_child, int _PP, int _mthresh, const char* _ovr, bool _display,
-  VSNodeRef *_clip2, bool _usehints, int _opt, const VSAPI *_vsapi, VSCore *core)
+  VSNodeRef *_clip2, bool _usehints, int _opt, int _segStart, int _segFrames, const VSAPI *_vsapi, VSCore *core)
     : vsapi(_vsapi), child(_child),
   PP(_PP), mthresh(_mthresh), ovr(_ovr), display(_display), clip2(_clip2),
-  usehints(_usehints), opt(_opt)
+  usehints(_usehints), opt(_opt), segStart(_segStart), segFrames(_segFrames)
 {
     vi = vsapi->getVideoInfo(child);
 
   mmask = nullptr;
 
-  int w, i, z, b, q, countOvrS;
+  int w, z, b, q, countOvrS;
   char linein[1024], *linep, *linet;
   std::unique_ptr<FILE, decltype (&fclose)> f(nullptr, nullptr);
 
@@ -1879,10 +1933,11 @@ TFMPP::TFMPP(VSNodeRef *_child, int _PP, int _mthresh, const char* _ovr, bool _d
 //  child->SetCacheHints(CACHE_GENERIC, 3); // fixed to diameter (07/30/2005)
 
 
-  nfrms = vi->numFrames - 1;
+  if (segFrames == 0)
+    segFrames = segStart + vi->numFrames;
+  nfrms = segFrames - 1;
   PP_origSaved = PP;
   mthresh_origSaved = mthresh;
-  i = 0;
   if (ovr.size())
   {
     if ((f = decltype(f) (tivtc_fopen(ovr.c_str(), "r"), &fclose)) != nullptr)
@@ -1898,9 +1953,6 @@ TFMPP::TFMPP(VSNodeRef *_child, int _PP, int _mthresh, const char* _ovr, bool _d
       }
 
       if (countOvrS == 0) { goto emptyovrFM; }
-      ++countOvrS;
-      countOvrS *= 4;
-      setArray.resize(countOvrS, 0xffffffff);
       if ((f = decltype(f) (tivtc_fopen(ovr.c_str(), "r"), &fclose)) != nullptr)
       {
         while (fgets(linein, 1024, f.get()) != nullptr)
@@ -1943,10 +1995,7 @@ TFMPP::TFMPP(VSNodeRef *_child, int _PP, int _mthresh, const char* _ovr, bool _d
                     throw TIVTCError("TFMPP:  ovr input error (bad PP value)!");
                   }
                   else if (q != 80 && q != 77) continue;
-                  setArray[i] = q; ++i;
-                  setArray[i] = z; ++i;
-                  setArray[i] = z; ++i;
-                  setArray[i] = b; ++i;
+                  setArray.add(q, z, z, b);
                 }
               }
             }
@@ -1981,10 +2030,7 @@ TFMPP::TFMPP(VSNodeRef *_child, int _PP, int _mthresh, const char* _ovr, bool _d
                     throw TIVTCError("TFMPP:  ovr input error (bad PP value)!");
                   }
                   else if (q != 77 && q != 80) continue;
-                  setArray[i] = q; ++i;
-                  setArray[i] = z; ++i;
-                  setArray[i] = w; ++i;
-                  setArray[i] = b; ++i;
+                  setArray.add(q, z, w, b);
                 }
               }
             }
@@ -2000,6 +2046,9 @@ TFMPP::TFMPP(VSNodeRef *_child, int _PP, int _mthresh, const char* _ovr, bool _d
     }
   }
 emptyovrFM:
+  setArray.build();
+  setArray.shift(segStart);
+  nfrms = vi->numFrames - 1;
   mmask = vsapi->newVideoFrame(vi->format, vi->width, vi->height, nullptr, core);
 }
 
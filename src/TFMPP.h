@@ -28,6 +28,7 @@
 #include <math.h>
 #include <VapourSynth.h>
 #include "cpufeatures.h"
+#include "SettingOvr.h"
 #ifdef VERSION
 #undef VERSION
 #endif
@@ -84,11 +85,12 @@ private:
   VSNodeRef *clip2;
   bool usehints;
   int opt;
+  int segStart, segFrames; // as in TFM, the ovr file describes the whole clip
   bool uC2; // use clip2
   int PP_origSaved;
   int mthresh_origSaved;
   int nfrms;
-  std::vector<int> setArray;
+  SettingOvr setArray{ "PM" }; // P, M lines from the ovr file
   VSFrameRef *mmask;
 
   void buildMotionMask(const VSFrameRef *prv, const VSFrameRef *src, const VSFrameRef *nxt,
@@ -151,6 +153,6 @@ public:
 
   const VSFrameRef *GetFrame(int n, int activationReason, VSFrameContext *frameCtx, VSCore *core);
   TFMPP(VSNodeRef *_child, int _PP, int _mthresh, const char* _ovr, bool _display, VSNodeRef *_clip2,
-    bool _usehints, int _opt, const VSAPI *_vsapi, VSCore *core);
+    bool _usehints, int _opt, int _segStart, int _segFrames, const VSAPI *_vsapi, VSCore *core);
   ~TFMPP();
 };
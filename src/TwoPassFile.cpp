@@ -0,0 +1,393 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+#include "TwoPassFile.h"
+#include "TFMOutput.h"
+#include "internal.h"
+
+static const char twoPassMagic[8] = { 'T', 'I', 'V', 'T', 'C', 'B', 'I', 'N' };
+static const uint32_t twoPassVersion = 1;
+
+TwoPassHeader makeTwoPassHeader(TwoPassKind kind, int numFrames)
+{
+  TwoPassHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, twoPassMagic, sizeof(h.magic));
+  h.version = twoPassVersion;
+  h.kind = kind;
+  h.numFrames = numFrames;
+  h.recordSize = kind == TWOPASS_TFM ? 8 : 16;
+  h.PP = h.MI = h.ao = -1;
+  return h;
+}
+
+bool isTwoPassBinary(const MappedFile &mf)
+{
+  return mf.size() >= sizeof(twoPassMagic) && memcmp(mf.data(), twoPassMagic, sizeof(twoPassMagic)) == 0;
+}
+
+TwoPassView::TwoPassView(const MappedFile &mf, TwoPassKind kind, const char *filter)
+{
+  std::string err = std::string(filter) + ":  ";
+  if (mf.size() < sizeof(TwoPassHeader) || !isTwoPassBinary(mf))
+    throw TIVTCError(err + "binary file error (truncated header)!");
+  hdr = reinterpret_cast<const TwoPassHeader *>(mf.data());
+  records = reinterpret_cast<const uint8_t *>(mf.data()) + sizeof(TwoPassHeader);
+  if (hdr->version != twoPassVersion)
+    throw TIVTCError(err + "binary file error (unsupported version)!");
+  if (hdr->kind != kind)
+    throw TIVTCError(err + (kind == TWOPASS_TFM ? "binary file error (not a TFM file)!" :
+      "binary file error (not a TDecimate file)!"));
+  const int minSize = kind == TWOPASS_TFM ? 8 : 16;
+  if (hdr->numFrames < 0 || hdr->recordSize < minSize ||
+    (kind == TWOPASS_TFM && hdr->recordSize != 8 && hdr->recordSize != 20 && hdr->recordSize != 28))
+    throw TIVTCError(err + "binary file error (invalid header)!");
+  if ((mf.size() - sizeof(TwoPassHeader)) / size_t(hdr->recordSize) < size_t(hdr->numFrames))
+    throw TIVTCError(err + "binary file error (truncated file)!");
+}
+
+int TwoPassView::readInt(int n, int offset) const
+{
+  int32_t v;
+  memcpy(&v, records + size_t(n) * hdr->recordSize + offset, sizeof(v));
+  return v;
+}
+
+void TwoPassView::metrics(int n, uint64_t &metricU, uint64_t &metricF) const
+{
+  const uint8_t *r = records + size_t(n) * hdr->recordSize;
+  memcpy(&metricU, r, sizeof(uint64_t));
+  memcpy(&metricF, r + sizeof(uint64_t), sizeof(uint64_t));
+}
+
+TwoPassWriter::TwoPassWriter(const char *name, const TwoPassHeader &h, uint8_t _fill)
+  : f(nullptr), hdr(h), fill(_fill), end(0), pos(0)
+{
+  if ((f = tivtc_fopen(name, "wb")) == nullptr) return;
+  fwrite(&hdr, sizeof(hdr), 1, f);
+}
+
+TwoPassWriter::~TwoPassWriter()
+{
+  if (!f) return;
+  if (end < hdr.numFrames)
+  {
+    if (pos != end) fseek(f, long(sizeof(hdr) + size_t(end) * hdr.recordSize), SEEK_SET);
+    pad(hdr.numFrames - end);
+  }
+  fclose(f);
+}
+
+void TwoPassWriter::pad(int count)
+{
+  uint8_t buf[4096];
+  memset(buf, fill, sizeof(buf));
+  size_t left = size_t(count) * hdr.recordSize;
+  while (left > 0)
+  {
+    const size_t len = std::min(left, sizeof(buf));
+    fwrite(buf, 1, len, f);
+    left -= len;
+  }
+}
+
+void TwoPassWriter::writeHeader()
+{
+  if (!f) return;
+  fseek(f, 0, SEEK_SET);
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  pos = -1;
+}
+
+// Frames usually arrive close to in order, so the common case is an
+// append that needs no seek.
+void TwoPassWriter::put(int n, const void *rec)
+{
+  if (!f || n < 0 || n >= hdr.numFrames) return;
+  if (n >= end)
+  {
+    if (pos != end) fseek(f, long(sizeof(hdr) + size_t(end) * hdr.recordSize), SEEK_SET);
+    pad(n - end);
+    end = n + 1;
+  }
+  else if (pos != n)
+    fseek(f, long(sizeof(hdr) + size_t(n) * hdr.recordSize), SEEK_SET);
+  fwrite(rec, hdr.recordSize, 1, f);
+  pos = n + 1;
+}
+
+void TwoPassWriter::writeTFM(int n, uint8_t hint, int mic, const int *mics)
+{
+  uint8_t rec[28] = { 0 };
+  rec[0] = hint;
+  const int32_t m = mic;
+  memcpy(rec + 4, &m, 4);
+  for (int i = 0; i < (hdr.recordSize - 8) >> 2; ++i)
+  {
+    const int32_t v = mics[i];
+    memcpy(rec + 8 + i * 4, &v, 4);
+  }
+  put(n, rec);
+}
+
+void TwoPassWriter::writeTDecimate(int n, uint64_t metricU, uint64_t metricF)
+{
+  const uint64_t rec[2] = { metricU, metricF };
+  put(n, rec);
+}
+
+void writeTDecimateText(FILE *f, unsigned int crc, int blockx, int blocky, bool chroma,
+  const uint64_t *metrics, int numFrames)
+{
+  fprintf(f, "#TDecimate %s by tritical\n", VERSION);
+  fprintf(f, "crc32 = %x, blockx = %d, blocky = %d, chroma = %c\n", crc, blockx, blocky,
+    chroma ? 'T' : 'F');
+  for (int h = 0; h < numFrames * 2; h += 2)
+  {
+    if (metrics[h] != UINT64_MAX || metrics[h + 1] != UINT64_MAX)
+      fprintf(f, "%d %" PRIu64 " %" PRIu64 "\n", h >> 1, metrics[h], metrics[h + 1]);
+  }
+}
+
+namespace {
+
+bool startsWithNoCase(const char *b, const char *e, const char *s)
+{
+  const size_t len = strlen(s);
+  if (size_t(e - b) < len) return false;
+  for (size_t i = 0; i < len; ++i)
+    if (tolower((unsigned char)b[i]) != tolower((unsigned char)s[i])) return false;
+  return true;
+}
+
+const char *findText(const char *b, const char *e, const char *s)
+{
+  const size_t len = strlen(s);
+  for (; size_t(e - b) >= len; ++b)
+    if (memcmp(b, s, len) == 0) return b;
+  return nullptr;
+}
+
+bool scanU64(const char *&p, const char *e, uint64_t &v)
+{
+  while (p < e && (*p == ' ' || *p == '\t')) ++p;
+  if (p == e || *p < '0' || *p > '9') return false;
+  uint64_t t = 0;
+  while (p < e && *p >= '0' && *p <= '9') t = t * 10 + (*p++ - '0');
+  v = t;
+  return true;
+}
+
+int matchFromChar(char c)
+{
+  switch (c)
+  {
+  case 'p': return 0;
+  case 'c': return 1;
+  case 'n': return 2;
+  case 'b': return 3;
+  case 'u': return 4;
+  case 'l': return 5;
+  case 'h': return 6;
+  default: return -1;
+  }
+}
+
+struct TextFrame {
+  int n;
+  uint8_t hint;
+  int mic;
+  int mics[5];
+};
+
+void textToBinary(const MappedFile &mf, const std::string &output)
+{
+  LineReader lines(mf);
+  const char *b, *e;
+  bool tdec = false, kindKnown = false;
+  unsigned int crc = 0;
+  int field = 0, blockx = 0, blocky = 0, chroma = 0, ao = -1, micCount = 0, last = -1;
+  std::vector<TextFrame> frames;
+  std::vector<uint64_t> metrics;
+
+  while (lines.next(b, e))
+  {
+    if (b == e) continue;
+    if (*b == '#' || *b == ';')
+    {
+      if (!kindKnown && startsWithNoCase(b, e, "#TDecimate")) tdec = kindKnown = true;
+      else if (!kindKnown && startsWithNoCase(b, e, "#TFM")) kindKnown = true;
+      else if (const char *a = findText(b, e, "AGAINST ORDER ("))
+      {
+        const int q = a + 15 < e ? matchFromChar(a[15]) : -1;
+        if (q == 0 || q == 2) ao = q;
+      }
+      continue;
+    }
+    if (startsWithNoCase(b, e, "field = "))
+    {
+      field = startsWithNoCase(b, e, "field = top") ? 1 : 0;
+      kindKnown = true;
+      continue;
+    }
+    if (startsWithNoCase(b, e, "crc32 = "))
+    {
+      const char *p = b + 8;
+      scanHex(p, e, crc);
+      if (const char *x = findText(b, e, "blockx = ")) { p = x + 9; scanInt(p, e, blockx); tdec = kindKnown = true; }
+      if (const char *y = findText(b, e, "blocky = ")) { p = y + 9; scanInt(p, e, blocky); }
+      if (const char *c = findText(b, e, "chroma = ")) chroma = c + 9 < e && (c[9] == 'T' || c[9] == 't');
+      continue;
+    }
+    const char *p = b;
+    int n;
+    if (!scanInt(p, e, n)) continue;
+    if (n < 0)
+      throw TIVTCError("ConvertPassFile:  input file error (out of range frame #)!");
+    while (p < e && *p == ' ') ++p;
+    if (p == e) continue;
+    if (!kindKnown)
+    {
+      tdec = *p >= '0' && *p <= '9';
+      kindKnown = true;
+    }
+    last = std::max(last, n);
+    if (tdec)
+    {
+      uint64_t metricU = UINT64_MAX, metricF = UINT64_MAX;
+      scanU64(p, e, metricU);
+      scanU64(p, e, metricF);
+      if (metrics.size() < size_t(n + 1) * 2) metrics.resize(size_t(n + 1) * 2, UINT64_MAX);
+      metrics[n * 2] = metricU;
+      metrics[n * 2 + 1] = metricF;
+      continue;
+    }
+    // "frame match [+|-] [1] [[mic]] [(mics)]"
+    TextFrame t = { n, 0, -1, { -1, -1, -1, -1, -1 } };
+    const int q = matchFromChar(*p++);
+    if (q < 0)
+      throw TIVTCError("ConvertPassFile:  input file error (invalid match specifier)!");
+    t.hint = uint8_t(q | FILE_ENTRY);
+    while (p < e)
+    {
+      if (*p == '+') t.hint |= FILE_COMBED;
+      else if (*p == '-') t.hint |= FILE_NOTCOMBED;
+      else if (*p == '1') t.hint |= FILE_D2V;
+      else if (*p == '[') { ++p; scanInt(p, e, t.mic); }
+      else if (*p == '(')
+      {
+        ++p;
+        int i = 0;
+        while (i < 5 && scanInt(p, e, t.mics[i])) ++i;
+        micCount = std::max(micCount, i >= 5 ? 5 : i >= 3 ? 3 : 0);
+      }
+      ++p;
+    }
+    frames.push_back(t);
+  }
+
+  const int numFrames = last + 1;
+  TwoPassHeader h = makeTwoPassHeader(tdec ? TWOPASS_TDECIMATE : TWOPASS_TFM, numFrames);
+  h.crc = crc;
+  if (tdec)
+  {
+    h.blockx = blockx;
+    h.blocky = blocky;
+    h.chroma = chroma;
+    metrics.resize(size_t(numFrames) * 2, UINT64_MAX);
+  }
+  else
+  {
+    h.field = field;
+    h.micout = micCount == 5 ? 2 : micCount == 3 ? 1 : 0;
+    h.recordSize = 8 + micCount * 4;
+    h.ao = ao;
+  }
+
+  TwoPassWriter w(output.c_str(), h, tdec ? 0xFF : 0);
+  if (!w.isOpen())
+    throw TIVTCError("ConvertPassFile:  output file error (cannot create file)!");
+  if (tdec)
+  {
+    for (int n = 0; n < numFrames; ++n)
+      w.writeTDecimate(n, metrics[n * 2], metrics[n * 2 + 1]);
+  }
+  else
+  {
+    // later lines win, as when the text file is read as input
+    for (const TextFrame &t : frames)
+      w.writeTFM(t.n, t.hint, t.mic, t.mics);
+  }
+}
+
+void binaryToText(const MappedFile &mf, const std::string &output)
+{
+  if (mf.size() >= sizeof(TwoPassHeader) &&
+    reinterpret_cast<const TwoPassHeader *>(mf.data())->kind == TWOPASS_TDECIMATE)
+  {
+    TwoPassView bin(mf, TWOPASS_TDECIMATE, "ConvertPassFile");
+    const TwoPassHeader &h = bin.header();
+    std::vector<uint64_t> metrics(size_t(bin.numFrames()) * 2);
+    for (int n = 0; n < bin.numFrames(); ++n)
+      bin.metrics(n, metrics[n * 2], metrics[n * 2 + 1]);
+    FILE *f = tivtc_fopen(output.c_str(), "w");
+    if (f == nullptr)
+      throw TIVTCError("ConvertPassFile:  output file error (cannot create file)!");
+    writeTDecimateText(f, h.crc, h.blockx, h.blocky, h.chroma != 0, metrics.data(), bin.numFrames());
+    fclose(f);
+    return;
+  }
+
+  TwoPassView bin(mf, TWOPASS_TFM, "ConvertPassFile");
+  const TwoPassHeader &h = bin.header();
+  // the ovr help section can only be rebuilt if TFM wrote the file
+  const int PP = h.ao >= 0 ? h.PP : -1;
+  TFMOutput out(output.c_str(), "", bin.numFrames(), h.field, h.crc, h.micout, 0, PP, h.MI, false);
+  const int micCount = bin.micCount();
+  for (int n = 0; n < bin.numFrames(); ++n)
+  {
+    const uint8_t hint = bin.hint(n);
+    if (!(hint & FILE_ENTRY)) continue;
+    int mics[5] = { -1, -1, -1, -1, -1 };
+    for (int i = 0; i < micCount; ++i) mics[i] = bin.mics(n, i);
+    out.add(n, hint, bin.mic(n), mics, h.ao);
+  }
+}
+
+}
+
+void convertTwoPassFile(const std::string &input, const std::string &output)
+{
+  MappedFile mf(input.c_str());
+  if (!mf.isOpen())
+    throw TIVTCError("ConvertPassFile:  input file error (could not open file)!");
+  if (isTwoPassBinary(mf)) binaryToText(mf, output);
+  else textToBinary(mf, output);
+}
@@ -0,0 +1,147 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TWOPASSFILE_H
+#define TWOPASSFILE_H
+
+/*
+** Binary version of the TFM output/input and TDecimate output/input
+** files.
+**
+** The file is a fixed 64 byte header followed by one fixed size record
+** per frame, so it can be mapped and indexed directly instead of being
+** tokenized line by line. Everything is little endian. Readers tell the
+** two formats apart by the magic at the start of the file (text files
+** always start with a '#' comment).
+**
+**   TFM record (8 bytes + 4 per mic value):
+**     uint8_t hint      same bits as the hint the text file is built from
+**                       (FILE_ENTRY, FILE_COMBED/FILE_NOTCOMBED, FILE_D2V,
+**                       match), 0 = no entry for this frame
+**     uint8_t pad[3]
+**     int32_t mic       -1 = none
+**     int32_t mics[]    0, 3 or 5 values depending on micout
+**
+**   TDecimate record (16 bytes):
+**     uint64_t metricU, metricF   UINT64_MAX = not computed
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "MappedFile.h"
+
+enum TwoPassKind : uint32_t {
+  TWOPASS_TFM = 1,
+  TWOPASS_TDECIMATE = 2,
+};
+
+struct TwoPassHeader {
+  char magic[8];       // "TIVTCBIN"
+  uint32_t version;
+  uint32_t kind;       // TwoPassKind
+  uint32_t crc;        // calcCRC over the first 15 frames
+  int32_t numFrames;
+  int32_t recordSize;
+  // TFM
+  int32_t field;       // field the matches are relative to, 1 = top
+  int32_t micout;
+  int32_t PP, MI;      // -1 = unknown (converted from text)
+  int32_t ao;          // against order match, -1 = unknown
+  // TDecimate
+  int32_t blockx, blocky;
+  int32_t chroma;
+  int32_t reserved;
+};
+
+static_assert(sizeof(TwoPassHeader) == 64, "TwoPassHeader must stay 64 bytes");
+
+TwoPassHeader makeTwoPassHeader(TwoPassKind kind, int numFrames);
+
+bool isTwoPassBinary(const MappedFile &mf);
+
+// Validated view of a mapped binary file. Throws TIVTCError (prefixed
+// with filter) if the file is truncated or of the wrong kind.
+class TwoPassView
+{
+private:
+  const TwoPassHeader *hdr;
+  const uint8_t *records;
+
+public:
+  TwoPassView(const MappedFile &mf, TwoPassKind kind, const char *filter);
+
+  const TwoPassHeader &header() const { return *hdr; }
+  int numFrames() const { return hdr->numFrames; }
+  int micCount() const { return (hdr->recordSize - 8) >> 2; }
+
+  uint8_t hint(int n) const { return records[size_t(n) * hdr->recordSize]; }
+  int mic(int n) const { return readInt(n, 4); }
+  int mics(int n, int i) const { return readInt(n, 8 + i * 4); }
+  void metrics(int n, uint64_t &metricU, uint64_t &metricF) const;
+
+private:
+  int readInt(int n, int offset) const;
+};
+
+// Writes records at their frame position, so frames can arrive in any
+// order. Frames that are never written keep the fill byte the file was
+// created with (0 = no entry for TFM, 0xFF = UINT64_MAX for TDecimate).
+class TwoPassWriter
+{
+private:
+  FILE *f;
+  TwoPassHeader hdr;
+  uint8_t fill;
+  int end;  // records physically in the file
+  int pos;  // record the file position is at, -1 = unknown
+
+  void put(int n, const void *rec);
+  void pad(int count);
+
+public:
+  TwoPassWriter(const char *name, const TwoPassHeader &h, uint8_t fill);
+  ~TwoPassWriter();
+  TwoPassWriter(const TwoPassWriter &) = delete;
+  TwoPassWriter &operator=(const TwoPassWriter &) = delete;
+
+  bool isOpen() const { return f != nullptr; }
+  TwoPassHeader &header() { return hdr; }
+  void writeHeader();
+  void writeTFM(int n, uint8_t hint, int mic, const int *mics);
+  void writeTDecimate(int n, uint64_t metricU, uint64_t metricF);
+  void flush() { if (f) fflush(f); }
+};
+
+// Text TDecimate output file, shared by TDecimate and the converter.
+// metrics holds numFrames metricU/metricF pairs.
+void writeTDecimateText(FILE *f, unsigned int crc, int blockx, int blocky, bool chroma,
+  const uint64_t *metrics, int numFrames);
+
+// Converts between the text and binary formats. The direction is picked
+// from the input file, TFM or TDecimate from its contents.
+void convertTwoPassFile(const std::string &input, const std::string &output);
+
+#endif // TWOPASSFILE_H
@@ -0,0 +1,225 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define y4m_fseek _fseeki64
+#define y4m_ftell _ftelli64
+#else
+#define y4m_fseek fseeko
+#define y4m_ftell ftello
+#endif
+
+#include "Y4MReader.h"
+#include "internal.h"
+
+Y4MReader::Y4MReader(const char *path) : f(nullptr), pipe(strcmp(path, "-") == 0), nextFrame(0),
+  width(0), height(0), fpsNum(0), fpsDen(1), colorFamily(cmYUV), bitsPerSample(8),
+  subSamplingW(1), subSamplingH(1), fieldBased(-1), numFrames(-1)
+{
+  if (pipe)
+  {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    f = stdin;
+  }
+  else if ((f = tivtc_fopen(path, "rb")) == nullptr)
+    throw TIVTCError((std::string("tivtc-analyze:  cannot open ") + path + "!").c_str());
+  try {
+    readHeader();
+    if (!pipe)
+      indexFrames();
+  } catch (...) {
+    if (!pipe) fclose(f);
+    throw;
+  }
+}
+
+Y4MReader::~Y4MReader()
+{
+  if (f && !pipe)
+    fclose(f);
+}
+
+void Y4MReader::readHeader()
+{
+  std::string line;
+  int c;
+  while ((c = fgetc(f)) != EOF && c != '\n')
+    line += (char)c;
+  if (c == EOF || line.compare(0, 10, "YUV4MPEG2 ") != 0)
+    throw TIVTCError("tivtc-analyze:  input is not a YUV4MPEG2 stream!");
+
+  std::string colorspace = "420jpeg";
+  for (size_t pos = 10; pos < line.size();)
+  {
+    size_t end = line.find(' ', pos);
+    if (end == std::string::npos) end = line.size();
+    const std::string tag = line.substr(pos, end - pos);
+    pos = end + 1;
+    if (tag.empty())
+      continue;
+    const char *v = tag.c_str() + 1;
+    switch (tag[0])
+    {
+    case 'W': width = atoi(v); break;
+    case 'H': height = atoi(v); break;
+    case 'F':
+      if (sscanf(v, "%" SCNd64 ":%" SCNd64, &fpsNum, &fpsDen) != 2 || fpsNum <= 0 || fpsDen <= 0)
+        throw TIVTCError("tivtc-analyze:  invalid frame rate in the YUV4MPEG2 header!");
+      break;
+    case 'I':
+      fieldBased = *v == 't' ? 2 : *v == 'b' ? 1 : *v == 'p' ? 0 : -1;
+      break;
+    case 'C': colorspace = v; break;
+    case 'X':
+      // not part of the format, some writers state the length this way
+      if (pipe && strncmp(v, "LENGTH=", 7) == 0 && atoi(v + 7) > 0)
+        numFrames = atoi(v + 7);
+      break;
+    default: break;
+    }
+  }
+  if (width <= 0 || height <= 0)
+    throw TIVTCError("tivtc-analyze:  invalid frame size in the YUV4MPEG2 header!");
+
+  // 420jpeg, 420paldv, 422, 444p10, mono16, ...
+  const char *cs = colorspace.c_str();
+  if (strncmp(cs, "mono", 4) == 0)
+  {
+    colorFamily = cmGray;
+    subSamplingW = subSamplingH = 0;
+    bitsPerSample = cs[4] ? atoi(cs + 4) : 8;
+  }
+  else
+  {
+    if (strncmp(cs, "420", 3) == 0) subSamplingW = subSamplingH = 1;
+    else if (strncmp(cs, "422", 3) == 0) { subSamplingW = 1; subSamplingH = 0; }
+    else if (strncmp(cs, "444", 3) == 0) subSamplingW = subSamplingH = 0;
+    else if (strncmp(cs, "411", 3) == 0) { subSamplingW = 2; subSamplingH = 0; }
+    else
+      throw TIVTCError(("tivtc-analyze:  unsupported YUV4MPEG2 colorspace " + colorspace + "!").c_str());
+    bitsPerSample = cs[3] == 'p' ? atoi(cs + 4) : 8;
+  }
+  if (bitsPerSample < 8 || bitsPerSample > 16)
+    throw TIVTCError(("tivtc-analyze:  unsupported YUV4MPEG2 colorspace " + colorspace + "!").c_str());
+}
+
+// consumes "FRAME[ params]\n", false at the end of the stream
+bool Y4MReader::skipFrameHeader()
+{
+  char tag[5];
+  if (fread(tag, 1, 5, f) != 5)
+    return false;
+  if (memcmp(tag, "FRAME", 5) != 0)
+    throw TIVTCError("tivtc-analyze:  YUV4MPEG2 frame header expected!");
+  int c;
+  while ((c = fgetc(f)) != EOF && c != '\n');
+  if (c == EOF)
+    throw TIVTCError("tivtc-analyze:  truncated YUV4MPEG2 frame header!");
+  return true;
+}
+
+bool Y4MReader::moreFrames()
+{
+  if (!pipe || nextFrame < numFrames)
+    return false;
+  const int c = fgetc(f);
+  if (c == EOF)
+    return false;
+  ungetc(c, f);
+  return true;
+}
+
+static int64_t frameBytes(int w, int h, int ssw, int ssh, bool gray, int bits)
+{
+  const int64_t luma = (int64_t)w * h;
+  const int64_t chroma = gray ? 0 : 2 * (int64_t)(w >> ssw) * (h >> ssh);
+  return (luma + chroma) * (bits > 8 ? 2 : 1);
+}
+
+void Y4MReader::indexFrames()
+{
+  const int64_t size = frameBytes(width, height, subSamplingW, subSamplingH, colorFamily == cmGray, bitsPerSample);
+  const int64_t first = y4m_ftell(f);
+  if (y4m_fseek(f, 0, SEEK_END) != 0)
+    throw TIVTCError("tivtc-analyze:  input file is not seekable!");
+  const int64_t end = y4m_ftell(f);
+  y4m_fseek(f, first, SEEK_SET);
+  while (skipFrameHeader())
+  {
+    const int64_t start = y4m_ftell(f);
+    if (end - start < size)
+      break; // incomplete last frame
+    offsets.push_back(start);
+    y4m_fseek(f, start + size, SEEK_SET);
+  }
+  numFrames = (int)offsets.size();
+  if (numFrames == 0)
+    throw TIVTCError("tivtc-analyze:  input file contains no frames!");
+}
+
+void Y4MReader::read(int n, VSFrameRef *dst, const VSAPI *vsapi)
+{
+  if (pipe)
+  {
+    if (n != nextFrame)
+      throw TIVTCError("tivtc-analyze:  stdin can only be read in order!");
+    if (!skipFrameHeader())
+      throw TIVTCError(("tivtc-analyze:  input ended at frame " + std::to_string(n) + ", before --frames was reached!").c_str());
+    ++nextFrame;
+  }
+  else if (y4m_fseek(f, offsets[n], SEEK_SET) != 0)
+    throw TIVTCError("tivtc-analyze:  seek in input file failed!");
+
+  const int bytes = bitsPerSample > 8 ? 2 : 1;
+  const int planes = colorFamily == cmGray ? 1 : 3;
+  for (int p = 0; p < planes; ++p)
+  {
+    const int w = vsapi->getFrameWidth(dst, p) * bytes;
+    const int h = vsapi->getFrameHeight(dst, p);
+    const int stride = vsapi->getStride(dst, p);
+    uint8_t *dstp = vsapi->getWritePtr(dst, p);
+    // samples above 8 bits are little endian, as in memory
+    for (int y = 0; y < h; ++y)
+    {
+      if (fread(dstp, 1, w, f) != (size_t)w)
+        throw TIVTCError(("tivtc-analyze:  input ended inside frame " + std::to_string(n) + "!").c_str());
+      dstp += stride;
+    }
+  }
+
+  VSMap *props = vsapi->getFramePropsRW(dst);
+  if (fieldBased >= 0)
+    vsapi->propSetInt(props, "_FieldBased", fieldBased, paReplace);
+  vsapi->propSetInt(props, "_DurationNum", fpsDen, paReplace);
+  vsapi->propSetInt(props, "_DurationDen", fpsNum, paReplace);
+}
@@ -0,0 +1,69 @@
+/*
+**                    TIVTC for AviSynth 2.6 interface
+**
+**   TIVTC includes a field matching filter (TFM) and a decimation
+**   filter (TDecimate) which can be used together to achieve an
+**   IVTC or for other uses. TIVTC currently supports 8 bit planar YUV and
+**   YUY2 colorspaces.
+**
+**   Copyright (C) 2004-2008 Kevin Stone, additional work (C) 2020 pinterf
+**
+**   This program is free software; you can redistribute it and/or modify
+**   it under the terms of the GNU General Public License as published by
+**   the Free Software Foundation; either version 2 of the License, or
+**   (at your option) any later version.
+**
+**   This program is distributed in the hope that it will be useful,
+**   but WITHOUT ANY WARRANTY; without even the implied warranty of
+**   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**   GNU General Public License for more details.
+**
+**   You should have received a copy of the GNU General Public License
+**   along with this program; if not, write to the Free Software
+**   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef Y4MREADER_H
+#define Y4MREADER_H
+
+/*
+** YUV4MPEG2 input for tivtc-analyze. Files are indexed when opened and
+** can be read in any order, stdin ("-") only front to back.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <VapourSynth.h>
+
+class Y4MReader
+{
+private:
+  FILE *f;
+  bool pipe;
+  std::vector<int64_t> offsets; // start of the sample data of each frame, files only
+  int nextFrame;                // stdin only
+
+  void readHeader();
+  void indexFrames();
+  bool skipFrameHeader();
+
+public:
+  int width, height;
+  int64_t fpsNum, fpsDen;
+  int colorFamily, bitsPerSample, subSamplingW, subSamplingH;
+  int fieldBased; // as the _FieldBased property, -1 if the stream does not say
+  int numFrames;  // for stdin the XLENGTH header parameter, else -1 until set by the caller
+
+  explicit Y4MReader(const char *path);
+  ~Y4MReader();
+
+  bool seekable() const { return !pipe; }
+  // stdin only, true if frames follow the last one read
+  bool moreFrames();
+  void read(int n, VSFrameRef *dst, const VSAPI *vsapi);
+};
+
+#endif // Y4MREADER_H